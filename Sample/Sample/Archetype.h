@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "SlotMap.h"
+
+namespace dxstg {
+
+// 同じ構成要素 (コンポーネント) を持つオブジェクトをまとめて持つ入れ物
+// コンポーネントの種類ごとに配列を分けて持つ (SoA)。オブジェクトの大きさは、宣言したコンポーネントの合計だけになる。
+// each<Position, Velocity>(f) のように使うコンポーネントを並べると、その配列だけを頭から順に触るループになる。
+// 要素は SlotMap と同じくハンドルで指す。要素へのポインタや参照は、追加・削除で無効になる。
+template <class... Components>
+class Archetype final {
+	static_assert(sizeof...(Components) > 0, "Archetype needs at least one component");
+
+public:
+	// 1つあたりのコンポーネントの大きさの合計
+	static constexpr size_t componentBytes() noexcept
+	{
+		const size_t sizes[] = { sizeof(Components)... };
+		size_t total = 0;
+		for (size_t size : sizes) total += size;
+		return total;
+	}
+
+	// 1つあたりの大きさ (ハンドルとスロットの分も含む)
+	static constexpr size_t bytesPerEntity() noexcept
+	{
+		return componentBytes() + sizeof(SlotHandle) + sizeof(Slot);
+	}
+
+	// 追加して、そのハンドルを返す
+	SlotHandle insert(Components... values)
+	{
+		std::uint32_t index;
+		if (m_freeHead != NoSlot) {
+			index = m_freeHead;
+			m_freeHead = m_slots[index].dense;
+		} else {
+			index = static_cast<std::uint32_t>(m_slots.size());
+			m_slots.push_back(Slot());
+		}
+
+		Slot& slot = m_slots[index];
+		slot.dense = static_cast<std::uint32_t>(m_handles.size());
+		(void)std::initializer_list<int>{ (column<Components>().push_back(std::move(values)), 0)... };
+		m_handles.push_back({ index, slot.generation });
+		return m_handles.back();
+	}
+
+	bool contains(SlotHandle handle) const noexcept
+	{
+		return handle.index < m_slots.size() && m_slots[handle.index].generation == handle.generation;
+	}
+
+	// なければ nullptr
+	template <class C>
+	C* get(SlotHandle handle) noexcept
+	{
+		return contains(handle) ? &column<C>()[m_slots[handle.index].dense] : nullptr;
+	}
+
+	// 1つ消す。最後の要素をその場所に移すので O(1) だが、並び順は変わる
+	// もう消えていれば何もしない
+	bool erase(SlotHandle handle)
+	{
+		if (!contains(handle)) return false;
+		const std::uint32_t dense = m_slots[handle.index].dense;
+		const size_t last = m_handles.size() - 1;
+		if (dense != last) {
+			moveEntity(last, dense);
+		}
+		popBack();
+		release(handle.index);
+		return true;
+	}
+
+	// pred(i) が true を返した要素を消す。残りの要素の順番は変わらない
+	template <class Pred>
+	size_t eraseIf(Pred pred)
+	{
+		const size_t count = m_handles.size();
+		size_t kept = 0;
+		for (size_t i = 0; i < count; ++i) {
+			if (pred(i)) {
+				release(m_handles[i].index);
+				continue;
+			}
+			if (kept != i) {
+				moveEntity(i, kept);
+			}
+			++kept;
+		}
+		while (m_handles.size() > kept) {
+			popBack();
+		}
+		return count - kept;
+	}
+
+	// 並んでいる順に、選んだコンポーネントを f(c0[i], c1[i], ...) に渡す
+	template <class... Selected, class F>
+	void each(F&& f)
+	{
+		const size_t count = m_handles.size();
+		const auto columns = std::make_tuple(column<Selected>().data()...);
+		for (size_t i = 0; i < count; ++i) {
+			f(std::get<Selected*>(columns)[i]...);
+		}
+	}
+
+	void clear()
+	{
+		for (const auto& handle : m_handles) {
+			release(handle.index);
+		}
+		(void)std::initializer_list<int>{ (column<Components>().clear(), 0)... };
+		m_handles.clear();
+	}
+
+	// コンポーネントの配列 (並んでいる順)
+	template <class C>
+	std::vector<C>& column() noexcept { return std::get<std::vector<C>>(m_columns); }
+	template <class C>
+	const std::vector<C>& column() const noexcept { return std::get<std::vector<C>>(m_columns); }
+
+	size_t size() const noexcept { return m_handles.size(); }
+	bool empty() const noexcept { return m_handles.empty(); }
+	SlotHandle handleAt(size_t i) const noexcept { return m_handles[i]; }
+	const SlotHandle* handles() const noexcept { return m_handles.data(); } // 並んでいる順 (コンポーネントの配列と同じ)
+
+private:
+	static constexpr std::uint32_t NoSlot = 0xffffffff;
+
+	struct Slot {
+		std::uint32_t dense = NoSlot;  // 配列の番号。空いているスロットでは次の空きスロット
+		std::uint32_t generation = 1;
+	};
+
+	// from 番目の要素を to 番目に移す (to にあったものは上書き)
+	void moveEntity(size_t from, size_t to)
+	{
+		(void)std::initializer_list<int>{ (column<Components>()[to] = std::move(column<Components>()[from]), 0)... };
+		m_handles[to] = m_handles[from];
+		m_slots[m_handles[to].index].dense = static_cast<std::uint32_t>(to);
+	}
+
+	void popBack()
+	{
+		(void)std::initializer_list<int>{ (column<Components>().pop_back(), 0)... };
+		m_handles.pop_back();
+	}
+
+	// スロットを空きにして世代を進める
+	void release(std::uint32_t index) noexcept
+	{
+		Slot& slot = m_slots[index];
+		if (++slot.generation == 0) slot.generation = 1; // 0 は空のハンドル用
+		slot.dense = m_freeHead;
+		m_freeHead = index;
+	}
+
+	std::tuple<std::vector<Components>...> m_columns;
+	std::vector<SlotHandle> m_handles; // 配列と同じ順のハンドル
+	std::vector<Slot> m_slots;
+	std::uint32_t m_freeHead = NoSlot;
+};
+
+}
@@ -0,0 +1,46 @@
+#include "AssetPack.h"
+
+#include "Lz4.h"
+
+namespace dxstg {
+
+AssetView ReadAssetFile(const wchar_t* fpath)
+{
+	MappedFile file(fpath);
+	if (!file) return AssetView();
+	return AssetView(std::move(file));
+}
+
+AssetPack::AssetPack(const wchar_t* fpath) :
+	m_file(fpath),
+	m_index(m_file.get(), m_file.size())
+{
+	if (m_file && !m_index) {
+		OutputDebugStringW(L"failed: AssetPack (broken pack)\n");
+	}
+}
+
+AssetPack::AssetPack(const void* data, size_t size) :
+	m_index(data, size)
+{
+}
+
+AssetView AssetPack::find(const char* name) const
+{
+	const AssetPackEntry* e = m_index.find(name);
+	if (!e) return AssetView();
+
+	const std::uint8_t* stored = m_index.stored(*e);
+	if (!(e->flags & AssetPackFlagLz4)) {
+		return AssetView(stored, e->storedSize); // コピーなし
+	}
+
+	auto data = std::make_unique<std::uint8_t[]>(e->originalSize);
+	if (!Lz4Decompress(stored, e->storedSize, data.get(), e->originalSize)) {
+		OutputDebugStringW(L"failed: Lz4Decompress\n");
+		return AssetView();
+	}
+	return AssetView(std::move(data), e->originalSize);
+}
+
+}
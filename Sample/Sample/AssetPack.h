@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "AssetPackIndex.h"
+#include "MappedFile.h"
+
+namespace dxstg {
+
+// アセットの中身
+// 圧縮されていないものはパックのマップしたページをそのまま指す (コピーなし)。
+// パックを使わずにファイルから読んだものは、そのファイルをマップして持つ (これもコピーなし)。
+// 圧縮されていたものは展開したバッファを自分で持つ。
+// パックから得たものは、パックより先に破棄すること。
+class AssetView final {
+public:
+	AssetView() = default;
+	AssetView(const void* data, size_t size) noexcept : m_data(data), m_size(size) {}
+	AssetView(std::unique_ptr<std::uint8_t[]>&& owned, size_t size) noexcept
+		: m_owned(std::move(owned)), m_data(m_owned.get()), m_size(size) {}
+	explicit AssetView(MappedFile&& file) noexcept
+		: m_file(std::move(file)), m_data(m_file.get()), m_size(m_file.size()) {}
+
+	explicit operator bool() const noexcept { return m_data != nullptr; }
+	const void* get() const noexcept { return m_data; }
+	size_t size() const noexcept { return m_size; }
+	bool isZeroCopy() const noexcept { return m_data != nullptr && !m_owned; }
+
+private:
+	MappedFile m_file;
+	std::unique_ptr<std::uint8_t[]> m_owned;
+	const void* m_data = nullptr;
+	size_t m_size = 0;
+};
+
+// ファイルをまるごとメモリマップする (パックを使わないとき用)
+AssetView ReadAssetFile(const wchar_t* fpath);
+
+// 1つのファイルにまとめたアセット
+// 開くときにファイルを1回メモリマップするだけで、中身は find したときに参照する。
+class AssetPack final {
+public:
+	AssetPack() = default;
+	explicit AssetPack(const wchar_t* fpath);
+	AssetPack(const void* data, size_t size); // すでにメモリにあるパック (data は AssetPack より長く生きること)
+
+	explicit operator bool() const noexcept { return static_cast<bool>(m_index); }
+	size_t size() const noexcept { return m_index.size(); }
+
+	// 名前 (例: "VertexShader.cso") で探す。なければ空の AssetView を返す
+	AssetView find(const char* name) const;
+
+private:
+	MappedFile m_file;
+	AssetPackIndex m_index;
+};
+
+}
@@ -0,0 +1,60 @@
+#include "AssetPackIndex.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace dxstg {
+
+bool AssetPackIndex::open(const void* data, size_t size) noexcept
+{
+	if (data == nullptr || size < sizeof(AssetPackHeader)) return false;
+
+	const auto bytes = static_cast<const std::uint8_t*>(data);
+	const auto header = reinterpret_cast<const AssetPackHeader*>(bytes);
+	if (std::memcmp(header->magic, "DXPK", 4) != 0) return false;
+	if (header->version != AssetPackVersion) return false;
+	if ((size - sizeof(AssetPackHeader)) / sizeof(AssetPackEntry) < header->entryCount) return false;
+
+	// 範囲外を指しているものがないか、開くときに1回だけ確認する
+	const auto entries = reinterpret_cast<const AssetPackEntry*>(bytes + sizeof(AssetPackHeader));
+	for (std::uint32_t i = 0; i < header->entryCount; ++i) {
+		const AssetPackEntry& e = entries[i];
+		if (static_cast<std::uint64_t>(e.nameOffset) + e.nameLength > size) return false;
+		if (static_cast<std::uint64_t>(e.dataOffset) + e.storedSize > size) return false;
+		if (!(e.flags & AssetPackFlagLz4) && e.storedSize != e.originalSize) return false;
+	}
+
+	m_data = bytes;
+	m_entries = entries;
+	m_entryCount = header->entryCount;
+	return true;
+}
+
+const AssetPackEntry* AssetPackIndex::find(const char* name) const noexcept
+{
+	if (!m_entries) return nullptr;
+
+	// 名前順に並んでいるので二分探索
+	const size_t nameLength = std::strlen(name);
+	std::uint32_t lo = 0;
+	std::uint32_t hi = m_entryCount;
+	while (lo < hi) {
+		const std::uint32_t mid = lo + (hi - lo) / 2;
+		const AssetPackEntry& e = m_entries[mid];
+		int cmp = std::memcmp(this->name(e), name, std::min<size_t>(e.nameLength, nameLength));
+		if (cmp == 0) {
+			cmp = (e.nameLength < nameLength) ? -1 : (e.nameLength > nameLength) ? 1 : 0;
+		}
+
+		if (cmp < 0) {
+			lo = mid + 1;
+		} else if (cmp > 0) {
+			hi = mid;
+		} else {
+			return &e;
+		}
+	}
+	return nullptr;
+}
+
+}
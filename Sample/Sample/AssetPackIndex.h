@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dxstg {
+
+// Tools/pack.py が出力するアセットパック (.pak) の形式
+// すべてリトルエンディアン。
+// [AssetPackHeader][AssetPackEntry × entryCount (名前順)][名前 (UTF-8)][各データ (16バイト境界)]
+struct AssetPackHeader {
+	char magic[4];              // "DXPK"
+	std::uint32_t version;      // AssetPackVersion
+	std::uint32_t entryCount;
+	std::uint32_t reserved;
+};
+
+struct AssetPackEntry {
+	std::uint32_t nameOffset;   // ファイルの先頭からのバイト数
+	std::uint32_t nameLength;
+	std::uint32_t dataOffset;   // ファイルの先頭からのバイト数 (16の倍数)
+	std::uint32_t storedSize;   // パック内のバイト数
+	std::uint32_t originalSize; // 展開後のバイト数
+	std::uint32_t flags;        // AssetPackFlagLz4 など
+	std::uint32_t reserved[2];
+};
+
+static_assert(sizeof(AssetPackHeader) == 16, "AssetPackHeader must be 16 bytes");
+static_assert(sizeof(AssetPackEntry) == 32, "AssetPackEntry must be 32 bytes");
+
+constexpr std::uint32_t AssetPackVersion = 1;
+constexpr std::uint32_t AssetPackFlagLz4 = 1; // LZ4 ブロック形式で圧縮されている
+
+// メモリにあるパックの目次
+// 開くときにヘッダーとすべてのエントリーが data の範囲内を指しているかを確かめ、壊れていたら開かない。
+// ファイルの読み込みや展開はしない (AssetPack が行う)。Windows に依存しない。
+class AssetPackIndex final {
+public:
+	AssetPackIndex() = default;
+	AssetPackIndex(const void* data, size_t size) noexcept { open(data, size); } // data は AssetPackIndex より長く生きること
+
+	explicit operator bool() const noexcept { return m_entries != nullptr; }
+	size_t size() const noexcept { return m_entryCount; }
+	const AssetPackEntry& entry(size_t i) const noexcept { return m_entries[i]; }
+
+	// 名前 (例: "VertexShader.cso") で探す。なければ nullptr
+	const AssetPackEntry* find(const char* name) const noexcept;
+
+	const char* name(const AssetPackEntry& e) const noexcept { return reinterpret_cast<const char*>(m_data + e.nameOffset); }
+	const std::uint8_t* stored(const AssetPackEntry& e) const noexcept { return m_data + e.dataOffset; }
+
+private:
+	const std::uint8_t* m_data = nullptr;
+	const AssetPackEntry* m_entries = nullptr;
+	std::uint32_t m_entryCount = 0;
+
+	bool open(const void* data, size_t size) noexcept;
+};
+
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace dxstg {
+
+// 文字コードをキーにした2段のページテーブル
+// 上位ビットでページを選び、ページ内は下位8ビットで直接引く。
+// ページは使われたときにだけ確保するので、ASCII・かな・よく使う漢字だけなら数ページで済む。
+// 値は vector に詰めて持つので、走査も速い。
+// メンバ関数は大体 unordered_map 準拠だが、要素への参照・イテレータは
+// 要素の追加・削除で無効になる点に注意。
+template <class T>
+class CodePointTable final {
+public:
+	using key_type = wchar_t;
+	using mapped_type = T;
+	using value_type = std::pair<wchar_t, T>;
+	using container_type = std::vector<value_type>;
+	using size_type = typename container_type::size_type;
+	using iterator = typename container_type::iterator;
+	using const_iterator = typename container_type::const_iterator;
+
+	bool empty() const noexcept { return m_values.empty(); }
+	size_type size() const noexcept { return m_values.size(); }
+	iterator begin() noexcept { return m_values.begin(); }
+	iterator end() noexcept { return m_values.end(); }
+	const_iterator begin() const noexcept { return m_values.begin(); }
+	const_iterator end() const noexcept { return m_values.end(); }
+	const_iterator cbegin() const noexcept { return m_values.cbegin(); }
+	const_iterator cend() const noexcept { return m_values.cend(); }
+
+	iterator find(wchar_t code) noexcept
+	{
+		const std::uint32_t index = indexOf(code);
+		return index == npos ? end() : begin() + index;
+	}
+
+	const_iterator find(wchar_t code) const noexcept
+	{
+		const std::uint32_t index = indexOf(code);
+		return index == npos ? cend() : cbegin() + index;
+	}
+
+	size_type count(wchar_t code) const noexcept { return indexOf(code) == npos ? 0 : 1; }
+
+	T& at(wchar_t code)
+	{
+		const std::uint32_t index = indexOf(code);
+		if (index == npos) throw std::out_of_range("CodePointTable::at");
+		return m_values[index].second;
+	}
+
+	const T& at(wchar_t code) const
+	{
+		const std::uint32_t index = indexOf(code);
+		if (index == npos) throw std::out_of_range("CodePointTable::at");
+		return m_values[index].second;
+	}
+
+	// なければデフォルト値で追加する
+	T& operator [] (wchar_t code)
+	{
+		std::uint32_t& slot = slotOf(code);
+		if (slot == npos) {
+			slot = static_cast<std::uint32_t>(m_values.size());
+			m_values.emplace_back(code, T());
+		}
+		return m_values[slot].second;
+	}
+
+	// 末尾の要素を空いた場所に移して詰める
+	size_type erase(wchar_t code)
+	{
+		const std::uint32_t index = indexOf(code);
+		if (index == npos) return 0;
+
+		slotOf(code) = npos;
+		if (index + 1 != m_values.size()) {
+			m_values[index] = std::move(m_values.back());
+			slotOf(m_values[index].first) = index;
+		}
+		m_values.pop_back();
+		return 1;
+	}
+
+	void clear()
+	{
+		m_pages.clear();
+		m_values.clear();
+	}
+
+	// 確保しているページ数
+	size_type pageCount() const noexcept
+	{
+		size_type n = 0;
+		for (const auto& page : m_pages) {
+			if (page) ++n;
+		}
+		return n;
+	}
+
+private:
+	static constexpr unsigned PageBits = 8;
+	static constexpr std::uint32_t PageSize = 1u << PageBits;
+	static constexpr std::uint32_t npos = 0xffffffff;
+
+	struct Page {
+		Page() { slots.fill(npos); }
+		std::array<std::uint32_t, PageSize> slots;
+	};
+
+	std::vector<std::unique_ptr<Page>> m_pages; // 上位ビット -> ページ
+	container_type m_values;                    // 値の本体
+
+	static std::uint32_t codeOf(wchar_t code) noexcept
+	{
+		return static_cast<std::uint32_t>(code) & 0x1fffff;
+	}
+
+	std::uint32_t indexOf(wchar_t code) const noexcept
+	{
+		const std::uint32_t c = codeOf(code);
+		const std::uint32_t p = c >> PageBits;
+		if (p >= m_pages.size() || !m_pages[p]) return npos;
+		return m_pages[p]->slots[c & (PageSize - 1)];
+	}
+
+	// ページがなければ確保する
+	std::uint32_t& slotOf(wchar_t code)
+	{
+		const std::uint32_t c = codeOf(code);
+		const std::uint32_t p = c >> PageBits;
+		if (p >= m_pages.size()) m_pages.resize(p + 1);
+		if (!m_pages[p]) m_pages[p] = std::make_unique<Page>();
+		return m_pages[p]->slots[c & (PageSize - 1)];
+	}
+};
+
+}
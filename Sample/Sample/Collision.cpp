@@ -0,0 +1,131 @@
+#include "Collision.h"
+
+#include <algorithm>
+#include <exception>
+#include <future>
+
+#include "ThreadPool.h"
+
+namespace dxstg {
+
+namespace {
+
+// 行 i = job, job + jobCount, ... について、i < j で重なっている組を out に書く
+// 三角形の二重ループなので、行を飛び飛びに受け持つと仕事の量がそろう
+void FindContactsInRows(const Rectangle* rects, size_t count, size_t job, size_t jobCount, std::vector<Contact>& out)
+{
+	out.clear();
+	for (size_t i = job; i < count; i += jobCount) {
+		const Rectangle& a = rects[i];
+		for (size_t j = i + 1; j < count; ++j) {
+			if (a.intersects(rects[j])) {
+				out.push_back({ static_cast<std::uint32_t>(i), static_cast<std::uint32_t>(j) });
+			}
+		}
+	}
+}
+
+// positions[begin, end) の矩形と rects の重なりを out に書く
+// 位置の側 (数が多い) を外側にして、頭から一度だけ読む
+void FindCrossContactsInRange(const Rectangle* rects, size_t rectCount, const Position* positions, const SlotHandle* handles,
+	size_t begin, size_t end, float halfWidth, float halfHeight, std::vector<CrossContact>& out)
+{
+	out.clear();
+	for (size_t j = begin; j < end; ++j) {
+		const Rectangle b = { positions[j].x - halfWidth, positions[j].y - halfHeight, positions[j].x + halfWidth, positions[j].y + halfHeight };
+		for (size_t i = 0; i < rectCount; ++i) {
+			if (rects[i].intersects(b)) {
+				out.push_back({ static_cast<std::uint32_t>(i), static_cast<std::uint32_t>(j), handles[j] });
+			}
+		}
+	}
+}
+
+} // end unnamed namespace
+
+void ContactFinder::runJobs(size_t jobCount, const std::function<void(size_t job)>& job)
+{
+	std::vector<std::future<void>> futures;
+	futures.reserve(jobCount - 1);
+	for (size_t i = 1; i < jobCount; ++i) {
+		futures.push_back(m_pool->submit([&job, i] { job(i); }));
+	}
+	// 例外が出ても、ワーカーがバッファを書き終わるまでは待つ
+	std::exception_ptr error;
+	try {
+		job(0);
+	} catch (...) {
+		error = std::current_exception();
+	}
+	for (auto& future : futures) {
+		future.wait();
+	}
+	if (error) {
+		std::rethrow_exception(error);
+	}
+	for (auto& future : futures) {
+		future.get();
+	}
+}
+
+const std::vector<Contact>& ContactFinder::find(const Rectangle* rects, size_t count)
+{
+	// 呼び出したスレッドも1つ受け持つ
+	size_t jobCount = 1;
+	if (m_pool != nullptr && count >= ParallelThreshold) {
+		jobCount = m_pool->threadCount() + 1;
+	}
+	m_lastThreadCount = jobCount;
+
+	if (m_buffers.size() < jobCount) {
+		m_buffers.resize(jobCount);
+	}
+
+	runJobs(jobCount, [this, rects, count, jobCount](size_t job) {
+		FindContactsInRows(rects, count, job, jobCount, m_buffers[job]);
+	});
+
+	// まとめて並べ替える (スレッドの数や終わった順によらない)
+	m_contacts.clear();
+	for (size_t job = 0; job < jobCount; ++job) {
+		m_contacts.insert(m_contacts.end(), m_buffers[job].begin(), m_buffers[job].end());
+	}
+	if (jobCount > 1) {
+		std::sort(m_contacts.begin(), m_contacts.end(), [](const Contact& a, const Contact& b) {
+			return (a.first != b.first) ? (a.first < b.first) : (a.second < b.second);
+		});
+	}
+	return m_contacts;
+}
+
+const std::vector<CrossContact>& ContactFinder::findCross(const Rectangle* rects, size_t rectCount,
+	const Position* positions, const SlotHandle* handles, size_t count, float halfWidth, float halfHeight)
+{
+	// 位置の側を続いた範囲に分けて受け持つ (呼び出したスレッドも1つ受け持つ)
+	size_t jobCount = 1;
+	if (m_pool != nullptr && rectCount * count >= ParallelThreshold * ParallelThreshold / 2) {
+		jobCount = std::min(m_pool->threadCount() + 1, count);
+	}
+	m_lastThreadCount = jobCount;
+
+	if (m_crossBuffers.size() < jobCount) {
+		m_crossBuffers.resize(jobCount);
+	}
+
+	runJobs(jobCount, [=](size_t job) {
+		FindCrossContactsInRange(rects, rectCount, positions, handles,
+			count * job / jobCount, count * (job + 1) / jobCount, halfWidth, halfHeight, m_crossBuffers[job]);
+	});
+
+	// (object, otherIndex) の順に並べる (矩形を外側にした二重ループと同じ順)
+	m_crossContacts.clear();
+	for (size_t job = 0; job < jobCount; ++job) {
+		m_crossContacts.insert(m_crossContacts.end(), m_crossBuffers[job].begin(), m_crossBuffers[job].end());
+	}
+	std::sort(m_crossContacts.begin(), m_crossContacts.end(), [](const CrossContact& a, const CrossContact& b) {
+		return (a.object != b.object) ? (a.object < b.object) : (a.otherIndex < b.otherIndex);
+	});
+	return m_crossContacts;
+}
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "Components.h"
+#include "SlotMap.h"
+#include "StgObject.h"
+
+namespace dxstg {
+
+class ThreadPool;
+
+// 重なっている2つ (番号は当たり判定を渡した順、first < second)
+struct Contact {
+	std::uint32_t first;
+	std::uint32_t second;
+};
+
+// 当たり判定の矩形 (object) と、位置で持っている要素 (弾など) の重なり
+struct CrossContact {
+	std::uint32_t object;      // 矩形の番号
+	std::uint32_t otherIndex;  // 位置の番号 (渡した配列の順)
+	SlotHandle other;          // 位置の要素のハンドル
+};
+
+// 当たり判定の重なりをすべて見つける
+// 見つけるだけでオブジェクトには触らないので、ワーカースレッドに分けて調べられる。
+// 結果はスレッドの数によらず、(first, second) の順に並ぶ (1スレッドで二重ループしたときと同じ順)。
+class ContactFinder final {
+public:
+	// pool が nullptr なら、呼び出したスレッドだけで調べる
+	explicit ContactFinder(ThreadPool* pool = nullptr) : m_pool(pool) {}
+	ContactFinder(const ContactFinder&) = delete;              // コピー不可
+	ContactFinder& operator = (const ContactFinder&) = delete; // コピー不可
+
+	// rects[i] と rects[j] (i < j) が重なっている組を返す
+	// 返したものは次に find を呼ぶまで有効
+	const std::vector<Contact>& find(const Rectangle* rects, size_t count);
+
+	// rects[i] と、positions[j] を中心とする半径 (halfWidth, halfHeight) の矩形が重なっている組を返す
+	// handles[j] は positions[j] の要素のハンドル。(object, otherIndex) の順に並ぶ。
+	// 返したものは次に findCross を呼ぶまで有効 (find の結果とは別に持つ)
+	const std::vector<CrossContact>& findCross(const Rectangle* rects, size_t rectCount,
+		const Position* positions, const SlotHandle* handles, size_t count, float halfWidth, float halfHeight);
+
+	// 前の find / findCross で使ったスレッドの数
+	size_t lastThreadCount() const noexcept { return m_lastThreadCount; }
+
+	// これより少ないときは分けずに調べる (分ける手間のほうが大きい)
+	// findCross は、調べる組の数が find で ParallelThreshold 個のときと同じくらいになったら分ける
+	static constexpr size_t ParallelThreshold = 256;
+
+private:
+	ThreadPool* m_pool;
+	std::vector<std::vector<Contact>> m_buffers; // 仕事ごとの結果 (確保した領域は使い回す)
+	std::vector<Contact> m_contacts;
+	std::vector<std::vector<CrossContact>> m_crossBuffers;
+	std::vector<CrossContact> m_crossContacts;
+	size_t m_lastThreadCount = 0;
+
+	// job(0) ～ job(jobCount - 1) を、呼び出したスレッドとワーカーで分けて実行する
+	void runJobs(size_t jobCount, const std::function<void(size_t job)>& job);
+};
+
+}
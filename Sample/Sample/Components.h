@@ -0,0 +1,18 @@
+#pragma once
+
+namespace dxstg {
+
+// Archetype に持たせるコンポーネント
+// オブジェクトごとに違う値だけをコンポーネントにする。種類で決まるもの (大きさ・見た目など) は種類の定数にする。
+
+// 中心の位置
+struct Position {
+	float x, y;
+};
+
+// 1ティックあたりの移動量
+struct Velocity {
+	float x, y;
+};
+
+}
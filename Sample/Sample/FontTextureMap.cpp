@@ -1,21 +1,247 @@
 #include "FontTextureMap.h"
 
+#include <condition_variable>
+#include <deque>
+#include <iterator>
+#include <mutex>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 #include "Common.h"
+#include "GlyphConvert.h"
+#include "SdfGenerator.h"
 
 namespace dxstg {
 
 using Microsoft::WRL::ComPtr;
 
-FontTextureMap::FontTextureMap(ID3D11Device *device, const LOGFONTW& font, bool preMultipliedAlpha) :
+namespace {
+
+// GGO_NATIVE のアウトラインから距離場を作る
+// 距離場の分だけ周りに余白を付け、glyphmetrics もそれに合わせて広げる。
+bool RasterizeSdfGlyph(HDC hdc, HFONT hfont, wchar_t code, GLYPHMETRICS& glyphmetrics, std::unique_ptr<BYTE[]>& pixels)
+{
+	const MAT2 mat = { { 0,1 },{ 0,0 },{ 0,0 },{ 0,1 } };
+	constexpr UINT ggoFormat = GGO_NATIVE | GGO_UNHINTED;
+	HFONT oldFont = (HFONT)SelectObject(hdc, hfont);
+	DWORD size = GetGlyphOutlineW(hdc, code, ggoFormat, &glyphmetrics, 0, NULL, &mat);
+
+	if (size == GDI_ERROR) {
+		SelectObject(hdc, oldFont);
+		return false;
+	}
+
+	if (iswspace(code) || size == 0) {
+		// 空白文字のときはテクスチャは作成しない。
+		SelectObject(hdc, oldFont);
+		return true;
+	}
+
+	std::unique_ptr<BYTE[]> outlineData = std::make_unique<BYTE[]>(size);
+	if (GetGlyphOutlineW(hdc, code, ggoFormat, &glyphmetrics, size, outlineData.get(), &mat) == GDI_ERROR) {
+		SelectObject(hdc, oldFont);
+		return false;
+	}
+	SelectObject(hdc, oldFont);
+
+	GlyphOutline outline;
+	DecodeNativeOutline(outlineData.get(), size, outline);
+
+	constexpr int pad = FontTextureMap::SdfSpread;
+	glyphmetrics.gmBlackBoxX += 2 * pad;
+	glyphmetrics.gmBlackBoxY += 2 * pad;
+	glyphmetrics.gmptGlyphOrigin.x -= pad;
+	glyphmetrics.gmptGlyphOrigin.y += pad;
+
+	const UINT width = glyphmetrics.gmBlackBoxX;
+	const UINT height = glyphmetrics.gmBlackBoxY;
+	pixels = std::make_unique<BYTE[]>(width * height);
+	GenerateSdf(outline,
+		static_cast<float>(glyphmetrics.gmptGlyphOrigin.x), static_cast<float>(glyphmetrics.gmptGlyphOrigin.y),
+		width, height, static_cast<float>(pad), pixels.get());
+	return true;
+}
+
+// GetGlyphOutlineW でグリフを取得し、テクスチャの形式に変換する
+// 空白文字などビットマップがないときは pixels は nullptr になる
+// GDI のエラーのときは false を返す
+bool RasterizeGlyph(HDC hdc, HFONT hfont, wchar_t code, FontTextureMap::Format format, bool preMultipliedAlpha,
+	GLYPHMETRICS& glyphmetrics, std::unique_ptr<BYTE[]>& pixels)
+{
+	pixels.reset();
+
+	if (format == FontTextureMap::Format::SDF8) {
+		return RasterizeSdfGlyph(hdc, hfont, code, glyphmetrics, pixels);
+	}
+
+	// フォントデータの取得
+	const MAT2 mat = { { 0,1 },{ 0,0 },{ 0,0 },{ 0,1 } };
+	HFONT oldFont = (HFONT)SelectObject(hdc, hfont);
+	DWORD size = GetGlyphOutlineW(hdc, code, GGO_GRAY4_BITMAP, &glyphmetrics, 0, NULL, &mat);
+
+	if (size == GDI_ERROR) {
+		SelectObject(hdc, oldFont);
+		return false;
+	}
+
+	if (iswspace(code) || size == 0) {
+		// 空白文字のときはテクスチャは作成しない。
+		SelectObject(hdc, oldFont);
+		return true;
+	}
+
+	// 空白文字でないとき
+	std::unique_ptr<BYTE[]> byteData = std::make_unique<BYTE[]>(size);
+	if (GetGlyphOutlineW(hdc, code, GGO_GRAY4_BITMAP, &glyphmetrics, size, byteData.get(), &mat) == GDI_ERROR) {
+		SelectObject(hdc, oldFont);
+		return false;
+	}
+	SelectObject(hdc, oldFont);
+
+	// フォント情報の書き込み
+	// GGO_GRAY4_BITMAP の各行は4バイト境界に揃っているので、行単位でまとめて変換する。
+	const UINT width = glyphmetrics.gmBlackBoxX;
+	const UINT height = glyphmetrics.gmBlackBoxY;
+	if (format == FontTextureMap::Format::R8) {
+		pixels = std::make_unique<BYTE[]>(width * height);
+		ConvertGray4BitmapA8(byteData.get(), Gray4Pitch(width), pixels.get(), width, height);
+	} else {
+		pixels = std::make_unique<BYTE[]>(width * height * 4);
+		ConvertGray4Bitmap(byteData.get(), Gray4Pitch(width),
+			reinterpret_cast<std::uint32_t*>(pixels.get()), width, height, preMultipliedAlpha);
+	}
+	return true;
+}
+
+} // end unnamed namespace
+
+// ワーカースレッドで作成された1文字分のデータ
+struct FontTextureMap::RasterizedGlyph {
+	wchar_t code;
+	bool ok;
+	GLYPHMETRICS glyphmetrics;
+	std::unique_ptr<BYTE[]> pixels;
+};
+
+// 非同期モードのワーカースレッド
+// 自分専用の HDC と HFONT を持ち、GetGlyphOutlineW と変換だけを行う。
+// D3D11 のリソースの作成はメインスレッドの upload() で行う。
+class FontTextureMap::AsyncRasterizer final {
+public:
+	AsyncRasterizer(const LOGFONTW& font, Format format, bool preMultipliedAlpha) :
+		m_hdc(CreateCompatibleDC(nullptr)),
+		m_hfont(CreateFontIndirectW(&font)),
+		m_format(format),
+		m_preMultipliedAlpha(preMultipliedAlpha),
+		m_quit(false)
+	{
+		if (m_hdc == nullptr || m_hfont == nullptr) {
+			release();
+			throw std::exception("AsyncRasterizer");
+		}
+		m_thread = std::thread([this] { run(); });
+	}
+
+	AsyncRasterizer(const AsyncRasterizer&) = delete;
+	AsyncRasterizer& operator = (const AsyncRasterizer&) = delete;
+
+	~AsyncRasterizer()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_quit = true;
+		}
+		m_cv.notify_one();
+		m_thread.join();
+		release();
+	}
+
+	void request(wchar_t code)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_requests.push_back(code);
+		}
+		m_cv.notify_one();
+	}
+
+	std::vector<RasterizedGlyph> takeFinished()
+	{
+		std::vector<RasterizedGlyph> finished;
+		std::lock_guard<std::mutex> lock(m_mutex);
+		finished.swap(m_finished);
+		return finished;
+	}
+
+	// takeFinished で取り出したもののうち [first, last) を、次の takeFinished で返すように戻す (順番は変えない)
+	void putBack(std::vector<RasterizedGlyph>::iterator first, std::vector<RasterizedGlyph>::iterator last)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_finished.insert(m_finished.begin(), std::make_move_iterator(first), std::make_move_iterator(last));
+	}
+
+private:
+	HDC m_hdc;
+	HFONT m_hfont;
+	const Format m_format;
+	const bool m_preMultipliedAlpha;
+
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::deque<wchar_t> m_requests;          // m_mutex で保護
+	std::vector<RasterizedGlyph> m_finished; // m_mutex で保護
+	bool m_quit;                             // m_mutex で保護
+	std::thread m_thread;
+
+	void run()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (true) {
+			m_cv.wait(lock, [this] { return m_quit || !m_requests.empty(); });
+			if (m_quit) return;
+
+			RasterizedGlyph result;
+			result.code = m_requests.front();
+			m_requests.pop_front();
+			lock.unlock();
+
+			try {
+				result.ok = RasterizeGlyph(m_hdc, m_hfont, result.code, m_format, m_preMultipliedAlpha,
+					result.glyphmetrics, result.pixels);
+			} catch (...) {
+				result.ok = false;
+			}
+
+			lock.lock();
+			m_finished.push_back(std::move(result));
+		}
+	}
+
+	void release()
+	{
+		if (m_hfont) {
+			DeleteObject(m_hfont);
+		}
+		if (m_hdc) {
+			DeleteDC(m_hdc);
+		}
+	}
+};
+
+FontTextureMap::FontTextureMap(ID3D11Device *device, const LOGFONTW& font, bool preMultipliedAlpha, Format format) :
 	m_device(device),
 	m_hdc(GetDC(nullptr)),
 	m_hfont(CreateFontIndirectW(&font)),
 	m_logfont(font),
 	m_textmetric(),
 	m_preMultipliedAlpha(preMultipliedAlpha),
-	m_dataMap()
+	m_format(format),
+	m_dataMap(),
+	m_textureMemorySize(0),
+	m_rasterizer(),
+	m_pendingCount(0),
+	m_missCount(0)
 {
 	if (m_hdc == nullptr) throw std::exception("GetDC");
 	if (m_hfont == nullptr) throw std::exception("CreateFontIndirectW");
@@ -32,10 +258,18 @@ FontTextureMap::FontTextureMap(FontTextureMap&& moved) :
 	m_logfont(moved.m_logfont),
 	m_textmetric(moved.m_textmetric),
 	m_preMultipliedAlpha(moved.m_preMultipliedAlpha),
-	m_dataMap(std::move(moved.m_dataMap))
+	m_format(moved.m_format),
+	m_dataMap(std::move(moved.m_dataMap)),
+	m_textureMemorySize(moved.m_textureMemorySize),
+	m_rasterizer(std::move(moved.m_rasterizer)),
+	m_pendingCount(moved.m_pendingCount),
+	m_missCount(moved.m_missCount)
 {
 	moved.m_hdc = nullptr;
 	moved.m_hfont = nullptr;
+	moved.m_textureMemorySize = 0;
+	moved.m_pendingCount = 0;
+	moved.m_missCount = 0;
 }
 
 FontTextureMap& FontTextureMap::operator = (FontTextureMap&& moved)
@@ -50,10 +284,18 @@ FontTextureMap& FontTextureMap::operator = (FontTextureMap&& moved)
 	m_logfont = moved.m_logfont;
 	m_textmetric = moved.m_textmetric;
 	m_preMultipliedAlpha = moved.m_preMultipliedAlpha;
+	m_format = moved.m_format;
 	m_dataMap = std::move(moved.m_dataMap);
+	m_textureMemorySize = moved.m_textureMemorySize;
+	m_rasterizer = std::move(moved.m_rasterizer);
+	m_pendingCount = moved.m_pendingCount;
+	m_missCount = moved.m_missCount;
 
 	moved.m_hdc = nullptr;
 	moved.m_hfont = nullptr;
+	moved.m_textureMemorySize = 0;
+	moved.m_pendingCount = 0;
+	moved.m_missCount = 0;
 
 	return *this;
 }
@@ -63,159 +305,149 @@ FontTextureMap::~FontTextureMap()
 	release();
 }
 
+FontTextureMap::DataMap::size_type FontTextureMap::erase(wchar_t code)
+{
+	auto it = m_dataMap.find(code);
+	if (it == m_dataMap.end()) return 0;
+
+	m_textureMemorySize -= glyphMemorySize(it->second);
+	return m_dataMap.erase(code);
+}
+
 const FontTextureMap::GlyphData& FontTextureMap::operator [] (wchar_t code)
 {
 	auto it = m_dataMap.find(code);
 	if (it != m_dataMap.end()) {
-		return it->second; // \zς
-	} else {
-		// ܂f[^Ȃ
+		return it->second; // 構築済み (または作成待ち)
+	}
+
+	// まだデータがない
+	++m_missCount;
+	if (m_rasterizer) {
+		// 非同期モード: ワーカースレッドに依頼して、仮の送り幅だけ入れておく
 		GlyphData& charData = m_dataMap[code];
+		charData.glyphmetrics = GLYPHMETRICS();
+		charData.glyphmetrics.gmCellIncX = static_cast<short>(m_textmetric.tmAveCharWidth);
+		charData.pending = true;
+		m_rasterizer->request(code);
+		++m_pendingCount;
+		return charData;
+	}
 
-		// tHgf[^̎擾
-		const MAT2 mat = { { 0,1 },{ 0,0 },{ 0,0 },{ 0,1 } };
-		HFONT oldFont = (HFONT)SelectObject(m_hdc, m_hfont);
-		DWORD size = GetGlyphOutlineW(m_hdc, code, GGO_GRAY4_BITMAP, &charData.glyphmetrics, 0, NULL, &mat);
+	GLYPHMETRICS glyphmetrics;
+	std::unique_ptr<BYTE[]> pixels;
+	if (!RasterizeGlyph(m_hdc, m_hfont, code, m_format, m_preMultipliedAlpha, glyphmetrics, pixels)) {
+		OutputDebugStringW(L"failed: GetGlyphOutlineW\n");
+		throw 1;
+	}
 
-		if (size == GDI_ERROR) {
-			OutputDebugStringW(L"failed: GetGlyphOutlineW (1)\n");
-			SelectObject(m_hdc, oldFont);
-			throw 1;
-		}
+	GlyphData& charData = m_dataMap[code];
+	charData.glyphmetrics = glyphmetrics;
+	if (pixels) {
+		createTexture(charData, pixels.get());
+	}
+	return charData;
+}
 
-		if (iswspace(code)) {
-			// 󔒕̂Ƃ̓eNX`͍쐬ȂB
-			SelectObject(m_hdc, oldFont);
-		} else {
-			// 󔒕łȂƂ
-			std::unique_ptr<BYTE[]> byteData = std::make_unique<BYTE[]>(size);
-			if (GetGlyphOutlineW(m_hdc, code, GGO_GRAY4_BITMAP, &charData.glyphmetrics, size, byteData.get(), &mat) == GDI_ERROR) {
-				OutputDebugStringW(L"failed: GetGlyphOutlineW (2)\n");
-				SelectObject(m_hdc, oldFont);
-				throw 1;
-			}
-			SelectObject(m_hdc, oldFont);
-
-			// tHgf[^̃eNX`ւ̏o
-			// glyphmetrics Ȃǂ̐l̉ http://marupeke296.com/WINT_GetGlyphOutline.html
-#if 1
-			D3D11_TEXTURE2D_DESC tex2dDesc;
-			tex2dDesc.Width = charData.glyphmetrics.gmBlackBoxX;
-			tex2dDesc.Height = charData.glyphmetrics.gmBlackBoxY;
-			tex2dDesc.MipLevels = 1;
-			tex2dDesc.ArraySize = 1;
-			tex2dDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;		// RGBA(255,255,255,255)^Cv
-			tex2dDesc.SampleDesc.Count = 1;
-			tex2dDesc.SampleDesc.Quality = 0;
-			tex2dDesc.Usage = D3D11_USAGE_IMMUTABLE;			// ύXs
-			tex2dDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;	// VF[_\[XƂĎg	
-			tex2dDesc.CPUAccessFlags = 0;						// CPUANZXs
-			tex2dDesc.MiscFlags = 0;
-			
-			std::unique_ptr<DWORD[]> sysData = std::make_unique<DWORD[]>(tex2dDesc.Width * tex2dDesc.Height);
-			
-			// tHg̏
-			// iBmp_w : tHgrbg}bv̕
-			int iBmp_w = charData.glyphmetrics.gmBlackBoxX + (4 - (charData.glyphmetrics.gmBlackBoxX % 4)) % 4;
-			constexpr int Level = 17; // l̒iK (GGO_GRAY4_BITMAPȂ̂17iK)
-			unsigned int x, y;
-			DWORD Alpha;
-
-			// memset(pBits, 0, textureSize);
-			for (y = 0; y < tex2dDesc.Height; y++) {
-				for (x = 0; x < tex2dDesc.Width; x++) {
-					Alpha = (255 * byteData[x + iBmp_w * y]) / (Level - 1);
-					if (m_preMultipliedAlpha) {
-						// Zς݃At@
-						sysData[x + tex2dDesc.Width * y] = (Alpha << 24) | (Alpha << 16) | (Alpha << 8) | Alpha;
-					} else {
-						// ⊮At@
-						sysData[x + tex2dDesc.Width * y] = 0x00ffffff | (Alpha << 24);
-					}
-				}
-			}
+void FontTextureMap::setAsync(bool async)
+{
+	if (async == isAsync()) return;
 
-			D3D11_SUBRESOURCE_DATA initialData;
-			initialData.pSysMem = sysData.get();
-			initialData.SysMemPitch = tex2dDesc.Width * 4;  // 4rgba4oCgȂ̂
-			ComPtr<ID3D11Texture2D> texture;
-
-			ThrowIfFailed(L"CreateTexture2D",
-				m_device->CreateTexture2D(&tex2dDesc, &initialData, texture.ReleaseAndGetAddressOf()));
-
-			// VF[_[\[Xr[̎擾
-			ThrowIfFailed(L"CreateShaderResourceView",
-				m_device->CreateShaderResourceView(texture.Get(), nullptr, charData.shaderResourceView.ReleaseAndGetAddressOf()));
-
-#else
-			// eNX`Ƀ}[Wo[W
-
-			D3D11_TEXTURE2D_DESC tex2dDesc;
-			tex2dDesc.Width = charData.glyphmetrics.gmCellIncX;
-			tex2dDesc.Height = m_textmetric.tmHeight;
-			tex2dDesc.MipLevels = 1;
-			tex2dDesc.ArraySize = 1;
-			tex2dDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;		// RGBA(255,255,255,255)^Cv
-			tex2dDesc.SampleDesc.Count = 1;
-			tex2dDesc.SampleDesc.Quality = 0;
-			tex2dDesc.Usage = D3D11_USAGE_IMMUTABLE;			// ύXs
-			tex2dDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;	// VF[_\[XƂĎg	
-			tex2dDesc.CPUAccessFlags = 0;						// CPUANZXs
-			tex2dDesc.MiscFlags = 0;
-			
-			// tHgeNX`ɏ
-			const size_t textureSize = tex2dDesc.Width * tex2dDesc.Height * 4;
-			std::unique_ptr<BYTE[]> sysData = std::make_unique<BYTE[]>(textureSize);
-			
-			BYTE* pBits = sysData.get();
-			// tHg̏
-			// iOfs_x, iOfs_y : oʒu()
-			// iBmp_w, iBmp_h : tHgrbg}bv̕
-			// Level : l̒iK (GGO_GRAY4_BITMAPȂ̂17iK)
-			int iOfs_x = charData.glyphmetrics.gmptGlyphOrigin.x;
-			int iOfs_y = m_textmetric.tmAscent - charData.glyphmetrics.gmptGlyphOrigin.y;
-			int iBmp_w = charData.glyphmetrics.gmBlackBoxX + (4 - (charData.glyphmetrics.gmBlackBoxX % 4)) % 4;
-			int iBmp_h = charData.glyphmetrics.gmBlackBoxY;
-			int Level = 17;
-			int x, y;
-			DWORD Alpha, Color;
-
-			memset(pBits, 0, textureSize);
-			for (y = iOfs_y; y < iOfs_y + iBmp_h; y++) {
-				for (x = iOfs_x; x < iOfs_x + iBmp_w; x++) {
-					Alpha = (255 * byteData[x - iOfs_x + iBmp_w * (y - iOfs_y)]) / (Level - 1);
-
-					if (m_preMultipliedAlpha) {
-						// Zς݃At@
-						Color = (Alpha << 24) | (Alpha << 16) | (Alpha << 8) | Alpha;
-					} else {
-						// ⊮At@
-						Color = 0x00ffffff | (Alpha << 24);
-					}
-
-					memcpy(
-						(BYTE*)pBits + tex2dDesc.Width * 4 * y + 4 * x,
-						&Color,
-						sizeof(DWORD));
-				}
+	if (async) {
+		m_rasterizer = std::make_unique<AsyncRasterizer>(m_logfont, m_format, m_preMultipliedAlpha);
+	} else {
+		m_rasterizer.reset();  // 作成途中のものは捨てる
+		m_pendingCount = 0;
+
+		// 作成待ちのものは、次に使われたときに同期的に作り直す
+		std::vector<wchar_t> pendingCodes;
+		for (auto it = m_dataMap.cbegin(); it != m_dataMap.cend(); ++it) {
+			if (it->second.pending) {
+				pendingCodes.push_back(it->first);
 			}
+		}
+		for (wchar_t code : pendingCodes) {
+			m_dataMap.erase(code);
+		}
+	}
+}
 
-			D3D11_SUBRESOURCE_DATA initialData;
-			initialData.pSysMem = pBits;
-			initialData.SysMemPitch = tex2dDesc.Width * 4;  // 4rgba4oCgȂ̂
-			ComPtr<ID3D11Texture2D> texture;
+void FontTextureMap::upload()
+{
+	if (!m_rasterizer) return;
 
-			ThrowIfFailed(m_device->CreateTexture2D(&tex2dDesc, &initialData, texture.ReleaseAndGetAddressOf()));
+	std::vector<RasterizedGlyph> finished = m_rasterizer->takeFinished();
+	auto result = finished.begin();
+	try {
+		for (; result != finished.end(); ++result) {
+			--m_pendingCount;
 
-			// VF[_[\[Xr[̎擾
-			ThrowIfFailed(m_device->CreateShaderResourceView(texture.Get(), nullptr, charData.shaderResourceView.ReleaseAndGetAddressOf()));
-#endif
-		}
+			auto it = m_dataMap.find(result->code);
+			if (it == m_dataMap.end() || !it->second.pending) {
+				continue;  // 作成待ちの間に erase された
+			}
 
-		return charData;
+			GlyphData& charData = it->second;
+			charData.pending = false;
+			if (!result->ok) {
+				// 仮の送り幅のままにしておく
+				OutputDebugStringW(L"failed: GetGlyphOutlineW (async)\n");
+				continue;
+			}
+
+			charData.glyphmetrics = result->glyphmetrics;
+			if (result->pixels) {
+				createTexture(charData, result->pixels.get());
+			}
+		}
+	} catch (...) {
+		// 失敗したもの (テクスチャなしで作成済みになる) より後ろはまだ触っていないので、
+		// 作成待ちのまま次の upload() で作れるように戻しておく
+		m_rasterizer->putBack(result + 1, finished.end());
+		throw;
 	}
 }
 
+void FontTextureMap::createTexture(GlyphData& charData, const BYTE* pixels)
+{
+	// フォントデータのテクスチャへの書き出し
+	// glyphmetrics などの数値の解説 http://marupeke296.com/WINT_GetGlyphOutline.html
+	D3D11_TEXTURE2D_DESC tex2dDesc;
+	tex2dDesc.Width = charData.glyphmetrics.gmBlackBoxX;
+	tex2dDesc.Height = charData.glyphmetrics.gmBlackBoxY;
+	tex2dDesc.MipLevels = 1;
+	tex2dDesc.ArraySize = 1;
+	tex2dDesc.Format = m_format == Format::R8G8B8A8
+		? DXGI_FORMAT_R8G8B8A8_UNORM	// RGBA(255,255,255,255)タイプ
+		: DXGI_FORMAT_R8_UNORM;			// αまたは距離のみ。色はシェーダーで展開する
+	tex2dDesc.SampleDesc.Count = 1;
+	tex2dDesc.SampleDesc.Quality = 0;
+	tex2dDesc.Usage = D3D11_USAGE_IMMUTABLE;			// 変更不可
+	tex2dDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;	// シェーダリソースとして使う	
+	tex2dDesc.CPUAccessFlags = 0;						// CPUからアクセス不可
+	tex2dDesc.MiscFlags = 0;
+
+	D3D11_SUBRESOURCE_DATA initialData;
+	initialData.pSysMem = pixels;
+	initialData.SysMemPitch = tex2dDesc.Width * getBytesPerPixel();
+	ComPtr<ID3D11Texture2D> texture;
+
+	ThrowIfFailed(L"CreateTexture2D",
+		m_device->CreateTexture2D(&tex2dDesc, &initialData, texture.ReleaseAndGetAddressOf()));
+
+	// シェーダーリソースビューの取得
+	ThrowIfFailed(L"CreateShaderResourceView",
+		m_device->CreateShaderResourceView(texture.Get(), nullptr, charData.shaderResourceView.ReleaseAndGetAddressOf()));
+
+	m_textureMemorySize += glyphMemorySize(charData);
+}
+
+size_t FontTextureMap::glyphMemorySize(const GlyphData& glyph) const noexcept
+{
+	if (!glyph.shaderResourceView) return 0; // 空白文字
+	return static_cast<size_t>(glyph.glyphmetrics.gmBlackBoxX) * glyph.glyphmetrics.gmBlackBoxY * getBytesPerPixel();
+}
+
 void FontTextureMap::release()
 {
 	if (m_hfont) {
@@ -1,60 +1,108 @@
 #pragma once
 
 #include <memory>
-#include <unordered_map>
 
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 #include <wrl/client.h>
 #include <d3d11.h>
 
+#include "CodePointTable.h"
+
 namespace dxstg {
 
-// ̃eNX`ێ
-// operator [] Őł
-// o֐͑ unordered_map B
-// const֐ȊO̓}`XbhΉłB
+// 文字のテクスチャを保持する
+// operator [] で生成できる
+// メンバ関数は大体 unordered_map 準拠。
+// ただし GlyphData への参照は、次に operator [] や erase を呼ぶまでしか有効でない。
+// const関数以外はマルチスレッド非対応です。
+// setAsync(true) にすると、文字の作成を内部のワーカースレッドで行います。
+// (その場合でもメンバ関数はすべて同じスレッドから呼んでください)
 class FontTextureMap final {
 public:
 	struct GlyphData {
 		GLYPHMETRICS glyphmetrics;
 		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> shaderResourceView;
+		bool pending = false; // 非同期モードで作成待ち。glyphmetrics は仮の送り幅 (gmCellIncX) のみ
+	};
+	using DataMap = CodePointTable<GlyphData>;
+
+	// グリフのテクスチャの形式
+	enum class Format {
+		R8G8B8A8, // RGBA。そのまま普通のピクセルシェーダーで描画できる
+		R8,       // α値のみ。メモリは 1/4 だが、色の展開に TextPixelShader が必要
+		SDF8      // 符号付き距離場 (R8)。LOGFONT の大きさを基準に作り、SdfTextPixelShader でどの大きさにも拡大縮小して描画できる
 	};
-	using DataMap = std::unordered_map<wchar_t, GlyphData>;
 
-	FontTextureMap(ID3D11Device *device, const LOGFONTW& font, bool preMultipliedAlpha);
-	FontTextureMap(const FontTextureMap&) = delete;              // Rs[s
-	FontTextureMap& operator = (const FontTextureMap&) = delete; // Rs[s
-	FontTextureMap(FontTextureMap&&);              // [u
-	FontTextureMap& operator = (FontTextureMap&&); // [u
+	// SDF8 の距離場の幅 (基準の大きさでのピクセル数)。グリフの周りにこの分の余白が付く。
+	static constexpr int SdfSpread = 4;
+
+	FontTextureMap(ID3D11Device *device, const LOGFONTW& font, bool preMultipliedAlpha, Format format = Format::R8G8B8A8);
+	FontTextureMap(const FontTextureMap&) = delete;              // コピー不可
+	FontTextureMap& operator = (const FontTextureMap&) = delete; // コピー不可
+	FontTextureMap(FontTextureMap&&);              // ムーブ可
+	FontTextureMap& operator = (FontTextureMap&&); // ムーブ可
 	~FontTextureMap();
 
 	bool empty() const noexcept { return m_dataMap.empty(); }
 	DataMap::size_type size() const noexcept { return m_dataMap.size(); }
 	DataMap::const_iterator cbegin() const noexcept { return m_dataMap.cbegin(); }
 	DataMap::const_iterator cend() const noexcept { return m_dataMap.cend(); }
-	DataMap::size_type erase(wchar_t code) { return m_dataMap.erase(code); }
-	void clear() { m_dataMap.clear(); }
+	DataMap::size_type erase(wchar_t code);
+	void clear() { m_dataMap.clear(); m_textureMemorySize = 0; }
 	DataMap::const_iterator find(wchar_t code) const { return m_dataMap.find(code); }
 	DataMap::size_type count(wchar_t code) const { return m_dataMap.count(code); }
 	const GlyphData& at(wchar_t code) const { return m_dataMap.at(code); }
-	const GlyphData& operator [] (wchar_t code); // tHgf[^쐬ĂȂꍇ͍쐬
+	const GlyphData& operator [] (wchar_t code); // フォントデータが作成されてない場合は作成する
 
 	const TEXTMETRICW& getTextMetric() const noexcept { return m_textmetric; }
 	const LOGFONTW& getLogFont() const noexcept { return m_logfont; }
 
-	// tHgZς݃At@Ȃ true, ʂ̃At@Ȃ false
+	// 生成されるフォントが乗算済みアルファなら true, 普通のアルファなら false
 	bool isPreMultipliedAlpha() const noexcept { return m_preMultipliedAlpha; }
 
+	Format getFormat() const noexcept { return m_format; }
+	UINT getBytesPerPixel() const noexcept { return m_format == Format::R8G8B8A8 ? 4 : 1; }
+
+	// 保持しているグリフのテクスチャの合計バイト数
+	// (作成時の CPU 側の一時バッファも同じ大きさになる)
+	size_t getTextureMemorySize() const noexcept { return m_textureMemorySize; }
+
+	// 非同期モードの切り替え
+	// 非同期モードでは operator [] はまだない文字をワーカースレッドに依頼し、
+	// 仮の送り幅だけが入った GlyphData (pending == true) を返す。
+	// 出来上がったものは upload() でまとめてテクスチャになる。
+	void setAsync(bool async);
+	bool isAsync() const noexcept { return static_cast<bool>(m_rasterizer); }
+
+	// ワーカースレッドで出来上がった文字のテクスチャを作成する。フレームの最初に呼ぶ。
+	void upload();
+
+	// 作成待ちの文字数
+	size_t getPendingCount() const noexcept { return m_pendingCount; }
+
+	// operator [] でまだなかった (作成することになった) 回数
+	size_t getMissCount() const noexcept { return m_missCount; }
+
 private:
+	struct RasterizedGlyph;
+	class AsyncRasterizer;
+
 	Microsoft::WRL::ComPtr<ID3D11Device> m_device;
-	HDC m_hdc;		// foCXReLXg
-	HFONT m_hfont;	// tHgnh
+	HDC m_hdc;		// デバイスコンテキスト
+	HFONT m_hfont;	// フォントハンドル
 	LOGFONTW m_logfont;
 	TEXTMETRICW m_textmetric;
 	bool m_preMultipliedAlpha;
+	Format m_format;
 	DataMap m_dataMap;
+	size_t m_textureMemorySize;
+	std::unique_ptr<AsyncRasterizer> m_rasterizer;
+	size_t m_pendingCount;
+	size_t m_missCount;
 
+	void createTexture(GlyphData& charData, const BYTE* pixels);
+	size_t glyphMemorySize(const GlyphData& glyph) const noexcept;
 	void release();
 };
 
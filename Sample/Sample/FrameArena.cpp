@@ -0,0 +1,72 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <cwchar>
+#include <new>
+
+namespace dxstg {
+
+LinearArena::LinearArena(size_t capacity)
+	: m_buffer(std::make_unique<unsigned char[]>(capacity))
+	, m_capacity(capacity)
+{
+}
+
+void* LinearArena::allocate(size_t bytes, size_t alignment)
+{
+	const auto base = reinterpret_cast<std::uintptr_t>(m_buffer.get());
+	const std::uintptr_t aligned = (base + m_used + alignment - 1) & ~static_cast<std::uintptr_t>(alignment - 1);
+	const size_t offset = static_cast<size_t>(aligned - base);
+	if (offset <= m_capacity && bytes <= m_capacity - offset) {
+		m_used = offset + bytes;
+		m_highWater = std::max(m_highWater, m_used);
+		return m_buffer.get() + offset;
+	}
+
+	// 足りないときはヒープから
+	++m_overflowCount;
+	return ::operator new(bytes);
+}
+
+void LinearArena::deallocate(void* p) noexcept
+{
+	if (p != nullptr && !owns(p)) {
+		::operator delete(p);
+	}
+}
+
+void LinearArena::reset() noexcept
+{
+	m_used = 0;
+}
+
+size_t FrameArena::highWater() const noexcept
+{
+	return std::max(m_arenas[0].highWater(), m_arenas[1].highWater());
+}
+
+ArenaTextWriter& ArenaTextWriter::operator << (long long v)
+{
+	wchar_t buf[32];
+	const int n = std::swprintf(buf, 32, L"%lld", v);
+	m_text.append(buf, n > 0 ? n : 0);
+	return *this;
+}
+
+ArenaTextWriter& ArenaTextWriter::operator << (unsigned long long v)
+{
+	wchar_t buf[32];
+	const int n = std::swprintf(buf, 32, L"%llu", v);
+	m_text.append(buf, n > 0 ? n : 0);
+	return *this;
+}
+
+ArenaTextWriter& ArenaTextWriter::operator << (double v)
+{
+	wchar_t buf[64];
+	const int n = std::swprintf(buf, 64, L"%g", v);
+	m_text.append(buf, n > 0 ? n : 0);
+	return *this;
+}
+
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace dxstg {
+
+// 先頭から順に切り出すだけのメモリ (バンプアロケータ)
+// 1つずつは解放せず、reset() でまとめて空にする。1つのスレッドだけで使うこと。
+// 足りないときはヒープから取る (あふれた回数を数えるので、容量を決める目安にする)。
+class LinearArena final {
+public:
+	explicit LinearArena(size_t capacity);
+	LinearArena(const LinearArena&) = delete;              // コピー不可
+	LinearArena& operator = (const LinearArena&) = delete; // コピー不可
+	LinearArena(LinearArena&&) = default;
+
+	void* allocate(size_t bytes, size_t alignment);
+
+	// アリーナの中なら何もしない。あふれてヒープから取ったものだけ解放する
+	void deallocate(void* p) noexcept;
+
+	// 空にする (それまでに切り出したものは使えなくなる)
+	void reset() noexcept;
+
+	size_t capacity() const noexcept { return m_capacity; }
+	size_t used() const noexcept { return m_used; }
+	size_t highWater() const noexcept { return m_highWater; }          // used() の最大
+	std::uint64_t overflowCount() const noexcept { return m_overflowCount; } // ヒープから取った回数
+
+private:
+	bool owns(const void* p) const noexcept
+	{
+		const auto* bytes = static_cast<const unsigned char*>(p);
+		return bytes >= m_buffer.get() && bytes < m_buffer.get() + m_capacity;
+	}
+
+	std::unique_ptr<unsigned char[]> m_buffer;
+	size_t m_capacity;
+	size_t m_used = 0;
+	size_t m_highWater = 0;
+	std::uint64_t m_overflowCount = 0;
+};
+
+// 1フレーム (1ティック) の間だけ使うメモリ
+// アリーナを2つ持って交互に使う。endFrame() で切り替えるので、前のフレームで切り出したものは
+// 次のフレームの間まで有効 (作ったものを次のフレームで使う、パイプライン向け)。
+class FrameArena final {
+public:
+	explicit FrameArena(size_t capacityPerFrame) : m_arenas{ LinearArena(capacityPerFrame), LinearArena(capacityPerFrame) } {}
+
+	// このフレームで使うアリーナ
+	LinearArena& current() noexcept { return m_arenas[m_current]; }
+
+	// フレームの終わりに呼ぶ。もう1つのアリーナ (2フレーム前の分) を空にして切り替える
+	void endFrame() noexcept
+	{
+		m_current ^= 1;
+		m_arenas[m_current].reset();
+	}
+
+	size_t capacityPerFrame() const noexcept { return m_arenas[0].capacity(); }
+	size_t highWater() const noexcept;
+	std::uint64_t overflowCount() const noexcept { return m_arenas[0].overflowCount() + m_arenas[1].overflowCount(); }
+
+private:
+	LinearArena m_arenas[2];
+	int m_current = 0;
+};
+
+// LinearArena から取る、標準ライブラリの入れ物用のアロケータ
+// 入れ物はアリーナを reset する前に捨てること。
+template <class T>
+class ArenaAllocator {
+public:
+	using value_type = T;
+
+	explicit ArenaAllocator(LinearArena& arena) noexcept : m_arena(&arena) {}
+	template <class U>
+	ArenaAllocator(const ArenaAllocator<U>& other) noexcept : m_arena(other.arena()) {}
+
+	T* allocate(size_t n)
+	{
+		return static_cast<T*>(m_arena->allocate(n * sizeof(T), alignof(T)));
+	}
+	void deallocate(T* p, size_t) noexcept
+	{
+		m_arena->deallocate(p);
+	}
+
+	LinearArena* arena() const noexcept { return m_arena; }
+
+private:
+	LinearArena* m_arena;
+};
+
+template <class T, class U>
+bool operator == (const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) noexcept { return a.arena() == b.arena(); }
+template <class T, class U>
+bool operator != (const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) noexcept { return a.arena() != b.arena(); }
+
+using ArenaWString = std::basic_string<wchar_t, std::char_traits<wchar_t>, ArenaAllocator<wchar_t>>;
+
+// アリーナの上に文字列を組み立てる (HUD などの std::wostringstream の代わり)
+// std::wostringstream は作るたびにヒープから取るので、毎フレーム作るものはこちらを使う。
+// 数値の書式は std::wostringstream の既定と同じ (浮動小数点数は %g)。
+class ArenaTextWriter final {
+public:
+	explicit ArenaTextWriter(LinearArena& arena, size_t reserve = 1024)
+		: m_text(ArenaAllocator<wchar_t>(arena))
+	{
+		m_text.reserve(reserve);
+	}
+
+	ArenaTextWriter& operator << (const wchar_t* s) { m_text.append(s); return *this; }
+	ArenaTextWriter& operator << (const std::wstring& s) { m_text.append(s.data(), s.size()); return *this; }
+	ArenaTextWriter& operator << (wchar_t c) { m_text.push_back(c); return *this; }
+	ArenaTextWriter& operator << (int v) { return *this << static_cast<long long>(v); }
+	ArenaTextWriter& operator << (long v) { return *this << static_cast<long long>(v); }
+	ArenaTextWriter& operator << (unsigned v) { return *this << static_cast<unsigned long long>(v); }
+	ArenaTextWriter& operator << (unsigned long v) { return *this << static_cast<unsigned long long>(v); }
+	ArenaTextWriter& operator << (long long v);
+	ArenaTextWriter& operator << (unsigned long long v);
+	ArenaTextWriter& operator << (float v) { return *this << static_cast<double>(v); }
+	ArenaTextWriter& operator << (double v);
+
+	const wchar_t* c_str() const noexcept { return m_text.c_str(); }
+	const wchar_t* data() const noexcept { return m_text.data(); }
+	size_t size() const noexcept { return m_text.size(); }
+
+private:
+	ArenaWString m_text;
+};
+
+}
@@ -1,16 +1,48 @@
 #pragma once
 
+#include <cstdint>
 #include <memory>
 
+#include "Components.h"
+#include "Particles.h"
+#include "SlotMap.h"
+
 namespace dxstg {
 
 class StgObject;
 class Player;
 
-void AddObject(std::unique_ptr<StgObject>&& newObject);
+// ゲームオブジェクトを指すハンドル
+// オブジェクトが消えると無効になる。ポインタの代わりにこれを持つこと。
+using ObjectHandle = SlotHandle;
+
+// 追加したオブジェクトのハンドルを返す
+ObjectHandle AddObject(std::unique_ptr<StgObject>&& newObject);
+
+// ハンドルが指すオブジェクト。消えていれば nullptr
+// 返したポインタは、オブジェクトの追加・削除までしか使わないこと。
+StgObject* FindObject(ObjectHandle handle);
+
+// 敵の弾を出す (EnemyBullet::lifetime ティックで消える)
+void SpawnEnemyBullet(Position position, Velocity velocity);
+
+// エフェクトのパーティクルを出す
+void EmitParticles(const ParticleBurst& burst);
 
+// オブジェクトに届けるタイマーの種類
+enum class TimerEvent {
+	EXPIRE, // 寿命が来た
+	FIRE,   // 弾を撃つ
+	PHASE   // 動きを切り替える
+};
+
+// delayTicks ティック後に、target の onTimer(event) を呼ぶ
+// その前に target が消えていれば何もしない (取り消す必要はない)。
+void ScheduleTimer(ObjectHandle target, std::uint32_t delayTicks, TimerEvent event);
+
+// 自機 (いなければ nullptr)
 Player* GetPlayer();
-void SetPlayer(Player*);
+void SetPlayer(ObjectHandle player);
 
 struct Input {
 	bool left : 1;
@@ -19,6 +51,11 @@ struct Input {
 	bool down : 1;
 };
 
+// このティックの間に押されていたキー (ティックの途中で押して離したものも含む)
 Input GetInput();
 
+// このティックで押された・離されたキー
+Input GetPressedInput();
+Input GetReleasedInput();
+
 } // end namespace dxstg
@@ -0,0 +1,170 @@
+#include "GlyphConvert.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define DXSTG_GLYPH_SSE2
+#include <emmintrin.h>
+#elif defined(_M_ARM64) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define DXSTG_GLYPH_NEON
+#endif
+
+namespace dxstg {
+
+namespace {
+
+constexpr std::uint32_t Level = 17; // α値の段階 (GGO_GRAY4_BITMAPなので17段階)
+
+// スカラー版。SIMD版の端数処理にも使う。
+inline void ConvertGray4RowScalar(const std::uint8_t* src, std::uint32_t* dst, std::size_t width, bool preMultipliedAlpha) noexcept
+{
+	for (std::size_t x = 0; x < width; ++x) {
+		const std::uint32_t Alpha = (255 * src[x]) / (Level - 1);
+		if (preMultipliedAlpha) {
+			// 乗算済みアルファ
+			dst[x] = (Alpha << 24) | (Alpha << 16) | (Alpha << 8) | Alpha;
+		} else {
+			// 補完アルファ
+			dst[x] = 0x00ffffff | (Alpha << 24);
+		}
+	}
+}
+
+inline void ConvertGray4RowA8Scalar(const std::uint8_t* src, std::uint8_t* dst, std::size_t width) noexcept
+{
+	for (std::size_t x = 0; x < width; ++x) {
+		dst[x] = static_cast<std::uint8_t>((255 * src[x]) / (Level - 1));
+	}
+}
+
+} // end unnamed namespace
+
+void ConvertGray4Row(const std::uint8_t* src, std::uint32_t* dst, std::size_t width, bool preMultipliedAlpha) noexcept
+{
+	std::size_t x = 0;
+
+#if defined(__AVX2__)
+	// 8画素ずつ 32bit に広げてから計算する。
+	// (255 * v) / 16 は (v * 256 - v) >> 4 と同じ。
+	const __m256i white = _mm256_set1_epi32(0x00ffffff);
+	for (; x + 8 <= width; x += 8) {
+		const __m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + x)));
+		const __m256i a = _mm256_srli_epi32(_mm256_sub_epi32(_mm256_slli_epi32(v, 8), v), 4);
+		__m256i color;
+		if (preMultipliedAlpha) {
+			color = _mm256_or_si256(
+				_mm256_or_si256(_mm256_slli_epi32(a, 24), _mm256_slli_epi32(a, 16)),
+				_mm256_or_si256(_mm256_slli_epi32(a, 8), a));
+		} else {
+			color = _mm256_or_si256(white, _mm256_slli_epi32(a, 24));
+		}
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x), color);
+	}
+#elif defined(DXSTG_GLYPH_SSE2)
+	// 16画素ずつ処理する。入力は 0～16 なので 255 * v は 16bit に収まる。
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_set1_epi8(-1);
+	const __m128i m255 = _mm_set1_epi16(255);
+	for (; x + 16 <= width; x += 16) {
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+		const __m128i lo = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(v, zero), m255), 4);
+		const __m128i hi = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(v, zero), m255), 4);
+		const __m128i a = _mm_packus_epi16(lo, hi);
+
+		__m128i color[4];
+		if (preMultipliedAlpha) {
+			// (a, a, a, a)
+			const __m128i aa0 = _mm_unpacklo_epi8(a, a);
+			const __m128i aa1 = _mm_unpackhi_epi8(a, a);
+			color[0] = _mm_unpacklo_epi16(aa0, aa0);
+			color[1] = _mm_unpackhi_epi16(aa0, aa0);
+			color[2] = _mm_unpacklo_epi16(aa1, aa1);
+			color[3] = _mm_unpackhi_epi16(aa1, aa1);
+		} else {
+			// (255, 255, 255, a)
+			const __m128i fa0 = _mm_unpacklo_epi8(ones, a);
+			const __m128i fa1 = _mm_unpackhi_epi8(ones, a);
+			color[0] = _mm_unpacklo_epi16(ones, fa0);
+			color[1] = _mm_unpackhi_epi16(ones, fa0);
+			color[2] = _mm_unpacklo_epi16(ones, fa1);
+			color[3] = _mm_unpackhi_epi16(ones, fa1);
+		}
+		for (int i = 0; i < 4; ++i) {
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x) + i, color[i]);
+		}
+	}
+#elif defined(DXSTG_GLYPH_NEON)
+	// 16画素ずつ処理し、インターリーブして書き込む。
+	const uint8x8_t m255 = vdup_n_u8(255);
+	const uint8x16_t ones = vdupq_n_u8(255);
+	for (; x + 16 <= width; x += 16) {
+		const uint8x16_t v = vld1q_u8(src + x);
+		const uint16x8_t lo = vshrq_n_u16(vmull_u8(vget_low_u8(v), m255), 4);
+		const uint16x8_t hi = vshrq_n_u16(vmull_u8(vget_high_u8(v), m255), 4);
+		const uint8x16_t a = vcombine_u8(vqmovn_u16(lo), vqmovn_u16(hi));
+
+		uint8x16x4_t color;
+		if (preMultipliedAlpha) {
+			color.val[0] = a;
+			color.val[1] = a;
+			color.val[2] = a;
+		} else {
+			color.val[0] = ones;
+			color.val[1] = ones;
+			color.val[2] = ones;
+		}
+		color.val[3] = a;
+		vst4q_u8(reinterpret_cast<std::uint8_t*>(dst + x), color);
+	}
+#endif
+
+	// 端数
+	ConvertGray4RowScalar(src + x, dst + x, width - x, preMultipliedAlpha);
+}
+
+void ConvertGray4Bitmap(const std::uint8_t* src, std::size_t srcPitch,
+	std::uint32_t* dst, std::size_t width, std::size_t height, bool preMultipliedAlpha) noexcept
+{
+	for (std::size_t y = 0; y < height; ++y) {
+		ConvertGray4Row(src + srcPitch * y, dst + width * y, width, preMultipliedAlpha);
+	}
+}
+
+void ConvertGray4RowA8(const std::uint8_t* src, std::uint8_t* dst, std::size_t width) noexcept
+{
+	std::size_t x = 0;
+
+#if defined(__AVX2__) || defined(DXSTG_GLYPH_SSE2)
+	// 16画素ずつ処理する。
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i m255 = _mm_set1_epi16(255);
+	for (; x + 16 <= width; x += 16) {
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+		const __m128i lo = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(v, zero), m255), 4);
+		const __m128i hi = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(v, zero), m255), 4);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(lo, hi));
+	}
+#elif defined(DXSTG_GLYPH_NEON)
+	const uint8x8_t m255 = vdup_n_u8(255);
+	for (; x + 16 <= width; x += 16) {
+		const uint8x16_t v = vld1q_u8(src + x);
+		const uint16x8_t lo = vshrq_n_u16(vmull_u8(vget_low_u8(v), m255), 4);
+		const uint16x8_t hi = vshrq_n_u16(vmull_u8(vget_high_u8(v), m255), 4);
+		vst1q_u8(dst + x, vcombine_u8(vqmovn_u16(lo), vqmovn_u16(hi)));
+	}
+#endif
+
+	// 端数
+	ConvertGray4RowA8Scalar(src + x, dst + x, width - x);
+}
+
+void ConvertGray4BitmapA8(const std::uint8_t* src, std::size_t srcPitch,
+	std::uint8_t* dst, std::size_t width, std::size_t height) noexcept
+{
+	for (std::size_t y = 0; y < height; ++y) {
+		ConvertGray4RowA8(src + srcPitch * y, dst + width * y, width);
+	}
+}
+
+}
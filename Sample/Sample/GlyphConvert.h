@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dxstg {
+
+// GetGlyphOutlineW (GGO_GRAY4_BITMAP) で得たビットマップを RGBA に変換する。
+// GGO_GRAY4_BITMAP の各画素は 0～16 の17段階で、各行は4バイト境界に揃えられている。
+// 変換結果は (255 * v) / 16 をα値とした以前のスカラー実装とビット単位で一致する。
+// SSE2 / AVX2 / NEON が使えるときはそれを使い、端数はスカラーで処理する。
+
+// 1行分を変換する
+// src : GGO_GRAY4_BITMAP の1行 (width バイト以上)
+// dst : 出力先 (width 画素)
+void ConvertGray4Row(const std::uint8_t* src, std::uint32_t* dst, std::size_t width, bool preMultipliedAlpha) noexcept;
+
+// ビットマップ全体を変換する
+// srcPitch : GGO_GRAY4_BITMAP の1行のバイト数 (4の倍数)
+// dst は width * height 画素の隙間のない配列
+void ConvertGray4Bitmap(const std::uint8_t* src, std::size_t srcPitch,
+	std::uint32_t* dst, std::size_t width, std::size_t height, bool preMultipliedAlpha) noexcept;
+
+// α値だけを1バイトで書き出す版 (DXGI_FORMAT_R8_UNORM 用)
+// 値は RGBA 版のα値と同じ。色はピクセルシェーダーで展開する。
+void ConvertGray4RowA8(const std::uint8_t* src, std::uint8_t* dst, std::size_t width) noexcept;
+void ConvertGray4BitmapA8(const std::uint8_t* src, std::size_t srcPitch,
+	std::uint8_t* dst, std::size_t width, std::size_t height) noexcept;
+
+// GGO_GRAY4_BITMAP の1行のバイト数 (4バイト境界に切り上げ)
+constexpr std::size_t Gray4Pitch(std::size_t width) noexcept
+{
+	return (width + 3) & ~static_cast<std::size_t>(3);
+}
+
+}
@@ -1,9 +1,20 @@
+// 頂点の形式は SpriteEncoding.h の SpriteVertex と合わせること
 struct VSIn {
-    float3 pos : POSITION;
-    float2 uv : TEXCOORD;
+    int2 pos : POSITION;    // (原点からの位置 / positionUnit) * 2 + テクスチャの角 (0 か 1)
+    float4 color : COLOR;   // RGBA8 (乗算済みアルファ)
 };
 
 struct PSIn {
     float4 pos : SV_POSITION;
     float2 uv : TEXCOORD;
+    float4 color : COLOR;
+};
+
+// インスタンスごとの形式は SpriteEncoding.h の SpriteInstance と合わせること
+struct VSInstanceIn {
+    int2 center : POSITION;     // 中心の位置 / positionUnit
+    uint2 halfSize : SIZE;      // (大きさの半分 / positionUnit) * 2 + 反転フラグ
+    float4 uvRect : TEXCOORD;   // u0, v0, u1, v1
+    float4 color : COLOR;       // RGBA8 (乗算済みアルファ)
+    uint vertexID : SV_VertexID;
 };
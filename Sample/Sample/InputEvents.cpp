@@ -0,0 +1,151 @@
+#include "InputEvents.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace dxstg {
+
+namespace {
+
+bool GetKey(const Input& input, Key key) noexcept
+{
+	switch (key) {
+		case Key::LEFT:  return input.left;
+		case Key::RIGHT: return input.right;
+		case Key::UP:    return input.up;
+		case Key::DOWN:  return input.down;
+	}
+	return false;
+}
+
+void SetKey(Input& input, Key key, bool value) noexcept
+{
+	switch (key) {
+		case Key::LEFT:  input.left = value;  break;
+		case Key::RIGHT: input.right = value; break;
+		case Key::UP:    input.up = value;    break;
+		case Key::DOWN:  input.down = value;  break;
+	}
+}
+
+} // end unnamed namespace
+
+Input InputFromKeyMask(KeyMask mask) noexcept
+{
+	Input input = Input();
+	for (Key key : { Key::LEFT, Key::RIGHT, Key::UP, Key::DOWN }) {
+		SetKey(input, key, (mask & KeyBit(key)) != 0);
+	}
+	return input;
+}
+
+size_t PushInputChanges(InputEventQueue& queue, const Input& previous, const Input& held, std::int64_t time) noexcept
+{
+	size_t dropped = 0;
+	for (Key key : { Key::LEFT, Key::RIGHT, Key::UP, Key::DOWN }) {
+		const bool pressed = GetKey(held, key);
+		if (GetKey(previous, key) == pressed) continue;
+		if (!queue.tryPush({ time, key, pressed })) ++dropped;
+	}
+	return dropped;
+}
+
+std::int64_t InputClockNow() noexcept
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void LatencyHistogram::add(std::int64_t latencyNs) noexcept
+{
+	latencyNs = std::max<std::int64_t>(latencyNs, 0);
+
+	// マイクロ秒の桁数 (ビット数) がバケットの番号
+	std::uint64_t us = static_cast<std::uint64_t>(latencyNs / 1000);
+	int i = 0;
+	while (us != 0 && i < BucketCount - 1) {
+		us >>= 1;
+		++i;
+	}
+
+	++m_buckets[i];
+	++m_count;
+	m_sumNs += latencyNs;
+	m_maxNs = std::max(m_maxNs, latencyNs);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) noexcept
+{
+	for (int i = 0; i < BucketCount; ++i) {
+		m_buckets[i] += other.m_buckets[i];
+	}
+	m_count += other.m_count;
+	m_sumNs += other.m_sumNs;
+	m_maxNs = std::max(m_maxNs, other.m_maxNs);
+}
+
+void LatencyHistogram::reset() noexcept
+{
+	*this = LatencyHistogram();
+}
+
+double LatencyHistogram::bucketUpperMs(int i) noexcept
+{
+	return static_cast<double>(std::uint64_t(1) << i) / 1000.0;
+}
+
+double LatencyHistogram::meanMs() const noexcept
+{
+	return m_count ? m_sumNs / 1e6 / m_count : 0.0;
+}
+
+double LatencyHistogram::percentileMs(double p) const noexcept
+{
+	if (m_count == 0) return 0.0;
+
+	const auto rank = static_cast<std::uint64_t>(std::max(0.0, std::min(p, 1.0)) * (m_count - 1)) + 1;
+	std::uint64_t seen = 0;
+	for (int i = 0; i < BucketCount; ++i) {
+		seen += m_buckets[i];
+		if (seen >= rank) {
+			return std::min(bucketUpperMs(i), maxMs());
+		}
+	}
+	return maxMs();
+}
+
+void InputTracker::beginTick(InputEventQueue& queue, std::int64_t tickTime) noexcept
+{
+	// 前のティックから押し続けているキーから始める
+	m_down = m_held;
+	m_pressed = Input();
+	m_released = Input();
+
+	InputEvent e;
+	while (queue.tryPop(e)) {
+		m_latency.add(tickTime - e.time);
+
+		setHeld(e.key, e.pressed);
+	}
+}
+
+void InputTracker::resync(const Input& held) noexcept
+{
+	for (Key key : { Key::LEFT, Key::RIGHT, Key::UP, Key::DOWN }) {
+		setHeld(key, GetKey(held, key));
+	}
+}
+
+void InputTracker::setHeld(Key key, bool pressed) noexcept
+{
+	if (GetKey(m_held, key) == pressed) return; // 状態が変わらない (取りこぼしたイベントの後など)
+	SetKey(m_held, key, pressed);
+	if (pressed) {
+		SetKey(m_pressed, key, true);
+		SetKey(m_down, key, true);
+	} else {
+		SetKey(m_released, key, true);
+	}
+}
+
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Game.h"
+#include "SpscQueue.h"
+
+namespace dxstg {
+
+// ゲームで使うキー
+enum class Key : std::uint8_t {
+	LEFT,
+	RIGHT,
+	UP,
+	DOWN
+};
+
+// キーを押した・離したときのイベント
+struct InputEvent {
+	std::int64_t time; // InputClockNow() で得た時刻
+	Key key;
+	bool pressed;      // true なら押した、false なら離した
+};
+
+// WndProc (メインスレッド) からシミュレーションスレッドに渡すキュー
+using InputEventQueue = SpscQueue<InputEvent, 256>;
+
+// 押しているキーのビットの集まり (Key の番号のビット)
+// キューがいっぱいでイベントを捨てたときに、実際に押しているキーを別に渡すのに使う。
+using KeyMask = std::uint8_t;
+
+constexpr KeyMask KeyBit(Key key) noexcept
+{
+	return static_cast<KeyMask>(1u << static_cast<unsigned>(key));
+}
+
+Input InputFromKeyMask(KeyMask mask) noexcept;
+
+// previous から held に変わったキーのイベントを queue に入れる (ボットなど、押しているキーしか分からないとき用)
+// 入らなかったイベントの数を返す
+size_t PushInputChanges(InputEventQueue& queue, const Input& previous, const Input& held, std::int64_t time) noexcept;
+
+// InputEvent::time の時計 (steady_clock のナノ秒)
+std::int64_t InputClockNow() noexcept;
+
+// 遅延の分布
+// 2のべき乗のマイクロ秒ごとに数える。バケット i は [2^(i-1), 2^i) us (バケット 0 は 1us 未満)。
+class LatencyHistogram final {
+public:
+	static constexpr int BucketCount = 24; // 最後のバケットはそれ以上すべて
+
+	void add(std::int64_t latencyNs) noexcept;
+	void merge(const LatencyHistogram& other) noexcept;
+	void reset() noexcept;
+
+	std::uint64_t count() const noexcept { return m_count; }
+	std::uint64_t bucket(int i) const noexcept { return m_buckets[i]; }
+	static double bucketUpperMs(int i) noexcept; // バケット i の上端
+
+	double meanMs() const noexcept;
+	double maxMs() const noexcept { return m_maxNs / 1e6; }
+
+	// p (0～1) 番目の値が入っているバケットの上端 (最大値を超えない)
+	double percentileMs(double p) const noexcept;
+
+private:
+	std::uint64_t m_buckets[BucketCount] = {};
+	std::uint64_t m_count = 0;
+	std::int64_t m_sumNs = 0;
+	std::int64_t m_maxNs = 0;
+};
+
+// シミュレーションのティックごとの入力
+// ティックの最初にキューを空にして、そのティックの入力を作る。
+// ティックの途中で押して離したキーも、そのティックでは押されていたことになる (短い入力を落とさない)。
+class InputTracker final {
+public:
+	// queue のイベントをすべて取り出す。tickTime はこのティックの時刻 (遅延の計算に使う)
+	void beginTick(InputEventQueue& queue, std::int64_t tickTime) noexcept;
+
+	// 押しているキーを held に合わせる (イベントを取りこぼしたとき用)
+	// 違っていたキーは、このティックで押された・離されたことにする。
+	// 最初の beginTick より前に呼ぶと、押されたことにはせずに始めの状態だけを決める。
+	void resync(const Input& held) noexcept;
+
+	const Input& held() const noexcept { return m_held; }             // 今押しているキー
+
+	const Input& down() const noexcept { return m_down; }         // このティックの間に押されていたキー
+	const Input& pressed() const noexcept { return m_pressed; }   // このティックで押されたキー
+	const Input& released() const noexcept { return m_released; } // このティックで離されたキー
+
+	// イベントの時刻から、それを取り出したティックまでの遅延
+	const LatencyHistogram& latency() const noexcept { return m_latency; }
+	LatencyHistogram& latency() noexcept { return m_latency; }
+
+private:
+	Input m_held = Input();     // 今押しているキー
+	Input m_down = Input();
+	Input m_pressed = Input();
+	Input m_released = Input();
+	LatencyHistogram m_latency;
+
+	void setHeld(Key key, bool pressed) noexcept;
+};
+
+}
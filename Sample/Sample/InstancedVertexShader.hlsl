@@ -0,0 +1,29 @@
+#include "Header.hlsli"
+
+// インスタンス描画用の頂点シェーダー
+// 頂点バッファはなく、インスタンスごとのデータから SV_VertexID (0～3) で四角形の角を作る。
+// TRIANGLESTRIP で 4 頂点ずつ描画すること。
+
+cbuffer CBuffer : register(b0) {  // VertexShader.hlsl と同じ
+    matrix viewProj;
+    float2 positionOrigin;  // バッチの原点
+    float positionUnit;     // 位置の 1 あたりの大きさ
+}
+
+PSIn main(VSInstanceIn input)
+{
+    uint2 corner = uint2(input.vertexID & 1, input.vertexID >> 1);
+
+    float2 center = input.center * positionUnit + positionOrigin;
+    float2 halfSize = (input.halfSize >> 1) * positionUnit;
+    float2 pos = center + (float2(corner) * 2 - 1) * halfSize;
+
+    // 反転フラグが立っていれば UV を逆向きにする
+    float2 t = float2(corner ^ (input.halfSize & 1));
+
+    PSIn output;
+    output.pos = mul(float4(pos, 0, 1), viewProj);
+    output.uv = lerp(input.uvRect.xy, input.uvRect.zw, t);
+    output.color = input.color;
+    return output;
+}
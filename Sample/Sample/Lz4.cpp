@@ -0,0 +1,66 @@
+#include "Lz4.h"
+
+#include <cstring>
+
+namespace dxstg {
+
+namespace {
+
+// 255 が続く長さの追加バイトを読む
+bool ReadLength(const std::uint8_t*& ip, const std::uint8_t* iend, std::size_t& length) noexcept
+{
+	std::uint8_t b;
+	do {
+		if (ip >= iend) return false;
+		b = *ip++;
+		length += b;
+	} while (b == 255);
+	return true;
+}
+
+} // end unnamed namespace
+
+bool Lz4Decompress(const std::uint8_t* src, std::size_t srcSize, std::uint8_t* dst, std::size_t dstSize) noexcept
+{
+	const std::uint8_t* ip = src;
+	const std::uint8_t* const iend = src + srcSize;
+	std::uint8_t* op = dst;
+	std::uint8_t* const oend = dst + dstSize;
+
+	while (ip < iend) {
+		const std::uint8_t token = *ip++;
+
+		// リテラル
+		std::size_t literalLength = token >> 4;
+		if (literalLength == 15 && !ReadLength(ip, iend, literalLength)) return false;
+		if (literalLength > static_cast<std::size_t>(iend - ip)) return false;
+		if (literalLength > static_cast<std::size_t>(oend - op)) return false;
+		std::memcpy(op, ip, literalLength);
+		ip += literalLength;
+		op += literalLength;
+
+		if (ip == iend) break;  // 最後のシーケンスはリテラルのみ
+
+		// マッチ
+		if (iend - ip < 2) return false;
+		const std::size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > static_cast<std::size_t>(op - dst)) return false;
+
+		std::size_t matchLength = token & 15;
+		if (matchLength == 15 && !ReadLength(ip, iend, matchLength)) return false;
+		matchLength += 4;
+		if (matchLength > static_cast<std::size_t>(oend - op)) return false;
+
+		// 重なることがあるので1バイトずつコピーする
+		const std::uint8_t* match = op - offset;
+		for (std::size_t i = 0; i < matchLength; ++i) {
+			op[i] = match[i];
+		}
+		op += matchLength;
+	}
+
+	return op == oend;
+}
+
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dxstg {
+
+// LZ4 のブロック形式 (フレームなし) を展開する
+// 参考: https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+// dst にはちょうど dstSize バイト書き込まれたときだけ true を返す。
+// 壊れたデータでも src, dst の範囲外にはアクセスしない。
+bool Lz4Decompress(const std::uint8_t* src, std::size_t srcSize, std::uint8_t* dst, std::size_t dstSize) noexcept;
+
+}
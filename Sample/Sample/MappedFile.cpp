@@ -0,0 +1,87 @@
+#include "MappedFile.h"
+
+#include <utility>
+
+namespace dxstg {
+
+MappedFile::MappedFile(const wchar_t* fpath)
+{
+	m_file = CreateFileW(fpath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE) return;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(m_file, &fileSize) || fileSize.QuadPart == 0) {
+		// 空のファイルはマップできない
+		release();
+		return;
+	}
+
+	m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mapping == nullptr) {
+		release();
+		return;
+	}
+
+	m_data = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (m_data == nullptr) {
+		release();
+		return;
+	}
+	m_size = static_cast<size_t>(fileSize.QuadPart);
+}
+
+MappedFile::MappedFile(MappedFile&& moved) noexcept :
+	m_file(std::exchange(moved.m_file, INVALID_HANDLE_VALUE)),
+	m_mapping(std::exchange(moved.m_mapping, nullptr)),
+	m_data(std::exchange(moved.m_data, nullptr)),
+	m_size(std::exchange(moved.m_size, 0))
+{
+}
+
+MappedFile& MappedFile::operator = (MappedFile&& moved) noexcept
+{
+	if (this == &moved) return *this;
+
+	release();
+	m_file = std::exchange(moved.m_file, INVALID_HANDLE_VALUE);
+	m_mapping = std::exchange(moved.m_mapping, nullptr);
+	m_data = std::exchange(moved.m_data, nullptr);
+	m_size = std::exchange(moved.m_size, 0);
+	return *this;
+}
+
+MappedFile::~MappedFile()
+{
+	release();
+}
+
+void MappedFile::release() noexcept
+{
+	if (m_data) {
+		UnmapViewOfFile(m_data);
+		m_data = nullptr;
+	}
+	if (m_mapping) {
+		CloseHandle(m_mapping);
+		m_mapping = nullptr;
+	}
+	if (m_file != INVALID_HANDLE_VALUE) {
+		CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+	}
+	m_size = 0;
+}
+
+void TouchPages(const void* data, size_t size) noexcept
+{
+	constexpr size_t PageSize = 4096;
+	const auto bytes = static_cast<const volatile unsigned char*>(data);
+	unsigned char sum = 0;
+	for (size_t i = 0; i < size; i += PageSize) {
+		sum += bytes[i];
+	}
+	if (size > 0) sum += bytes[size - 1];
+	static_cast<void>(sum);
+}
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+namespace dxstg {
+
+// 読み込み専用でメモリマップしたファイル
+// 中身はコピーせずに get() からそのまま参照できる。
+class MappedFile final {
+public:
+	MappedFile() = default;
+	explicit MappedFile(const wchar_t* fpath);
+	MappedFile(const MappedFile&) = delete;              // コピー不可
+	MappedFile& operator = (const MappedFile&) = delete; // コピー不可
+	MappedFile(MappedFile&&) noexcept;              // ムーブ可
+	MappedFile& operator = (MappedFile&&) noexcept; // ムーブ可
+	~MappedFile();
+
+	explicit operator bool() const noexcept { return m_data != nullptr; }
+	const void* get() const noexcept { return m_data; }
+	size_t size() const noexcept { return m_size; }
+
+private:
+	HANDLE m_file = INVALID_HANDLE_VALUE;
+	HANDLE m_mapping = nullptr;
+	const void* m_data = nullptr;
+	size_t m_size = 0;
+
+	void release() noexcept;
+};
+
+// マップした範囲を 4KiB ごとに1バイト読んで、すべてのページをページフォールトで読み込ませる
+// 先読みを頼むだけではなく、読み込みが終わるまで呼んだスレッドが止まる。
+// ワーカースレッドで呼んでおくと、後でメインスレッドが触るときにディスクを待たずに済む (メモリが足りなければ捨てられることはある)。
+void TouchPages(const void* data, size_t size) noexcept;
+
+}
@@ -0,0 +1,373 @@
+#include "Metrics.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#define WIN32_LEAN_AND_MEAN
+#include <WinSock2.h>
+#include <WS2tcpip.h>
+#include <Windows.h>
+
+#pragma comment(lib, "ws2_32.lib")
+
+namespace {
+
+#if defined(DXSTG_COUNT_ALLOCATIONS)
+// operator new / delete の回数 (静的な初期化より前から数えられるように、定数で初期化する)
+std::atomic<std::uint64_t> allocationCount{ 0 };
+std::atomic<std::uint64_t> deallocationCount{ 0 };
+#endif
+
+constexpr double histogramBounds[dxstg::MetricHistogram::BucketCount - 1] = {
+	0.00025, 0.0005, 0.001, 0.002, 0.004, 0.008, 0.0167, 0.0333, 0.0667, 0.125, 0.25
+};
+
+constexpr int httpPollMs = 100;       // 止めるときに気付くまでの時間
+constexpr int httpReceiveTimeoutMs = 1000;
+constexpr size_t httpRequestLimit = 4096;
+
+void FormatNumber(char (&buf)[32], double value)
+{
+	if (std::isnan(value)) {
+		std::snprintf(buf, sizeof(buf), "NaN");
+	} else if (std::isinf(value)) {
+		std::snprintf(buf, sizeof(buf), value > 0 ? "+Inf" : "-Inf");
+	} else {
+		std::snprintf(buf, sizeof(buf), "%.9g", value);
+	}
+}
+
+bool SendAll(SOCKET s, const char* data, size_t size)
+{
+	while (size > 0) {
+		const int sent = send(s, data, static_cast<int>(std::min<size_t>(size, INT_MAX)), 0);
+		if (sent <= 0) return false;
+		data += sent;
+		size -= sent;
+	}
+	return true;
+}
+
+} // end unnamed namespace
+
+#if defined(DXSTG_COUNT_ALLOCATIONS)
+// すべての new / delete はここを通る (new[] や nothrow 版、delete[] も既定ではこれを呼ぶ)
+void* operator new(std::size_t size)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	if (size == 0) size = 1;
+	while (true) {
+		void* p = std::malloc(size);
+		if (p != nullptr) return p;
+		const std::new_handler handler = std::get_new_handler();
+		if (handler == nullptr) throw std::bad_alloc();
+		handler();
+	}
+}
+
+void operator delete(void* p) noexcept
+{
+	if (p == nullptr) return;
+	deallocationCount.fetch_add(1, std::memory_order_relaxed);
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	::operator delete(p);
+}
+#endif
+
+namespace dxstg {
+
+std::uint64_t AllocationCount() noexcept
+{
+#if defined(DXSTG_COUNT_ALLOCATIONS)
+	return allocationCount.load(std::memory_order_relaxed);
+#else
+	return 0;
+#endif
+}
+
+std::uint64_t DeallocationCount() noexcept
+{
+#if defined(DXSTG_COUNT_ALLOCATIONS)
+	return deallocationCount.load(std::memory_order_relaxed);
+#else
+	return 0;
+#endif
+}
+
+double MetricHistogram::bucketUpperSeconds(int i) noexcept
+{
+	return i < BucketCount - 1 ? histogramBounds[i] : HUGE_VAL;
+}
+
+MetricHistogram::MetricHistogram() noexcept
+{
+	for (auto& bucket : m_buckets) {
+		bucket.store(0, std::memory_order_relaxed);
+	}
+}
+
+void MetricHistogram::observe(double seconds) noexcept
+{
+	int i = 0;
+	while (i < BucketCount - 1 && seconds > histogramBounds[i]) {
+		++i;
+	}
+	m_buckets[i].fetch_add(1, std::memory_order_relaxed);
+	m_sumNs.fetch_add(static_cast<std::uint64_t>(std::max(seconds, 0.0) * 1e9), std::memory_order_relaxed);
+}
+
+MetricHistogram::Snapshot MetricHistogram::snapshot() const noexcept
+{
+	// 数はバケットの合計にする (+Inf のバケットと count が必ず同じになる)
+	Snapshot snapshot;
+	snapshot.count = 0;
+	for (int i = 0; i < BucketCount; ++i) {
+		snapshot.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+		snapshot.count += snapshot.buckets[i];
+	}
+	snapshot.sumSeconds = m_sumNs.load(std::memory_order_relaxed) / 1e9;
+	return snapshot;
+}
+
+double MetricHistogram::Snapshot::quantile(double q) const noexcept
+{
+	if (count == 0) return 0.0;
+
+	const double rank = std::min(std::max(q, 0.0), 1.0) * count;
+	std::uint64_t below = 0;
+	for (int i = 0; i < BucketCount; ++i) {
+		if (below + buckets[i] >= rank && buckets[i] > 0) {
+			if (i == BucketCount - 1) return histogramBounds[BucketCount - 2];
+			const double lower = i > 0 ? histogramBounds[i - 1] : 0.0;
+			return lower + (histogramBounds[i] - lower) * (rank - below) / buckets[i];
+		}
+		below += buckets[i];
+	}
+	return histogramBounds[BucketCount - 2];
+}
+
+void MetricsText::family(const char* name, const char* type, const char* help)
+{
+	m_text += "# HELP ";
+	m_text += name;
+	m_text += ' ';
+	m_text += help;
+	m_text += "\n# TYPE ";
+	m_text += name;
+	m_text += ' ';
+	m_text += type;
+	m_text += '\n';
+}
+
+void MetricsText::sample(const char* name, const char* suffix, const char* labels, const char* extraLabel, const char* number)
+{
+	const bool hasLabels = labels != nullptr && labels[0] != '\0';
+	m_text += name;
+	m_text += suffix;
+	if (hasLabels || extraLabel != nullptr) {
+		m_text += '{';
+		if (hasLabels) m_text += labels;
+		if (hasLabels && extraLabel != nullptr) m_text += ',';
+		if (extraLabel != nullptr) m_text += extraLabel;
+		m_text += '}';
+	}
+	m_text += ' ';
+	m_text += number;
+	m_text += '\n';
+}
+
+void MetricsText::value(const char* name, const char* labels, double value)
+{
+	char number[32];
+	FormatNumber(number, value);
+	sample(name, "", labels, nullptr, number);
+}
+
+void MetricsText::value(const char* name, const char* labels, std::uint64_t value)
+{
+	char number[32];
+	std::snprintf(number, sizeof(number), "%llu", static_cast<unsigned long long>(value));
+	sample(name, "", labels, nullptr, number);
+}
+
+void MetricsText::histogram(const char* name, const char* labels, const MetricHistogram::Snapshot& snapshot)
+{
+	// バケットは累積で書く
+	char number[32];
+	char le[48];
+	std::uint64_t cumulative = 0;
+	for (int i = 0; i < MetricHistogram::BucketCount; ++i) {
+		cumulative += snapshot.buckets[i];
+		char bound[32];
+		FormatNumber(bound, MetricHistogram::bucketUpperSeconds(i));
+		std::snprintf(le, sizeof(le), "le=\"%s\"", bound);
+		std::snprintf(number, sizeof(number), "%llu", static_cast<unsigned long long>(cumulative));
+		sample(name, "_bucket", labels, le, number);
+	}
+	FormatNumber(number, snapshot.sumSeconds);
+	sample(name, "_sum", labels, nullptr, number);
+	std::snprintf(number, sizeof(number), "%llu", static_cast<unsigned long long>(snapshot.count));
+	sample(name, "_count", labels, nullptr, number);
+}
+
+MetricsExporter::MetricsExporter(Collector collector) :
+	m_collector(std::move(collector))
+{
+}
+
+MetricsExporter::~MetricsExporter()
+{
+	stop();
+}
+
+std::string MetricsExporter::render() const
+{
+	MetricsText text;
+	m_collector(text);
+	return text.str();
+}
+
+bool MetricsExporter::serveHttp(std::uint16_t port)
+{
+	if (m_httpThread.joinable()) return false;
+
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+		OutputDebugStringW(L"failed: WSAStartup\n");
+		return false;
+	}
+
+	// 外からは見えないように localhost だけで待ち受ける
+	const SOCKET listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (listenSocket == INVALID_SOCKET
+		|| bind(listenSocket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR
+		|| listen(listenSocket, SOMAXCONN) == SOCKET_ERROR) {
+		OutputDebugStringW(L"failed: MetricsExporter (cannot listen)\n");
+		if (listenSocket != INVALID_SOCKET) closesocket(listenSocket);
+		WSACleanup();
+		return false;
+	}
+
+	m_httpQuit.store(false, std::memory_order_relaxed);
+	m_httpThread = std::thread([this, listenSocket] { httpMain(listenSocket); });
+	return true;
+}
+
+void MetricsExporter::httpMain(std::uintptr_t listenSocketValue)
+{
+	const auto listenSocket = static_cast<SOCKET>(listenSocketValue);
+	std::string request;
+	while (!m_httpQuit.load(std::memory_order_relaxed)) {
+		// 止めるときに気付けるように、待つのは少しずつ
+		fd_set readable;
+		FD_ZERO(&readable);
+		FD_SET(listenSocket, &readable);
+		timeval timeout = { 0, httpPollMs * 1000 };
+		if (select(0, &readable, nullptr, nullptr, &timeout) <= 0) continue;
+
+		const SOCKET client = accept(listenSocket, nullptr, nullptr);
+		if (client == INVALID_SOCKET) continue;
+
+		const DWORD receiveTimeout = httpReceiveTimeoutMs;
+		setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&receiveTimeout), sizeof(receiveTimeout));
+
+		// リクエストはヘッダーの終わりまで読む (本文は見ない)
+		request.clear();
+		char buf[1024];
+		while (request.find("\r\n\r\n") == std::string::npos && request.size() < httpRequestLimit) {
+			const int received = recv(client, buf, sizeof(buf), 0);
+			if (received <= 0) break;
+			request.append(buf, received);
+		}
+
+		const bool found = request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 6, "GET / ") == 0;
+		const std::string body = found ? render() : std::string("not found\n");
+		char header[192];
+		std::snprintf(header, sizeof(header),
+			"HTTP/1.0 %s\r\nContent-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+			found ? "200 OK" : "404 Not Found", body.size());
+		if (SendAll(client, header, std::strlen(header))) {
+			SendAll(client, body.data(), body.size());
+		}
+		shutdown(client, SD_SEND);
+		closesocket(client);
+	}
+
+	closesocket(listenSocket);
+	WSACleanup();
+}
+
+bool MetricsExporter::writeFile(const std::wstring& path, std::chrono::milliseconds interval)
+{
+	if (m_fileThread.joinable()) return false;
+
+	m_path = path;
+	m_interval = interval;
+	if (!writeFileNow()) return false;
+	m_fileThread = std::thread([this] { fileMain(); });
+	return true;
+}
+
+bool MetricsExporter::writeFileNow()
+{
+	if (m_path.empty()) return false;
+
+	const std::string body = render();
+	const std::wstring tempPath = m_path + L".tmp";
+	const HANDLE file = CreateFileW(tempPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		OutputDebugStringW(L"failed: MetricsExporter (cannot write file)\n");
+		return false;
+	}
+	DWORD written = 0;
+	const BOOL ok = WriteFile(file, body.data(), static_cast<DWORD>(body.size()), &written, nullptr);
+	CloseHandle(file);
+	if (!ok || written != body.size() || !MoveFileExW(tempPath.c_str(), m_path.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+		OutputDebugStringW(L"failed: MetricsExporter (cannot write file)\n");
+		DeleteFileW(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+void MetricsExporter::fileMain()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (!m_quitSignal.wait_for(lock, m_interval, [this] { return m_quit; })) {
+		lock.unlock();
+		writeFileNow();
+		lock.lock();
+	}
+}
+
+void MetricsExporter::stop()
+{
+	m_httpQuit.store(true, std::memory_order_relaxed);
+	if (m_httpThread.joinable()) {
+		m_httpThread.join();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_quitSignal.notify_all();
+	if (m_fileThread.joinable()) {
+		m_fileThread.join();
+	}
+}
+
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace dxstg {
+
+// 増えるだけの値 (Prometheus の counter)
+// どのスレッドから触ってもよい。
+class MetricCounter final {
+public:
+	void add(std::uint64_t n = 1) noexcept { m_value.fetch_add(n, std::memory_order_relaxed); }
+	void set(std::uint64_t value) noexcept { m_value.store(value, std::memory_order_relaxed); } // 別のところで数えた合計を写すとき
+	std::uint64_t value() const noexcept { return m_value.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<std::uint64_t> m_value{ 0 };
+};
+
+// 上下する値 (Prometheus の gauge)
+class MetricGauge final {
+public:
+	void set(double value) noexcept { m_value.store(value, std::memory_order_relaxed); }
+	double value() const noexcept { return m_value.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<double> m_value{ 0.0 };
+};
+
+// 時間の分布 (Prometheus の histogram)
+// バケットの境界は決まっていて (0.25 ms ～ 250 ms と +Inf)、observe は数を1つ足すだけ。
+class MetricHistogram final {
+public:
+	static constexpr int BucketCount = 12; // 最後のバケットは +Inf
+	static double bucketUpperSeconds(int i) noexcept;
+
+	struct Snapshot {
+		std::uint64_t buckets[BucketCount]; // それぞれのバケットの数 (累積ではない)
+		std::uint64_t count;
+		double sumSeconds;
+
+		// q (0～1) 番目の値の推定 (バケットの中は一様とみなす。+Inf に入ったときは最後の境界)
+		double quantile(double q) const noexcept;
+	};
+
+	MetricHistogram() noexcept;
+	void observe(double seconds) noexcept;
+	Snapshot snapshot() const noexcept;
+
+private:
+	std::atomic<std::uint64_t> m_buckets[BucketCount];
+	std::atomic<std::uint64_t> m_sumNs{ 0 };
+};
+
+// Prometheus のテキスト形式 (version 0.0.4) を組み立てる
+// labels は `phase="sim",thread="0"` のように書いたもの (nullptr か空ならラベルなし)。
+class MetricsText final {
+public:
+	// 同じ名前の値を書く前に1回呼ぶ (type は "counter", "gauge", "histogram")
+	void family(const char* name, const char* type, const char* help);
+
+	void value(const char* name, const char* labels, double value);
+	void value(const char* name, const char* labels, std::uint64_t value);
+	void histogram(const char* name, const char* labels, const MetricHistogram::Snapshot& snapshot);
+
+	const std::string& str() const noexcept { return m_text; }
+
+private:
+	void sample(const char* name, const char* suffix, const char* labels, const char* extraLabel, const char* number);
+
+	std::string m_text;
+};
+
+// このプロセスの operator new / delete の呼ばれた回数
+// DXSTG_COUNT_ALLOCATIONS を定義してビルドしたときだけ、Metrics.cpp で operator new / delete を置き換えて数える。
+// 数えると、すべてのスレッドのすべての確保が1つのアトミック変数を書くので、普段は無効にしておく。
+#if defined(DXSTG_COUNT_ALLOCATIONS)
+constexpr bool AllocationCountEnabled = true;
+#else
+constexpr bool AllocationCountEnabled = false;
+#endif
+std::uint64_t AllocationCount() noexcept;   // 数えていないときは 0
+std::uint64_t DeallocationCount() noexcept;
+
+// メトリクスを外に出すもの
+// localhost の HTTP (GET /metrics) で答えるか、決まった間隔でファイルに書き出す (両方でもよい)。
+// 本文は出すたびに collector を呼んで作る。collector はエクスポーターのスレッドで呼ばれるので、
+// MetricCounter などのアトミックな値だけを読むこと。
+class MetricsExporter final {
+public:
+	using Collector = std::function<void(MetricsText& text)>;
+
+	explicit MetricsExporter(Collector collector);
+	~MetricsExporter();
+	MetricsExporter(const MetricsExporter&) = delete;              // コピー不可
+	MetricsExporter& operator = (const MetricsExporter&) = delete; // コピー不可
+
+	// 127.0.0.1:port で待ち受ける。開けなかったら false
+	bool serveHttp(std::uint16_t port);
+
+	// interval ごとに path に書き出す (一時ファイルに書いてから置き換えるので、読む側が途中のものを見ることはない)
+	bool writeFile(const std::wstring& path, std::chrono::milliseconds interval);
+
+	// 今すぐ path に書き出す (終わる前の最後の値など)
+	bool writeFileNow();
+
+	// スレッドを止める (デストラクタからも呼ばれる)
+	void stop();
+
+	std::string render() const;
+
+private:
+	Collector m_collector;
+	std::wstring m_path;
+	std::chrono::milliseconds m_interval{ 0 };
+	std::thread m_httpThread;
+	std::thread m_fileThread;
+	std::mutex m_mutex;
+	std::condition_variable m_quitSignal;
+	bool m_quit = false;
+	std::atomic<bool> m_httpQuit{ false };
+
+	void httpMain(std::uintptr_t listenSocket);
+	void fileMain();
+};
+
+}
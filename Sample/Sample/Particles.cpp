@@ -0,0 +1,118 @@
+#include "Particles.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1) || defined(__SSE__)
+#define DXSTG_PARTICLE_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace dxstg {
+
+ParticleSystem::ParticleSystem(size_t capacity, float drag, std::uint32_t seed)
+	: m_capacity(capacity)
+	, m_drag(drag)
+	, m_random(seed != 0 ? seed : 1)
+{
+	const size_t padded = (capacity + 3) & ~size_t(3);
+	m_x.resize(padded);
+	m_y.resize(padded);
+	m_vx.resize(padded);
+	m_vy.resize(padded);
+	m_alpha.resize(padded);
+	m_fade.resize(padded);
+	m_halfSize.resize(padded);
+	m_rgb.resize(padded);
+}
+
+float ParticleSystem::random() noexcept
+{
+	// xorshift32
+	m_random ^= m_random << 13;
+	m_random ^= m_random >> 17;
+	m_random ^= m_random << 5;
+	return (m_random >> 8) * (1.f / 16777216.f);
+}
+
+size_t ParticleSystem::emit(const ParticleBurst& burst)
+{
+	const size_t count = std::min<size_t>(burst.count, m_capacity - m_count);
+	m_dropped += burst.count - count;
+
+	const float fade = 1.f / std::max<std::uint32_t>(burst.lifetime, 1);
+	for (size_t n = 0; n < count; ++n) {
+		const size_t i = m_count++;
+		const float angle = random() * 6.2831853f;
+		const float speed = burst.speed * (0.25f + 0.75f * random());
+		m_x[i] = burst.position.x;
+		m_y[i] = burst.position.y;
+		m_vx[i] = std::cos(angle) * speed;
+		m_vy[i] = std::sin(angle) * speed;
+		m_alpha[i] = 1.f;
+		m_fade[i] = fade;
+		m_halfSize[i] = burst.halfSize;
+		m_rgb[i] = burst.rgb;
+	}
+	return count;
+}
+
+void ParticleSystem::update() noexcept
+{
+	// 動かす (端数も4つずつ。確保した範囲は超えない)
+	const size_t padded = (m_count + 3) & ~size_t(3);
+	size_t i = 0;
+#if defined(DXSTG_PARTICLE_SSE)
+	const __m128 drag = _mm_set1_ps(m_drag);
+	for (; i < padded; i += 4) {
+		__m128 vx = _mm_loadu_ps(&m_vx[i]);
+		__m128 vy = _mm_loadu_ps(&m_vy[i]);
+		_mm_storeu_ps(&m_x[i], _mm_add_ps(_mm_loadu_ps(&m_x[i]), vx));
+		_mm_storeu_ps(&m_y[i], _mm_add_ps(_mm_loadu_ps(&m_y[i]), vy));
+		_mm_storeu_ps(&m_vx[i], _mm_mul_ps(vx, drag));
+		_mm_storeu_ps(&m_vy[i], _mm_mul_ps(vy, drag));
+		_mm_storeu_ps(&m_alpha[i], _mm_sub_ps(_mm_loadu_ps(&m_alpha[i]), _mm_loadu_ps(&m_fade[i])));
+	}
+#endif
+	for (; i < padded; ++i) {
+		m_x[i] += m_vx[i];
+		m_y[i] += m_vy[i];
+		m_vx[i] *= m_drag;
+		m_vy[i] *= m_drag;
+		m_alpha[i] -= m_fade[i];
+	}
+
+	// 消えたものを詰める
+	i = 0;
+	while (i < m_count) {
+#if defined(DXSTG_PARTICLE_SSE)
+		// 4つとも残るなら飛ばす
+		if (i + 4 <= m_count && _mm_movemask_ps(_mm_cmple_ps(_mm_loadu_ps(&m_alpha[i]), _mm_setzero_ps())) == 0) {
+			i += 4;
+			continue;
+		}
+#endif
+		if (m_alpha[i] > 0.f) {
+			++i;
+			continue;
+		}
+		--m_count;
+		if (i != m_count) {
+			moveParticle(m_count, i);
+		}
+	}
+}
+
+void ParticleSystem::moveParticle(size_t from, size_t to) noexcept
+{
+	m_x[to] = m_x[from];
+	m_y[to] = m_y[from];
+	m_vx[to] = m_vx[from];
+	m_vy[to] = m_vy[from];
+	m_alpha[to] = m_alpha[from];
+	m_fade[to] = m_fade[from];
+	m_halfSize[to] = m_halfSize[from];
+	m_rgb[to] = m_rgb[from];
+}
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Components.h"
+
+namespace dxstg {
+
+// パーティクルをまとめて出すときの設定
+struct ParticleBurst {
+	Position position = { 0.f, 0.f };
+	std::uint32_t count = 16;
+	float speed = 0.05f;          // 1ティックあたりの初速の最大 (向きはばらばら)
+	std::uint32_t lifetime = 30;  // 消えるまでのティック数
+	float halfSize = 0.1f;
+	std::uint32_t rgb = 0xffffff; // 色 (R が下位のバイト)。α は寿命に合わせて 1 から 0 に下がる
+};
+
+// 固定長のパーティクルの入れ物 (エフェクト用)
+// 位置・速度・α などを配列で持ち (SoA)、SSE が使えるときは4つずつまとめて動かす。
+// 確保は最初の1回だけ。いっぱいのときに出そうとした分は捨てて数えておく。
+class ParticleSystem final {
+public:
+	// drag: 1ティックごとに速度に掛ける値
+	explicit ParticleSystem(size_t capacity, float drag = 0.92f, std::uint32_t seed = 1);
+
+	// 出す。出せた数を返す
+	size_t emit(const ParticleBurst& burst);
+
+	// 1ティック進める (動かして、α を下げて、消えたもの (α <= 0) を詰める)
+	// 詰めるときは最後のものを移すので、並び順は変わる
+	void update() noexcept;
+
+	void clear() noexcept { m_count = 0; }
+
+	size_t size() const noexcept { return m_count; }
+	size_t capacity() const noexcept { return m_capacity; }
+	std::uint64_t droppedCount() const noexcept { return m_dropped; }
+
+	// 並んでいる順の配列 (size() 個)
+	const float* x() const noexcept { return m_x.data(); }
+	const float* y() const noexcept { return m_y.data(); }
+	const float* alpha() const noexcept { return m_alpha.data(); }
+	const float* halfSize() const noexcept { return m_halfSize.data(); }
+	const std::uint32_t* rgb() const noexcept { return m_rgb.data(); }
+
+	// 1つあたりの大きさ
+	static constexpr size_t bytesPerParticle() noexcept { return sizeof(float) * 7 + sizeof(std::uint32_t); }
+
+private:
+	void moveParticle(size_t from, size_t to) noexcept;
+	float random() noexcept; // [0, 1)
+
+	size_t m_capacity;
+	size_t m_count = 0;
+	float m_drag;
+	std::uint32_t m_random;
+	std::uint64_t m_dropped = 0;
+
+	// 4の倍数の大きさで確保して、SIMD のループは端数まで4つずつ回す (size() より後ろの値は使わない)
+	std::vector<float> m_x, m_y;
+	std::vector<float> m_vx, m_vy;
+	std::vector<float> m_alpha; // 1 から下がって、0 以下で消える
+	std::vector<float> m_fade;  // 1ティックごとに α から引く値 (1 / 寿命)
+	std::vector<float> m_halfSize;
+	std::vector<std::uint32_t> m_rgb;
+};
+
+}
@@ -0,0 +1,79 @@
+#include "PixelConvert.h"
+
+#include <algorithm>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define DXSTG_PIXEL_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace dxstg {
+
+namespace {
+
+// スカラー版。SSE2版の端数処理にも使う。
+inline void PremultiplyAlphaScalar(const std::uint8_t* src, std::uint8_t* dst, std::size_t pixelCount) noexcept
+{
+	for (std::size_t i = 0; i < pixelCount; ++i, src += 4, dst += 4) {
+		const std::uint32_t a = src[3];
+		dst[0] = PremultiplyChannel(src[0], a);
+		dst[1] = PremultiplyChannel(src[1], a);
+		dst[2] = PremultiplyChannel(src[2], a);
+		dst[3] = static_cast<std::uint8_t>(a);
+	}
+}
+
+} // end unnamed namespace
+
+void PremultiplyAlpha(const std::uint8_t* src, std::uint8_t* dst, std::size_t pixelCount) noexcept
+{
+	std::size_t i = 0;
+
+#if defined(DXSTG_PIXEL_SSE2)
+	// 4画素ずつ、2画素ずつ 16bit に広げて計算する。
+	// α のレーンには 255 を掛けるので α はそのまま残る。
+	// c * a + 128 は 65153 以下なので 16bit に収まる。
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alphaMask = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+	const __m128i alpha255 = _mm_and_si128(_mm_set1_epi16(255), alphaMask);
+	const __m128i bias = _mm_set1_epi16(128);
+	auto premultiply = [&](__m128i c) {
+		// (a, a, a, 255) を作る
+		__m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+		a = _mm_or_si128(_mm_andnot_si128(alphaMask, a), alpha255);
+		const __m128i t = _mm_add_epi16(_mm_mullo_epi16(c, a), bias);
+		return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+	};
+	for (; i + 4 <= pixelCount; i += 4) {
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+		const __m128i lo = premultiply(_mm_unpacklo_epi8(v, zero));
+		const __m128i hi = premultiply(_mm_unpackhi_epi8(v, zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm_packus_epi16(lo, hi));
+	}
+#endif
+
+	// 端数
+	PremultiplyAlphaScalar(src + i * 4, dst + i * 4, pixelCount - i);
+}
+
+void DownsampleRgba(const std::uint8_t* src, std::uint32_t width, std::uint32_t height, std::size_t srcPitch,
+	std::uint8_t* dst, std::size_t dstPitch) noexcept
+{
+	const std::uint32_t w2 = width > 1 ? width / 2 : 1;
+	const std::uint32_t h2 = height > 1 ? height / 2 : 1;
+	for (std::uint32_t y = 0; y < h2; ++y) {
+		const std::uint8_t* row0 = src + srcPitch * std::min(y * 2, height - 1);
+		const std::uint8_t* row1 = src + srcPitch * std::min(y * 2 + 1, height - 1);
+		std::uint8_t* out = dst + dstPitch * y;
+		for (std::uint32_t x = 0; x < w2; ++x) {
+			const std::size_t x0 = std::min(x * 2, width - 1) * 4;
+			const std::size_t x1 = std::min(x * 2 + 1, width - 1) * 4;
+			for (int c = 0; c < 4; ++c) {
+				const std::uint32_t sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+				out[x * 4 + c] = static_cast<std::uint8_t>((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+}
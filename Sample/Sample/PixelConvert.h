@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace dxstg {
+
+// 普通のアルファの RGBA8 (R が先頭のバイト) を乗算済みアルファにする。
+// 各色は round(c * a / 255) になり、Tools/texconv.py の変換とビット単位で一致する。
+// α値は変わらない。SSE2 が使えるときはそれを使い、端数はスカラーで処理する。
+//
+// 乗算済みにしておくと、透明な画素の色がバイリニア補間やミップマップの縮小で
+// 隣の画素ににじまない (α = 0 の画素は色も 0 になるため)。
+
+// src から dst に変換する (src == dst でもよい)
+void PremultiplyAlpha(const std::uint8_t* src, std::uint8_t* dst, std::size_t pixelCount) noexcept;
+
+// その場で変換する
+inline void PremultiplyAlpha(std::uint8_t* rgba, std::size_t pixelCount) noexcept
+{
+	PremultiplyAlpha(rgba, rgba, pixelCount);
+}
+
+// RGBA8 を 2x2 の平均 ((4つの和 + 2) / 4) で半分の大きさ (1 未満は 1) にする。奇数のときは端の画素を使い回す。
+// Tools/texconv.py の downsample とビット単位で一致する。
+// 普通のアルファのまま縮小すると透明な画素の色がにじむので、乗算済みアルファの画素に使うこと。
+// srcPitch, dstPitch : 1行のバイト数
+void DownsampleRgba(const std::uint8_t* src, std::uint32_t width, std::uint32_t height, std::size_t srcPitch,
+	std::uint8_t* dst, std::size_t dstPitch) noexcept;
+
+// 1色分 (round(c * a / 255))
+constexpr std::uint8_t PremultiplyChannel(std::uint32_t c, std::uint32_t a) noexcept
+{
+	return static_cast<std::uint8_t>(((c * a + 128) + ((c * a + 128) >> 8)) >> 8);
+}
+
+}
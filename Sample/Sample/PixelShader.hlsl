@@ -3,12 +3,8 @@
 Texture2D _texture : register(t0);
 SamplerState _sampler : register(s0);
 
-cbuffer CBuffer : register(b0)
-{
-    float4 color;
-}
-
+// テクスチャも頂点の色も乗算済みアルファ
 float4 main(PSIn input) : SV_TARGET
 {
-    return _texture.Sample(_sampler, input.uv) * color;
+    return _texture.Sample(_sampler, input.uv) * input.color;
 }
\ No newline at end of file
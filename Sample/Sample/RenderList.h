@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "StgObject.h"
+
+namespace dxstg {
+
+// シミュレーションスレッドから描画スレッドに渡す、1ティック分の描画内容
+// ゲームオブジェクトへのポインタは含まないので、公開した後にオブジェクトが消えても描画できる。
+struct RenderSprite {
+	// 頂点は (x0, y0), (x1, y0), (x0, y1), (x1, y1) の順。それぞれ (u0, v0), (u1, v0), (u0, v1), (u1, v1) が対応する
+	float x0, y0, x1, y1;
+	float u0, v0, u1, v1;
+	Color color;
+	StgObject::TextureID texture;
+	StgObject::Layer layer;
+};
+
+struct RenderList {
+	std::uint64_t tick = 0;            // シミュレーションのティック番号
+	std::vector<RenderSprite> sprites; // カメラに映るものだけ
+	std::wstring hudText;              // 描画スレッドの HUD の後ろに表示する文字列
+
+	// 統計
+	size_t objectCount = 0;
+	size_t culledCount = 0;       // 画面外で描画しないオブジェクトの数
+	size_t totalRetiredCount = 0; // 画面外に出て消した弾などの数 (累計)
+	double tickMs = 0;            // 1ティックの処理時間
+
+	// 作り直す前に呼ぶ (確保した領域は残す)
+	void clear()
+	{
+		sprites.clear();
+		hudText.clear();
+	}
+};
+
+}
@@ -0,0 +1,73 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace dxstg {
+
+void RenderQueue::clear()
+{
+	m_sprites.clear();
+	m_keys.clear();
+	m_textureIndices.clear();
+}
+
+void RenderQueue::push(const Sprite& sprite)
+{
+	// テクスチャ番号は出てきた順に振る。足りなくなったら最後の番号を使い回す (並びが少し悪くなるだけ)
+	const auto maxIndex = std::numeric_limits<std::uint16_t>::max();
+	const auto inserted = m_textureIndices.emplace(sprite.texture,
+		static_cast<std::uint16_t>(std::min<size_t>(m_textureIndices.size(), maxIndex)));
+	const std::uint64_t texture = inserted.first->second;
+
+	const std::uint64_t sequence = m_sprites.size();
+	m_keys.push_back(
+		(static_cast<std::uint64_t>(sprite.layer) << 56) |
+		(static_cast<std::uint64_t>(sprite.material) << 48) |
+		(texture << 32) |
+		sequence);
+	m_sprites.push_back(sprite);
+}
+
+void RenderQueue::sort()
+{
+	m_sortBuffer.resize(m_keys.size());
+	// 下位32ビットの追加順は最初から昇順なので、上位4バイトだけ並べればよい
+	RadixSortKeys(m_keys.data(), m_sortBuffer.data(), m_keys.size(), 4);
+}
+
+void RadixSortKeys(std::uint64_t* keys, std::uint64_t* temp, size_t count, unsigned firstByte)
+{
+	if (count < 2) return;
+
+	std::uint64_t* src = keys;
+	std::uint64_t* dst = temp;
+	for (unsigned byte = firstByte; byte < 8; ++byte) {
+		const unsigned shift = byte * 8;
+
+		size_t histogram[256] = {};
+		for (size_t i = 0; i < count; ++i) {
+			++histogram[(src[i] >> shift) & 0xff];
+		}
+
+		// 全部同じ値なら並べ替え不要
+		if (histogram[(src[0] >> shift) & 0xff] == count) continue;
+
+		size_t offset = 0;
+		for (auto& h : histogram) {
+			const size_t n = h;
+			h = offset;
+			offset += n;
+		}
+		for (size_t i = 0; i < count; ++i) {
+			dst[histogram[(src[i] >> shift) & 0xff]++] = src[i];
+		}
+		std::swap(src, dst);
+	}
+
+	if (src != keys) {
+		std::copy(src, src + count, keys);
+	}
+}
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <d3d11.h>
+
+#include "SpriteEncoding.h"
+
+namespace dxstg {
+
+// 1フレーム分の描画要求を集めて、状態の切り替えが少ない順に並べる
+// 各スプライトに 64ビットのキーを付けて基数ソートする。
+//   [63..56] 層 (小さいほうが奥)
+//   [55..48] マテリアル (シェーダー・ブレンドなどの組み合わせ。番号の意味は使う側が決める)
+//   [47..32] テクスチャ (このフレームで最初に出てきた順の番号)
+//   [31.. 0] 追加した順番
+// 同じ層の中ではマテリアル・テクスチャごとにまとまり、それも同じなら追加した順に描画される。
+class RenderQueue final {
+public:
+	// 四角形1枚 (位置・UV・色は SpriteQuad を参照)
+	struct Sprite : SpriteQuad {
+		ID3D11ShaderResourceView* texture; // 参照は持たない。描画し終わるまで解放しないこと
+		std::uint8_t layer;
+		std::uint8_t material;
+	};
+
+	void clear();
+	void push(const Sprite& sprite);
+
+	// キーを基数ソートする。push し終わってから、描画の前に1回呼ぶ
+	void sort();
+
+	size_t size() const noexcept { return m_sprites.size(); }
+	bool empty() const noexcept { return m_sprites.empty(); }
+
+	// sort() 後に i 番目に描画するもの
+	const Sprite& sorted(size_t i) const noexcept
+	{
+		return m_sprites[static_cast<std::uint32_t>(m_keys[i])];
+	}
+
+	// このフレームに出てきたテクスチャの数
+	size_t textureCount() const noexcept { return m_textureIndices.size(); }
+
+private:
+	std::vector<Sprite> m_sprites;
+	std::vector<std::uint64_t> m_keys;
+	std::vector<std::uint64_t> m_sortBuffer;
+	std::unordered_map<ID3D11ShaderResourceView*, std::uint16_t> m_textureIndices;
+};
+
+// 64ビットのキーの安定な LSD 基数ソート (8ビットずつ)
+// firstByte より下のバイトはすでに並んでいるものとして飛ばす。
+// 全部のキーで同じ値のバイトも飛ばす。temp は keys と同じ数の作業領域。
+void RadixSortKeys(std::uint64_t* keys, std::uint64_t* temp, size_t count, unsigned firstByte = 0);
+
+}
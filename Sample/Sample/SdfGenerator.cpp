@@ -0,0 +1,199 @@
+#include "SdfGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace dxstg {
+
+namespace {
+
+constexpr int QuadDivision = 8; // 2次ベジェ曲線の分割数
+
+// GGO_NATIVE のデータの並び (wingdi.h の TTPOLYGONHEADER, TTPOLYCURVE, POINTFX と同じ。リトルエンディアン)
+// 参考: https://docs.microsoft.com/ja-jp/windows/desktop/api/wingdi/ns-wingdi-tagttpolygonheader
+constexpr std::size_t PolygonHeaderSize = 16; // cb, dwType, pfxStart
+constexpr std::size_t PolyCurveHeaderSize = 4; // wType, cpfx (この後に apfx が続く)
+constexpr std::size_t PointFxSize = 8;
+constexpr std::uint16_t PrimLine = 1;    // TT_PRIM_LINE
+constexpr std::uint16_t PrimQSpline = 2; // TT_PRIM_QSPLINE
+
+template <class T>
+T ReadValue(const std::uint8_t* p) noexcept
+{
+	T value;
+	std::memcpy(&value, p, sizeof(T)); // 境界に揃っているとは限らない
+	return value;
+}
+
+// FIXED (16.16 の固定小数点) を float にする
+float ReadFixed(const std::uint8_t* p) noexcept
+{
+	return ReadValue<std::int16_t>(p + 2) + ReadValue<std::uint16_t>(p) / 65536.f;
+}
+
+struct Segment {
+	float ax, ay, bx, by;
+};
+
+// 点 (x, y) と線分の距離の2乗
+float DistanceSquared(const Segment& s, float x, float y) noexcept
+{
+	const float dx = s.bx - s.ax;
+	const float dy = s.by - s.ay;
+	const float len2 = dx * dx + dy * dy;
+	float t = 0.f;
+	if (len2 > 0.f) {
+		t = ((x - s.ax) * dx + (y - s.ay) * dy) / len2;
+		t = std::min(std::max(t, 0.f), 1.f);
+	}
+	const float px = s.ax + dx * t - x;
+	const float py = s.ay + dy * t - y;
+	return px * px + py * py;
+}
+
+// 点 (x, y) から右に伸ばした半直線との交差による winding number の増減
+int Winding(const Segment& s, float x, float y) noexcept
+{
+	const float cross = (s.bx - s.ax) * (y - s.ay) - (x - s.ax) * (s.by - s.ay);
+	if (s.ay <= y) {
+		if (s.by > y && cross > 0.f) return 1;   // 上向きに交差
+	} else {
+		if (s.by <= y && cross < 0.f) return -1; // 下向きに交差
+	}
+	return 0;
+}
+
+} // end unnamed namespace
+
+void GlyphOutline::moveTo(float x, float y)
+{
+	close();
+	m_contours.emplace_back();
+	m_contours.back().push_back({ x, y });
+}
+
+void GlyphOutline::lineTo(float x, float y)
+{
+	if (m_contours.empty()) {
+		moveTo(x, y);
+		return;
+	}
+	m_contours.back().push_back({ x, y });
+}
+
+void GlyphOutline::quadTo(float cx, float cy, float x, float y)
+{
+	if (m_contours.empty()) {
+		moveTo(x, y);
+		return;
+	}
+	const Point p0 = m_contours.back().back();
+	for (int i = 1; i <= QuadDivision; ++i) {
+		const float t = static_cast<float>(i) / QuadDivision;
+		const float u = 1.f - t;
+		m_contours.back().push_back({
+			u * u * p0.x + 2 * u * t * cx + t * t * x,
+			u * u * p0.y + 2 * u * t * cy + t * t * y });
+	}
+}
+
+void GlyphOutline::close()
+{
+	if (m_contours.empty()) return;
+
+	Contour& contour = m_contours.back();
+	if (contour.size() < 2) {
+		m_contours.pop_back(); // 点だけの輪郭は捨てる
+		return;
+	}
+	const Point& first = contour.front();
+	const Point& last = contour.back();
+	if (first.x != last.x || first.y != last.y) {
+		contour.push_back(first);
+	}
+}
+
+void DecodeNativeOutline(const std::uint8_t* data, std::size_t size, GlyphOutline& outline)
+{
+	std::size_t offset = 0;
+	while (size - offset >= PolygonHeaderSize) {
+		const std::uint8_t* const p = data + offset;
+		const std::uint32_t cb = ReadValue<std::uint32_t>(p);
+		if (cb < PolygonHeaderSize || cb > size - offset) break; // 壊れている
+
+		const std::uint8_t* const contourEnd = p + cb;
+		outline.moveTo(ReadFixed(p + 8), ReadFixed(p + 12));
+
+		const std::uint8_t* q = p + PolygonHeaderSize;
+		while (static_cast<std::size_t>(contourEnd - q) >= PolyCurveHeaderSize) {
+			const std::uint16_t type = ReadValue<std::uint16_t>(q);
+			const std::uint16_t count = ReadValue<std::uint16_t>(q + 2);
+			const std::size_t curveSize = PolyCurveHeaderSize + PointFxSize * count;
+			if (curveSize > static_cast<std::size_t>(contourEnd - q)) break; // 点が輪郭の外まではみ出している
+
+			const std::uint8_t* const pts = q + PolyCurveHeaderSize;
+			if (type == PrimLine) {
+				for (std::uint16_t i = 0; i < count; ++i) {
+					outline.lineTo(ReadFixed(pts + PointFxSize * i), ReadFixed(pts + PointFxSize * i + 4));
+				}
+			} else if (type == PrimQSpline) {
+				// 最後の点以外は制御点で、制御点の間には暗黙の中間点 (曲線上の点) がある
+				for (std::uint16_t i = 0; i + 1 < count; ++i) {
+					const float cx = ReadFixed(pts + PointFxSize * i);
+					const float cy = ReadFixed(pts + PointFxSize * i + 4);
+					float ex = ReadFixed(pts + PointFxSize * (i + 1));
+					float ey = ReadFixed(pts + PointFxSize * (i + 1) + 4);
+					if (i + 2 < count) {
+						ex = (cx + ex) * 0.5f;
+						ey = (cy + ey) * 0.5f;
+					}
+					outline.quadTo(cx, cy, ex, ey);
+				}
+			}
+			q += curveSize;
+		}
+		outline.close();
+		offset += cb;
+	}
+}
+
+void GenerateSdf(const GlyphOutline& outline, float originX, float originY,
+	std::size_t width, std::size_t height, float spread, std::uint8_t* dst)
+{
+	std::vector<Segment> segments;
+	for (const auto& contour : outline.getContours()) {
+		for (std::size_t i = 0; i + 1 < contour.size(); ++i) {
+			segments.push_back({ contour[i].x, contour[i].y, contour[i + 1].x, contour[i + 1].y });
+		}
+		// 閉じていない輪郭 (close() 前) も閉じたものとして扱う
+		const auto& first = contour.front();
+		const auto& last = contour.back();
+		if (first.x != last.x || first.y != last.y) {
+			segments.push_back({ last.x, last.y, first.x, first.y });
+		}
+	}
+
+	const float scale = 0.5f / spread;
+	for (std::size_t j = 0; j < height; ++j) {
+		const float y = originY - (static_cast<float>(j) + 0.5f);
+		for (std::size_t i = 0; i < width; ++i) {
+			const float x = originX + (static_cast<float>(i) + 0.5f);
+
+			float minDist2 = spread * spread;
+			int winding = 0;
+			for (const auto& s : segments) {
+				minDist2 = std::min(minDist2, DistanceSquared(s, x, y));
+				winding += Winding(s, x, y);
+			}
+
+			float dist = std::sqrt(minDist2);
+			if (winding == 0) dist = -dist; // 外側は負
+
+			const float v = std::min(std::max(0.5f + dist * scale, 0.f), 1.f);
+			dst[width * j + i] = static_cast<std::uint8_t>(v * 255.f + 0.5f);
+		}
+	}
+}
+
+}
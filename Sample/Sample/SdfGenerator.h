@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dxstg {
+
+// グリフのアウトライン (閉じた折れ線の集まり)
+// 座標はピクセル単位で、y は上向き (GetGlyphOutlineW の GGO_NATIVE と同じ)。
+// 2次ベジェ曲線は追加時に折れ線に分割する。
+class GlyphOutline final {
+public:
+	struct Point {
+		float x, y;
+	};
+	using Contour = std::vector<Point>;
+
+	void moveTo(float x, float y);
+	void lineTo(float x, float y);
+	void quadTo(float cx, float cy, float x, float y); // 2次ベジェ曲線 (TrueType の qspline)
+	void close();
+
+	bool empty() const noexcept { return m_contours.empty(); }
+	const std::vector<Contour>& getContours() const noexcept { return m_contours; }
+
+private:
+	std::vector<Contour> m_contours;
+};
+
+// GetGlyphOutlineW の GGO_NATIVE で得たデータ (TTPOLYGONHEADER と TTPOLYCURVE の並び) を outline に追加する
+// 直線 (TT_PRIM_LINE) と 2次ベジェ曲線 (TT_PRIM_QSPLINE) を読む。
+// 途中で壊れている (大きさが合わない) ときは、そこから先の輪郭や曲線を読まない。
+void DecodeNativeOutline(const std::uint8_t* data, std::size_t size, GlyphOutline& outline);
+
+// アウトラインから符号付き距離場 (SDF) を作る
+// originX, originY : 出力の左上のピクセルの角のアウトライン座標
+// spread : 距離場の幅 (ピクセル)。輪郭上が 128、内側に spread 入ると 255、外側に spread 出ると 0 になる。
+// dst : width * height バイト。上の行から順に書き込む。
+// 内外の判定は TrueType と同じ non-zero winding。
+void GenerateSdf(const GlyphOutline& outline, float originX, float originY,
+	std::size_t width, std::size_t height, float spread, std::uint8_t* dst);
+
+}
@@ -0,0 +1,16 @@
+#include "Header.hlsli"
+
+// FontTextureMap::Format::SDF8 の文字を描画するピクセルシェーダー
+// テクスチャには距離場が入っていて、0.5 が輪郭。
+// 画面上の1ピクセルあたりの距離の変化 (fwidth) で境界をぼかすので、拡大しても縮小しても輪郭がくっきりする。
+// サンプラーはバイリニアにすること。
+Texture2D _texture : register(t0);
+SamplerState _sampler : register(s0);
+
+float4 main(PSIn input) : SV_TARGET
+{
+    float dist = _texture.Sample(_sampler, input.uv).r;
+    float width = max(fwidth(dist), 1.0 / 255);
+    float alpha = smoothstep(0.5 - width, 0.5 + width, dist);
+    return alpha * input.color;  // 乗算済みアルファ
+}
\ No newline at end of file
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace dxstg {
+
+// SlotMap の要素を指すハンドル
+// 要素が消えるとその世代が進むので、古いハンドルは無効になる (ぶら下がらない)。
+struct SlotHandle {
+	std::uint32_t index = 0;      // スロットの番号
+	std::uint32_t generation = 0; // 0 は空のハンドル
+
+	explicit operator bool() const noexcept { return generation != 0; }
+	bool operator == (const SlotHandle& r) const noexcept { return index == r.index && generation == r.generation; }
+	bool operator != (const SlotHandle& r) const noexcept { return !(*this == r); }
+};
+
+// ハンドルで O(1) で引ける入れ物
+// 要素は隙間なく並べて持つ (追加した順)。要素を動かしてもハンドルは変わらない。
+// 要素へのポインタや参照は、追加・削除で無効になる。持ち続けるときはハンドルを使うこと。
+template <class T>
+class SlotMap final {
+public:
+	// 追加して、そのハンドルを返す
+	SlotHandle insert(T&& value)
+	{
+		std::uint32_t index;
+		if (m_freeHead != NoSlot) {
+			index = m_freeHead;
+			m_freeHead = m_slots[index].dense;
+		} else {
+			index = static_cast<std::uint32_t>(m_slots.size());
+			m_slots.push_back(Slot());
+		}
+
+		Slot& slot = m_slots[index];
+		slot.dense = static_cast<std::uint32_t>(m_values.size());
+		m_values.push_back(std::move(value));
+		m_handles.push_back({ index, slot.generation });
+		return m_handles.back();
+	}
+
+	// 消したスロットは世代を進めるので、世代が同じなら使用中
+	bool contains(SlotHandle handle) const noexcept
+	{
+		return handle.index < m_slots.size() && m_slots[handle.index].generation == handle.generation;
+	}
+
+	// なければ nullptr
+	T* get(SlotHandle handle) noexcept
+	{
+		return contains(handle) ? &m_values[m_slots[handle.index].dense] : nullptr;
+	}
+	const T* get(SlotHandle handle) const noexcept
+	{
+		return contains(handle) ? &m_values[m_slots[handle.index].dense] : nullptr;
+	}
+
+	// pred が true を返した要素を消す。残りの要素の順番は変わらない
+	template <class Pred>
+	size_t eraseIf(Pred pred)
+	{
+		size_t kept = 0;
+		for (size_t i = 0; i < m_values.size(); ++i) {
+			if (pred(m_values[i])) {
+				release(m_handles[i].index);
+				continue;
+			}
+			if (kept != i) {
+				m_values[kept] = std::move(m_values[i]);
+				m_handles[kept] = m_handles[i];
+				m_slots[m_handles[kept].index].dense = static_cast<std::uint32_t>(kept);
+			}
+			++kept;
+		}
+
+		const size_t erased = m_values.size() - kept;
+		m_values.erase(m_values.begin() + kept, m_values.end());
+		m_handles.erase(m_handles.begin() + kept, m_handles.end());
+		return erased;
+	}
+
+	void clear()
+	{
+		for (const auto& handle : m_handles) {
+			release(handle.index);
+		}
+		m_values.clear();
+		m_handles.clear();
+	}
+
+	// 並んでいる順に触る
+	size_t size() const noexcept { return m_values.size(); }
+	bool empty() const noexcept { return m_values.empty(); }
+	T& operator [] (size_t i) noexcept { return m_values[i]; }
+	const T& operator [] (size_t i) const noexcept { return m_values[i]; }
+	SlotHandle handleAt(size_t i) const noexcept { return m_handles[i]; }
+
+	// 1つあたりの大きさ (ハンドルとスロットの分も含む)
+	static constexpr size_t bytesPerElement() noexcept { return sizeof(T) + sizeof(SlotHandle) + sizeof(Slot); }
+
+	typename std::vector<T>::iterator begin() noexcept { return m_values.begin(); }
+	typename std::vector<T>::iterator end() noexcept { return m_values.end(); }
+	typename std::vector<T>::const_iterator begin() const noexcept { return m_values.begin(); }
+	typename std::vector<T>::const_iterator end() const noexcept { return m_values.end(); }
+
+private:
+	static constexpr std::uint32_t NoSlot = 0xffffffff;
+
+	struct Slot {
+		std::uint32_t dense = NoSlot;  // m_values の番号。空いているスロットでは次の空きスロット
+		std::uint32_t generation = 1;
+	};
+
+	// スロットを空きにして世代を進める
+	void release(std::uint32_t index) noexcept
+	{
+		Slot& slot = m_slots[index];
+		if (++slot.generation == 0) slot.generation = 1; // 0 は空のハンドル用
+		slot.dense = m_freeHead;
+		m_freeHead = index;
+	}
+
+	std::vector<T> m_values;          // 要素 (隙間なし)
+	std::vector<SlotHandle> m_handles; // m_values と同じ順のハンドル
+	std::vector<Slot> m_slots;
+	std::uint32_t m_freeHead = NoSlot;
+};
+
+}
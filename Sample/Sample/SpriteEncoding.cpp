@@ -0,0 +1,102 @@
+#include "SpriteEncoding.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace dxstg {
+
+namespace {
+
+// 位置を 15 ビットの整数にする (収まらなければ端に丸める)
+int QuantizePosition(float value, float origin, float positionUnit) noexcept
+{
+	const float q = std::round((value - origin) / positionUnit);
+	return static_cast<int>(std::min(std::max(q, -16384.f), 16383.f));
+}
+
+// 大きさを 15 ビットの整数にする
+int QuantizeSize(float value, float positionUnit) noexcept
+{
+	const float q = std::round(value / positionUnit);
+	return static_cast<int>(std::min(std::max(q, 0.f), 32767.f));
+}
+
+std::uint16_t PackUnorm16(float value) noexcept
+{
+	return static_cast<std::uint16_t>(std::min(std::max(value, 0.f), 1.f) * 65535.f + 0.5f);
+}
+
+std::uint8_t PackUnorm8(float value) noexcept
+{
+	return static_cast<std::uint8_t>(std::min(std::max(value, 0.f), 1.f) * 255.f + 0.5f);
+}
+
+// 色を乗算済みアルファにして詰める
+void PackColor(const Color& color, std::uint8_t& r, std::uint8_t& g, std::uint8_t& b, std::uint8_t& a) noexcept
+{
+	const float alpha = std::min(std::max(color.a, 0.f), 1.f);
+	r = PackUnorm8(color.r * alpha);
+	g = PackUnorm8(color.g * alpha);
+	b = PackUnorm8(color.b * alpha);
+	a = PackUnorm8(alpha);
+}
+
+std::int16_t PackVertexPosition(float value, float origin, float positionUnit, float uv) noexcept
+{
+	return static_cast<std::int16_t>(QuantizePosition(value, origin, positionUnit) * 2 + (uv >= 0.5f ? 1 : 0));
+}
+
+}
+
+void PackSpriteVertices(const SpriteQuad& quad, const SpriteEncoding& encoding, SpriteVertex* vertexes) noexcept
+{
+	const auto x0u0 = PackVertexPosition(quad.x0, encoding.originX, encoding.positionUnit, quad.u0);
+	const auto x1u1 = PackVertexPosition(quad.x1, encoding.originX, encoding.positionUnit, quad.u1);
+	const auto y0v0 = PackVertexPosition(quad.y0, encoding.originY, encoding.positionUnit, quad.v0);
+	const auto y1v1 = PackVertexPosition(quad.y1, encoding.originY, encoding.positionUnit, quad.v1);
+	vertexes[0].x = x0u0; vertexes[0].y = y0v0;
+	vertexes[1].x = x1u1; vertexes[1].y = y0v0;
+	vertexes[2].x = x0u0; vertexes[2].y = y1v1;
+	vertexes[3].x = x1u1; vertexes[3].y = y1v1;
+
+	std::uint8_t r, g, b, a;
+	PackColor(quad.color, r, g, b, a);
+	for (int v = 0; v < 4; ++v) {
+		vertexes[v].r = r;
+		vertexes[v].g = g;
+		vertexes[v].b = b;
+		vertexes[v].a = a;
+	}
+}
+
+void PackSpriteInstance(const SpriteQuad& quad, const SpriteEncoding& encoding, SpriteInstance& instance) noexcept
+{
+	// 位置が小さいほうを 0 側にする (UV も一緒に入れ替える)
+	float x0 = quad.x0, x1 = quad.x1, u0 = quad.u0, u1 = quad.u1;
+	float y0 = quad.y0, y1 = quad.y1, v0 = quad.v0, v1 = quad.v1;
+	if (x0 > x1) {
+		std::swap(x0, x1);
+		std::swap(u0, u1);
+	}
+	if (y0 > y1) {
+		std::swap(y0, y1);
+		std::swap(v0, v1);
+	}
+
+	// UV が位置と逆向きに進むなら反転
+	const int flipU = (u0 > u1) ? 1 : 0;
+	const int flipV = (v0 > v1) ? 1 : 0;
+
+	instance.centerX = static_cast<std::int16_t>(QuantizePosition((x0 + x1) * 0.5f, encoding.originX, encoding.positionUnit));
+	instance.centerY = static_cast<std::int16_t>(QuantizePosition((y0 + y1) * 0.5f, encoding.originY, encoding.positionUnit));
+	instance.halfWidth = static_cast<std::uint16_t>(QuantizeSize((x1 - x0) * 0.5f, encoding.positionUnit) * 2 + flipU);
+	instance.halfHeight = static_cast<std::uint16_t>(QuantizeSize((y1 - y0) * 0.5f, encoding.positionUnit) * 2 + flipV);
+	instance.u0 = PackUnorm16(std::min(u0, u1));
+	instance.v0 = PackUnorm16(std::min(v0, v1));
+	instance.u1 = PackUnorm16(std::max(u0, u1));
+	instance.v1 = PackUnorm16(std::max(v0, v1));
+	PackColor(quad.color, instance.r, instance.g, instance.b, instance.a);
+}
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+
+#include "StgObject.h"
+
+namespace dxstg {
+
+// スプライトを GPU に送る形に詰める
+// Windows や D3D11 には依存しないので、ほかの環境でもそのままビルドして確かめられる。
+
+// 四角形1枚
+// 頂点は (x0, y0), (x1, y0), (x0, y1), (x1, y1) で、
+// それぞれ (u0, v0), (u1, v0), (u0, v1), (u1, v1) が対応する。
+struct SpriteQuad {
+	float x0, y0, x1, y1;
+	float u0, v0, u1, v1;
+	Color color; // 普通のアルファ。詰めるときに乗算済みにする
+};
+
+// 位置を詰めるときの基準 (バッチごとに決める)
+// 位置は (座標 - 原点) / positionUnit を整数にしたもの。
+struct SpriteEncoding {
+	float originX, originY;
+	float positionUnit; // 1 あたりの大きさ
+};
+
+// 頂点ごとに送るときの頂点 (8バイト)
+// UV はテクスチャの角 (0 か 1) しか使えないので、位置の最下位ビットに入れる。
+struct SpriteVertex {
+	std::int16_t x, y;       // 位置 * 2 + u, 位置 * 2 + v (R16G16_SINT)
+	std::uint8_t r, g, b, a; // 色 (R8G8B8A8_UNORM, 乗算済みアルファ)
+};
+static_assert(sizeof(SpriteVertex) == 8, "SpriteVertex must be 8 bytes");
+
+// インスタンスごとに送るときの1枚分 (20バイト)
+// 頂点シェーダーが SV_VertexID から四角形の角を作る。
+struct SpriteInstance {
+	std::int16_t centerX, centerY;        // 中心の位置 (R16G16_SINT)
+	std::uint16_t halfWidth, halfHeight;  // 大きさの半分 * 2 + 反転フラグ (R16G16_UINT)
+	std::uint16_t u0, v0, u1, v1;         // テクスチャの範囲 (R16G16B16A16_UNORM)
+	std::uint8_t r, g, b, a;              // 色 (R8G8B8A8_UNORM, 乗算済みアルファ)
+};
+static_assert(sizeof(SpriteInstance) == 20, "SpriteInstance must be 20 bytes");
+
+// 4頂点を (x0, y0), (x1, y0), (x0, y1), (x1, y1) の順に書き込む
+// 1枚ごとに 0, 1, 2, 2, 1, 3 のインデックスで TRIANGLELIST として描く (main.cpp の indexBuffer)。
+void PackSpriteVertices(const SpriteQuad& quad, const SpriteEncoding& encoding, SpriteVertex* vertexes) noexcept;
+
+// 1枚分を書き込む
+// 位置は小さいほうを (u0, v0) 側にそろえ、UV が逆向きに進むときは反転フラグを立てる。
+void PackSpriteInstance(const SpriteQuad& quad, const SpriteEncoding& encoding, SpriteInstance& instance) noexcept;
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace dxstg {
+
+// 書き込み側スレッド1つと読み込み側スレッド1つの間の、固定長のキュー
+// ロックを使わず、どちらも相手を待たない。いっぱいのときは tryPush が false を返す。
+// Capacity は2のべき乗。
+template <class T, size_t Capacity>
+class SpscQueue final {
+	static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+	SpscQueue() : m_head(0), m_tail(0) {}
+	SpscQueue(const SpscQueue&) = delete;              // コピー不可
+	SpscQueue& operator = (const SpscQueue&) = delete; // コピー不可
+
+	// 書き込み側: 末尾に追加する。いっぱいなら何もせずに false
+	bool tryPush(const T& value) noexcept
+	{
+		const size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) == Capacity) return false;
+		m_items[tail & (Capacity - 1)] = value;
+		m_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// 読み込み側: 先頭を取り出す。空なら何もせずに false
+	bool tryPop(T& value) noexcept
+	{
+		const size_t head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire)) return false;
+		value = m_items[head & (Capacity - 1)];
+		m_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	static constexpr size_t capacity() noexcept { return Capacity; }
+
+private:
+	T m_items[Capacity];
+	alignas(64) std::atomic<size_t> m_head; // 読み込み側が進める
+	alignas(64) std::atomic<size_t> m_tail; // 書き込み側が進める
+};
+
+}
@@ -0,0 +1,75 @@
+#include "Stage.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace dxstg {
+
+bool IsValidStageRecord(const StageRecord& record, std::uint32_t previousTick) noexcept
+{
+	if (record.tick < previousTick) return false;
+	if (record.kind != static_cast<std::uint16_t>(StageRecordKind::SPAWN_ENEMY)) return false;
+	if (record.enemyType != static_cast<std::uint16_t>(StageEnemyType::BASIC)) return false;
+	if (record.pattern > static_cast<std::uint16_t>(EnemyPattern::AIMED)) return false;
+	if (record.fireInterval == 0) return false;
+	return std::isfinite(record.x) && std::isfinite(record.y)
+		&& std::isfinite(record.spread) && std::isfinite(record.bulletSpeed);
+}
+
+EnemySpec MakeEnemySpec(const StageRecord& record) noexcept
+{
+	EnemySpec spec;
+	spec.pattern = static_cast<EnemyPattern>(record.pattern);
+	spec.fireInterval = record.fireInterval;
+	spec.bulletCount = record.bulletCount;
+	spec.spread = record.spread;
+	spec.bulletSpeed = record.bulletSpeed;
+	spec.lifetime = record.lifetime;
+	return spec;
+}
+
+StageTimeline::StageTimeline(AssetView&& data) :
+	m_data(std::move(data))
+{
+	if (m_data && !open()) {
+		OutputDebugStringW(L"failed: StageTimeline (broken stage)\n");
+	}
+}
+
+bool StageTimeline::open() noexcept
+{
+	const size_t size = m_data.size();
+	if (size < sizeof(StageHeader)) return false;
+
+	// ヘッダーだけ確かめる (レコードは読むときに1つずつ確かめる)
+	const auto bytes = static_cast<const std::uint8_t*>(m_data.get());
+	const auto header = reinterpret_cast<const StageHeader*>(bytes);
+	if (std::memcmp(header->magic, "DXSG", 4) != 0) return false;
+	if (header->version != StageVersion) return false;
+	if (header->recordOffset < sizeof(StageHeader) || header->recordOffset > size) return false;
+	if ((size - header->recordOffset) / sizeof(StageRecord) < header->recordCount) return false;
+	if (reinterpret_cast<std::uintptr_t>(bytes + header->recordOffset) % alignof(StageRecord) != 0) return false;
+
+	m_records = reinterpret_cast<const StageRecord*>(bytes + header->recordOffset);
+	m_recordCount = header->recordCount;
+	m_lastTick = header->lastTick;
+	return true;
+}
+
+size_t StageTimeline::lowerBound(std::uint32_t tick) const noexcept
+{
+	// tick 順に並んでいるので二分探索 (触るページは log2(size) 個)
+	size_t lo = 0;
+	size_t hi = m_recordCount;
+	while (lo < hi) {
+		const size_t mid = lo + (hi - lo) / 2;
+		if (m_records[mid].tick < tick) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "AssetPack.h"
+#include "StgObject.h"
+
+namespace dxstg {
+
+// Tools/stage.py が出力するステージ (.stage) の形式
+// すべてリトルエンディアン。
+// [StageHeader][StageRecord × recordCount (tick 順)]
+// レコードは固定長なので、読むときは今のティックまでの分だけを順に見ればよい (残りには触らない)。
+struct StageHeader {
+	char magic[4];              // "DXSG"
+	std::uint32_t version;      // StageVersion
+	std::uint32_t recordCount;
+	std::uint32_t recordOffset; // ファイルの先頭からのバイト数 (16の倍数)
+	std::uint32_t lastTick;     // 最後のレコードの tick
+	std::uint32_t reserved[3];
+};
+
+enum class StageRecordKind : std::uint16_t {
+	SPAWN_ENEMY = 1 // 敵を出す
+};
+
+enum class StageEnemyType : std::uint16_t {
+	BASIC = 0 // Enemy
+};
+
+struct StageRecord {
+	std::uint32_t tick;         // World::tick() がこの値になったティックで起きる (1 から)
+	std::uint16_t kind;         // StageRecordKind
+	std::uint16_t enemyType;    // StageEnemyType
+	float x;
+	float y;
+	std::uint16_t pattern;      // EnemyPattern
+	std::uint16_t bulletCount;
+	std::uint16_t fireInterval; // ティック数 (1 以上)
+	std::uint16_t lifetime;     // ティック数 (0 なら消えない)
+	float spread;               // ラジアン
+	float bulletSpeed;
+};
+
+static_assert(sizeof(StageHeader) == 32, "StageHeader must be 32 bytes");
+static_assert(sizeof(StageRecord) == 32, "StageRecord must be 32 bytes");
+
+constexpr std::uint32_t StageVersion = 1;
+
+// 壊れたレコードでないか (previousTick は直前に受け付けたレコードの tick)
+bool IsValidStageRecord(const StageRecord& record, std::uint32_t previousTick) noexcept;
+
+// SPAWN_ENEMY のレコードから敵の設定を作る (IsValidStageRecord で確かめたものを渡すこと)
+EnemySpec MakeEnemySpec(const StageRecord& record) noexcept;
+
+// ステージのファイル
+// 開くときはヘッダーを確かめるだけで、レコードはコピーもデコードもしない (長いステージでもすぐ開ける)。
+// ファイルをマップして持つので、レコードのページはそのレコードを読むときに初めて読み込まれる。
+// 複数の World (とそのスレッド) から同時に読んでよい。
+class StageTimeline final {
+public:
+	StageTimeline() = default;
+	explicit StageTimeline(AssetView&& data);
+
+	explicit operator bool() const noexcept { return m_records != nullptr; }
+	size_t size() const noexcept { return m_recordCount; }
+	std::uint32_t lastTick() const noexcept { return m_lastTick; }
+	const StageRecord* records() const noexcept { return m_records; }
+
+	// tick 以上の最初のレコードの番号 (途中から始めるとき用)
+	size_t lowerBound(std::uint32_t tick) const noexcept;
+
+private:
+	AssetView m_data;
+	const StageRecord* m_records = nullptr;
+	size_t m_recordCount = 0;
+	std::uint32_t m_lastTick = 0;
+
+	bool open() noexcept;
+};
+
+// ステージを読み進める位置
+// advance(tick) で、tick までに来たレコードだけを順にデコードして渡す。
+class StageCursor final {
+public:
+	StageCursor() = default;
+
+	// timeline は StageCursor より長く生きること。startTick より前のレコードは飛ばす
+	explicit StageCursor(const StageTimeline& timeline, std::uint32_t startTick = 0) noexcept
+		: m_records(timeline.records())
+		, m_next(timeline.lowerBound(startTick))
+		, m_end(timeline.size()) {}
+
+	// tick までに来たレコードを f(const StageRecord&) に渡す。渡した数を返す
+	// 壊れたレコード (順番が戻っている、値がおかしいなど) は渡さずに数える。
+	template <class F>
+	size_t advance(std::uint64_t tick, F&& f)
+	{
+		size_t count = 0;
+		while (m_next < m_end && m_records[m_next].tick <= tick) {
+			const StageRecord& record = m_records[m_next++];
+			if (!IsValidStageRecord(record, m_previousTick)) {
+				++m_rejectedCount;
+				continue;
+			}
+			m_previousTick = record.tick;
+			f(record);
+			++count;
+		}
+		return count;
+	}
+
+	bool finished() const noexcept { return m_next == m_end; }
+	size_t position() const noexcept { return m_next; } // 次に読むレコードの番号
+	size_t rejectedCount() const noexcept { return m_rejectedCount; }
+
+private:
+	const StageRecord* m_records = nullptr;
+	size_t m_next = 0;
+	size_t m_end = 0;
+	std::uint32_t m_previousTick = 0;
+	size_t m_rejectedCount = 0;
+};
+
+}
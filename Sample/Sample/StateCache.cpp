@@ -0,0 +1,191 @@
+#include "StateCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+
+namespace dxstg {
+
+namespace {
+
+// FNV-1a
+std::uint64_t HashBytes(const void* data, size_t size) noexcept
+{
+	const auto bytes = static_cast<const std::uint8_t*>(data);
+	std::uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// slot に覚えているものと同じなら true。違えば覚え直して false
+// valid は覚えているスロットのビット
+template <class T>
+bool SameAsBound(Microsoft::WRL::ComPtr<T>* slots, UINT& valid, UINT slot, T* object)
+{
+	if (slot >= StateCache::MaxSlots) return false;
+
+	const UINT bit = 1u << slot;
+	if ((valid & bit) && slots[slot].Get() == object) return true;
+	slots[slot] = object;
+	valid |= bit;
+	return false;
+}
+
+} // end unnamed namespace
+
+StateCacheCounter StateCacheStats::total() const noexcept
+{
+	StateCacheCounter sum;
+	for (const StateCacheCounter* c : { &shader, &shaderResource, &sampler, &constantBuffer, &blendState, &bufferUpdate }) {
+		sum.issued += c->issued;
+		sum.filtered += c->filtered;
+	}
+	return sum;
+}
+
+StateCache::StateCache(ID3D11DeviceContext* context) :
+	m_context(context)
+{
+	invalidate();
+}
+
+void StateCache::setVertexShader(ID3D11VertexShader* shader)
+{
+	if (m_vertexShaderValid && m_vertexShader.Get() == shader) {
+		++m_stats.shader.filtered;
+		return;
+	}
+	m_vertexShader = shader;
+	m_vertexShaderValid = true;
+	m_context->VSSetShader(shader, nullptr, 0);
+	++m_stats.shader.issued;
+}
+
+void StateCache::setPixelShader(ID3D11PixelShader* shader)
+{
+	if (m_pixelShaderValid && m_pixelShader.Get() == shader) {
+		++m_stats.shader.filtered;
+		return;
+	}
+	m_pixelShader = shader;
+	m_pixelShaderValid = true;
+	m_context->PSSetShader(shader, nullptr, 0);
+	++m_stats.shader.issued;
+}
+
+void StateCache::setPSShaderResource(UINT slot, ID3D11ShaderResourceView* view)
+{
+	if (SameAsBound(m_psShaderResources, m_psShaderResourcesValid, slot, view)) {
+		++m_stats.shaderResource.filtered;
+		return;
+	}
+	m_context->PSSetShaderResources(slot, 1, &view);
+	++m_stats.shaderResource.issued;
+}
+
+void StateCache::setPSSampler(UINT slot, ID3D11SamplerState* sampler)
+{
+	if (SameAsBound(m_psSamplers, m_psSamplersValid, slot, sampler)) {
+		++m_stats.sampler.filtered;
+		return;
+	}
+	m_context->PSSetSamplers(slot, 1, &sampler);
+	++m_stats.sampler.issued;
+}
+
+void StateCache::setVSConstantBuffer(UINT slot, ID3D11Buffer* buffer)
+{
+	if (SameAsBound(m_vsConstantBuffers, m_vsConstantBuffersValid, slot, buffer)) {
+		++m_stats.constantBuffer.filtered;
+		return;
+	}
+	m_context->VSSetConstantBuffers(slot, 1, &buffer);
+	++m_stats.constantBuffer.issued;
+}
+
+void StateCache::setPSConstantBuffer(UINT slot, ID3D11Buffer* buffer)
+{
+	if (SameAsBound(m_psConstantBuffers, m_psConstantBuffersValid, slot, buffer)) {
+		++m_stats.constantBuffer.filtered;
+		return;
+	}
+	m_context->PSSetConstantBuffers(slot, 1, &buffer);
+	++m_stats.constantBuffer.issued;
+}
+
+void StateCache::setBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4], UINT sampleMask)
+{
+	static const FLOAT defaultFactor[4] = { 1, 1, 1, 1 };
+	if (blendFactor == nullptr) blendFactor = defaultFactor;
+
+	if (m_blendStateValid && m_blendState.Get() == state && m_sampleMask == sampleMask
+		&& std::memcmp(m_blendFactor, blendFactor, sizeof(m_blendFactor)) == 0) {
+		++m_stats.blendState.filtered;
+		return;
+	}
+	m_blendState = state;
+	std::copy(blendFactor, blendFactor + 4, m_blendFactor);
+	m_sampleMask = sampleMask;
+	m_blendStateValid = true;
+	m_context->OMSetBlendState(state, blendFactor, sampleMask);
+	++m_stats.blendState.issued;
+}
+
+HRESULT StateCache::updateConstantBuffer(ID3D11Buffer* buffer, const void* data, size_t size)
+{
+	const std::uint64_t hash = HashBytes(data, size);
+
+	auto shadow = std::find_if(m_bufferShadows.begin(), m_bufferShadows.end(),
+		[buffer](const BufferShadow& s) { return s.buffer.Get() == buffer; });
+	if (shadow != m_bufferShadows.end() && shadow->hash == hash && shadow->data.size() == size
+		&& std::memcmp(shadow->data.data(), data, size) == 0) {
+		++m_stats.bufferUpdate.filtered;
+		return S_OK;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE subresource;
+	HRESULT hr = m_context->Map(buffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &subresource);
+	if (FAILED(hr)) {
+		if (shadow != m_bufferShadows.end()) m_bufferShadows.erase(shadow); // 中身がわからなくなった
+		return hr;
+	}
+	std::memcpy(subresource.pData, data, size);
+	m_context->Unmap(buffer, 0);
+	++m_stats.bufferUpdate.issued;
+
+	if (shadow == m_bufferShadows.end()) {
+		m_bufferShadows.push_back({ buffer, 0, {} });
+		shadow = m_bufferShadows.end() - 1;
+	}
+	shadow->hash = hash;
+	shadow->data.assign(static_cast<const std::uint8_t*>(data), static_cast<const std::uint8_t*>(data) + size);
+	return S_OK;
+}
+
+void StateCache::invalidate()
+{
+	m_vertexShader.Reset();
+	m_pixelShader.Reset();
+	for (UINT i = 0; i < MaxSlots; ++i) {
+		m_psShaderResources[i].Reset();
+		m_psSamplers[i].Reset();
+		m_vsConstantBuffers[i].Reset();
+		m_psConstantBuffers[i].Reset();
+	}
+	m_blendState.Reset();
+	std::fill(m_blendFactor, m_blendFactor + 4, 0.f);
+	m_sampleMask = 0;
+	m_blendStateValid = false;
+	m_vertexShaderValid = false;
+	m_pixelShaderValid = false;
+	m_psShaderResourcesValid = 0;
+	m_psSamplersValid = 0;
+	m_vsConstantBuffersValid = 0;
+	m_psConstantBuffersValid = 0;
+	m_bufferShadows.clear();
+}
+
+}
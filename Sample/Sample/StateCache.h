@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <wrl/client.h>
+#include <d3d11.h>
+
+namespace dxstg {
+
+// StateCache が実際に発行した呼び出しと、前と同じなので省いた呼び出しの数
+struct StateCacheCounter {
+	std::uint64_t issued = 0;
+	std::uint64_t filtered = 0;
+};
+
+struct StateCacheStats {
+	StateCacheCounter shader;          // VSSetShader, PSSetShader
+	StateCacheCounter shaderResource;  // PSSetShaderResources
+	StateCacheCounter sampler;         // PSSetSamplers
+	StateCacheCounter constantBuffer;  // VSSetConstantBuffers, PSSetConstantBuffers
+	StateCacheCounter blendState;      // OMSetBlendState
+	StateCacheCounter bufferUpdate;    // 定数バッファの Map / Unmap
+
+	StateCacheCounter total() const noexcept;
+};
+
+// デバイスコンテキストに設定した状態を覚えておき、同じものの再設定を省く
+// シェーダー・テクスチャ・サンプラー・定数バッファ・ブレンドステートはこのクラスを通して設定すること。
+// (直接 immediateContext に設定したときは invalidate() を呼ぶ)
+// 設定中のオブジェクトは参照を持っておくので、解放されたアドレスの再利用で誤って省かれることはない。
+class StateCache final {
+public:
+	static constexpr UINT MaxSlots = 8; // これより後ろのスロットは覚えずにそのまま設定する
+
+	explicit StateCache(ID3D11DeviceContext* context);
+	StateCache(const StateCache&) = delete;              // コピー不可
+	StateCache& operator = (const StateCache&) = delete; // コピー不可
+
+	void setVertexShader(ID3D11VertexShader* shader);
+	void setPixelShader(ID3D11PixelShader* shader);
+	void setPSShaderResource(UINT slot, ID3D11ShaderResourceView* view);
+	void setPSSampler(UINT slot, ID3D11SamplerState* sampler);
+	void setVSConstantBuffer(UINT slot, ID3D11Buffer* buffer);
+	void setPSConstantBuffer(UINT slot, ID3D11Buffer* buffer);
+	void setBlendState(ID3D11BlendState* state, const FLOAT blendFactor[4] = nullptr, UINT sampleMask = 0xffffffff);
+
+	// 動的な定数バッファ (D3D11_USAGE_DYNAMIC) の中身を書き換える
+	// 前回このクラスで書き込んだ内容と同じなら Map しない。
+	HRESULT updateConstantBuffer(ID3D11Buffer* buffer, const void* data, size_t size);
+
+	template <class T>
+	HRESULT updateConstantBuffer(ID3D11Buffer* buffer, const T& data)
+	{
+		return updateConstantBuffer(buffer, &data, sizeof(T));
+	}
+
+	// 覚えている状態を捨てる (次の設定はすべて発行される)
+	void invalidate();
+
+	const StateCacheStats& getStats() const noexcept { return m_stats; }
+	void resetStats() noexcept { m_stats = StateCacheStats(); }
+
+private:
+	struct BufferShadow {
+		Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+		std::uint64_t hash;
+		std::vector<std::uint8_t> data; // 最後に書き込んだ内容
+	};
+
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> m_context;
+	Microsoft::WRL::ComPtr<ID3D11VertexShader> m_vertexShader;
+	Microsoft::WRL::ComPtr<ID3D11PixelShader> m_pixelShader;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> m_psShaderResources[MaxSlots];
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> m_psSamplers[MaxSlots];
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_vsConstantBuffers[MaxSlots];
+	Microsoft::WRL::ComPtr<ID3D11Buffer> m_psConstantBuffers[MaxSlots];
+	Microsoft::WRL::ComPtr<ID3D11BlendState> m_blendState;
+	FLOAT m_blendFactor[4];
+	UINT m_sampleMask;
+
+	// 覚えている状態が有効か (invalidate() 直後は何も覚えていない)
+	bool m_vertexShaderValid;
+	bool m_pixelShaderValid;
+	bool m_blendStateValid;
+	UINT m_psShaderResourcesValid; // スロットごとのビット
+	UINT m_psSamplersValid;
+	UINT m_vsConstantBuffersValid;
+	UINT m_psConstantBuffersValid;
+
+	std::vector<BufferShadow> m_bufferShadows; // 定数バッファは数個なので線形探索
+	StateCacheStats m_stats;
+};
+
+}
@@ -1,21 +1,18 @@
 #include "StgObject.h"
 #include "Game.h"
 
+#include <cmath>
+
 namespace dxstg {
 
 Player::Player()
-	: StgObject(Type::PLAYER, TextureID::XCHU)
+	: StgObject(Type::PLAYER, TextureID::XCHU, Layer::PLAYER)
 	, m_x(0)
 	, m_y(0)
 {
 	updateRect();
 }
 
-Player::~Player()
-{
-	SetPlayer(nullptr);
-}
-
 void Player::update()
 {
 	if (GetInput().left)  m_x -= 0.05f;
@@ -25,10 +22,20 @@ void Player::update()
 	updateRect();
 }
 
-void Player::hit(const StgObject& obj)
+void Player::hit(Type otherType)
 {
-	if (obj.getType() == Type::ENEMY) {
+	if (otherType == Type::ENEMY && !removable) {
 		removable = true;
+
+		// やられたときのエフェクト
+		ParticleBurst burst;
+		burst.position = { m_x, m_y };
+		burst.count = 96;
+		burst.speed = 0.12f;
+		burst.lifetime = 45;
+		burst.halfSize = 0.08f;
+		burst.rgb = 0x40a0ff; // 橙
+		EmitParticles(burst);
 	}
 }
 
@@ -40,43 +47,19 @@ void Player::updateRect()
 	drawRect.maxY = hitRect.maxY = m_y + 0.5f;
 }
 
-EnemyBullet::EnemyBullet(float x, float y)
-	: StgObject(Type::ENEMY, TextureID::BULLET)
-	, m_x(x)
-	, m_y(y)
-	, m_time(60)
-{
-	updateRect();
-}
-
-void EnemyBullet::update()
-{
-	m_x -= 0.1f;
-	updateRect();
-
-	if (--m_time <= 0) {
-		removable = true;
-	}
-}
-
-void EnemyBullet::hit(const StgObject& obj)
+void EnemyBullet::update(Storage& bullets)
 {
-
+	bullets.each<Position, Velocity>([](Position& position, const Velocity& velocity) {
+		position.x += velocity.x;
+		position.y += velocity.y;
+	});
 }
 
-void EnemyBullet::updateRect()
-{
-	drawRect.maxX = hitRect.maxX = m_x + 0.3f;
-	drawRect.minX = hitRect.minX = m_x - 0.3f;
-	drawRect.maxY = hitRect.maxY = m_y + 0.15f;
-	drawRect.minY = hitRect.minY = m_y - 0.15f;
-}
-
-Enemy::Enemy(float x, float y)
-	: StgObject(Type::ENEMY, TextureID::XCHU)
+Enemy::Enemy(float x, float y, const EnemySpec& spec)
+	: StgObject(Type::ENEMY, TextureID::XCHU, Layer::ENEMY)
 	, m_x(x)
 	, m_y(y)
-	, m_count(0)
+	, m_spec(spec)
 {
 	updateRect();
 	color.set(1.f, 0.3f, 0.0f);
@@ -85,6 +68,8 @@ Enemy::Enemy(float x, float y)
 
 void Enemy::update()
 {
+	if (m_spec.pattern != EnemyPattern::TRACK) return;
+
 	constexpr float speed = 0.01f;
 	const auto player = GetPlayer();
 	if (player != nullptr) {
@@ -97,15 +82,64 @@ void Enemy::update()
 		m_y += delta;
 		updateRect();
 	}
+}
 
+void Enemy::start()
+{
+	if (m_spec.bulletCount > 0) {
+		schedule(m_spec.fireInterval, TimerEvent::FIRE);
+	}
+	if (m_spec.lifetime > 0) {
+		schedule(m_spec.lifetime, TimerEvent::EXPIRE);
+	}
+}
 
-	if (++m_count >= 60) {
-		m_count = 0;
-		AddObject(std::make_unique<EnemyBullet>(m_x, m_y));
+void Enemy::onTimer(TimerEvent event)
+{
+	if (event == TimerEvent::EXPIRE) {
+		removable = true;
+	} else if (event == TimerEvent::FIRE) {
+		fire();
+		schedule(m_spec.fireInterval, TimerEvent::FIRE);
 	}
 }
 
-void Enemy::hit(const StgObject& obj)
+void Enemy::fire()
+{
+	// 真ん中の弾の向き (左、AIMED なら自機の方)
+	float dirX = -1.f;
+	float dirY = 0.f;
+	const auto player = GetPlayer();
+	if (m_spec.pattern == EnemyPattern::AIMED && player != nullptr) {
+		const float dx = player->getX() - m_x;
+		const float dy = player->getY() - m_y;
+		const float length = std::sqrt(dx * dx + dy * dy);
+		if (length > 0.f) {
+			dirX = dx / length;
+			dirY = dy / length;
+		}
+	}
+
+	// 真ん中の向きから spread ずつ回して扇形に並べる
+	for (std::uint32_t i = 0; i < m_spec.bulletCount; ++i) {
+		const float angle = (i - (m_spec.bulletCount - 1) * 0.5f) * m_spec.spread;
+		const float c = std::cos(angle);
+		const float s = std::sin(angle);
+		SpawnEnemyBullet({ m_x, m_y }, { (dirX * c - dirY * s) * m_spec.bulletSpeed, (dirX * s + dirY * c) * m_spec.bulletSpeed });
+	}
+
+	// 撃ったときのエフェクト
+	ParticleBurst burst;
+	burst.position = { m_x, m_y };
+	burst.count = 12;
+	burst.speed = 0.04f;
+	burst.lifetime = 15;
+	burst.halfSize = 0.05f;
+	burst.rgb = 0x80e0ff; // 黄
+	EmitParticles(burst);
+}
+
+void Enemy::hit(Type otherType)
 {
 
 }
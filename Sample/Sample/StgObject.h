@@ -1,5 +1,11 @@
 #pragma once
 
+#include <cstdint>
+
+#include "Archetype.h"
+#include "Components.h"
+#include "Game.h"
+
 namespace dxstg {
 
 struct Color {
@@ -28,6 +34,12 @@ struct Rectangle {
 	{
 		return (minX <= r.maxX && r.minX <= maxX) && (minY <= r.maxY && r.minY <= maxY);
 	}
+
+	// 上下左右に margin ずつ広げたもの
+	Rectangle inflated(float margin) const noexcept
+	{
+		return { minX - margin, minY - margin, maxX + margin, maxY + margin };
+	}
 };
 
 class StgObject {
@@ -43,10 +55,19 @@ public:
 		ENEMY
 	};
 
-	StgObject(Type type, TextureID textureID)
+	// 描画の層。後ろのものほど手前に描画される
+	enum class Layer {
+		ENEMY,
+		PLAYER,
+		BULLET,
+		EFFECT
+	};
+
+	StgObject(Type type, TextureID textureID, Layer layer)
 		: removable(false)
 		, m_type(type)
-		, m_textureID(textureID) {}
+		, m_textureID(textureID)
+		, m_layer(layer) {}
 
 	StgObject(const StgObject&) = delete;
 	StgObject& operator = (const StgObject&) = delete;
@@ -54,7 +75,21 @@ public:
 	virtual ~StgObject() = default;
 
 	virtual void update() = 0;
-	virtual void hit(const StgObject& obj) = 0;
+	// 当たったときに呼ばれる (otherType は相手の種類)
+	virtual void hit(Type otherType) = 0;
+
+	// AddObject から呼ばれる。ハンドルを覚えて start() を呼ぶ
+	void attach(ObjectHandle handle)
+	{
+		m_handle = handle;
+		start();
+	}
+	ObjectHandle getHandle() const noexcept { return m_handle; }
+
+	// schedule で登録したタイマーの期限が来たときに呼ばれる
+	// 何も起きないティックに update で数えるのではなく、タイマーで待つ
+	virtual void onTimer(TimerEvent event) {}
+
 	const Rectangle& getHitRect() const noexcept { return hitRect; }
 	const Rectangle& getDrawRect() const noexcept { return drawRect; }
 	const Color& getColor() const noexcept { return color; }
@@ -62,60 +97,107 @@ public:
 	bool isMirrorY() const noexcept { return mirrorY; }
 	Type getType() const noexcept { return m_type; }
 	TextureID getTextureID() const noexcept { return m_textureID; }
+	Layer getLayer() const noexcept { return m_layer; }
+	bool isRetiredOffscreen() const noexcept { return retireOffscreen; }
 	
 	bool removable;
 
 protected:
-	Rectangle hitRect;   // 蔻̈
-	Rectangle drawRect;  // `̈
+	Rectangle hitRect;   // 当たり判定領域
+	Rectangle drawRect;  // 描画領域
 	Color color;
 	bool mirrorX = false;
 	bool mirrorY = false;
+	bool retireOffscreen = false;  // 画面外に出たら消してよい (弾など)
+
+	// 追加されたときに呼ばれる (タイマーの登録など)
+	virtual void start() {}
+
+	// delayTicks ティック後に onTimer(event) を呼んでもらう
+	void schedule(std::uint32_t delayTicks, TimerEvent event)
+	{
+		ScheduleTimer(m_handle, delayTicks, event);
+	}
 
 private:
 	const Type m_type;
 	const TextureID m_textureID;
+	const Layer m_layer;
+	ObjectHandle m_handle;
 };
 
 
 class Player : public StgObject {
 public:
 	Player();
-	virtual ~Player();
+	virtual ~Player() = default;
 
 	virtual void update() override;
-	virtual void hit(const StgObject& obj) override;
+	virtual void hit(Type otherType) override;
+	float getX() const noexcept { return m_x; }
 	float getY() const noexcept { return m_y; }
 private:
 	float m_x, m_y;
 	void updateRect();
 };
 
-class EnemyBullet : public StgObject {
-public:
-	EnemyBullet(float x, float y);
-	virtual ~EnemyBullet() = default;
+// 敵の弾
+// 数が多いので StgObject にはせず (仮想関数・矩形2つ・色などを持たない)、位置と速度だけを Archetype にまとめて持つ。
+// 大きさ・見た目・寿命は種類で決まる定数。当たっても弾の側は何もしない。
+struct EnemyBullet {
+	using Storage = Archetype<Position, Velocity>;
+
+	static constexpr StgObject::Type type = StgObject::Type::ENEMY;
+	static constexpr StgObject::TextureID textureID = StgObject::TextureID::BULLET;
+	static constexpr StgObject::Layer layer = StgObject::Layer::BULLET;
+	static constexpr float halfWidth = 0.3f;
+	static constexpr float halfHeight = 0.15f;
+	static constexpr std::uint32_t lifetime = 60; // 消えるまでのティック数
+
+	// 当たり判定と描画の領域 (同じ)
+	static Rectangle rect(const Position& position) noexcept
+	{
+		return { position.x - halfWidth, position.y - halfHeight, position.x + halfWidth, position.y + halfHeight };
+	}
 
-	virtual void update() override;
-	virtual void hit(const StgObject& obj) override;
+	// すべての弾を1ティック動かす
+	static void update(Storage& bullets);
+};
 
-private:
-	float m_x, m_y;
-	int m_time;
-	void updateRect();
+// 敵の動き方と弾の向き
+enum class EnemyPattern : std::uint16_t {
+	TRACK, // 自機と同じ高さへ動きながら、左へ撃つ
+	FIXED, // 止まったまま、左へ撃つ
+	AIMED  // 止まったまま、自機を狙って撃つ
+};
+
+// 敵の設定 (ステージのスクリプトで決める)
+struct EnemySpec {
+	EnemyPattern pattern = EnemyPattern::TRACK;
+	std::uint32_t fireInterval = 60; // 弾を撃つ間隔 (ティック数)
+	std::uint32_t bulletCount = 1;   // 1回に撃つ弾の数 (扇形に広げる。0 なら撃たない)
+	float spread = 0.f;              // 隣り合う弾の向きの差 (ラジアン)
+	float bulletSpeed = 0.1f;
+	std::uint32_t lifetime = 0;      // 消えるまでのティック数 (0 なら消えない)
 };
 
 class Enemy : public StgObject {
 public:
-	Enemy(float x, float y);
+	Enemy(float x, float y, const EnemySpec& spec = EnemySpec());
 	virtual ~Enemy() = default;
 
 	virtual void update() override;
-	virtual void hit(const StgObject& obj) override;
+	virtual void hit(Type otherType) override;
+	virtual void onTimer(TimerEvent event) override;
+
+protected:
+	virtual void start() override;
+
 private:
 	float m_x, m_y;
-	int m_count;
+	EnemySpec m_spec;
 	void updateRect();
+	void fire();
 };
 
 } // namespace dxstg
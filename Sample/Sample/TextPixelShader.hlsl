@@ -0,0 +1,12 @@
+#include "Header.hlsli"
+
+// FontTextureMap::Format::R8 の文字を描画するピクセルシェーダー
+// テクスチャにはα値しか入っていないので、ここで色に展開する。
+Texture2D _texture : register(t0);
+SamplerState _sampler : register(s0);
+
+float4 main(PSIn input) : SV_TARGET
+{
+    float alpha = _texture.Sample(_sampler, input.uv).r;
+    return alpha * input.color;  // 乗算済みアルファ (RGBA(a,a,a,a) と同じ)
+}
\ No newline at end of file
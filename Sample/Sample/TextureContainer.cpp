@@ -0,0 +1,138 @@
+#include "TextureContainer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#include <wrl/client.h>
+
+#include "MappedFile.h"
+#include "PixelConvert.h"
+
+namespace dxstg {
+
+using Microsoft::WRL::ComPtr;
+
+bool ParseTextureContainer(const void* data, size_t size,
+	const TextureContainerHeader*& header, const TextureContainerMip*& mips) noexcept
+{
+	if (data == nullptr || size < sizeof(TextureContainerHeader)) return false;
+
+	const auto bytes = static_cast<const std::uint8_t*>(data);
+	const auto h = reinterpret_cast<const TextureContainerHeader*>(bytes);
+	if (std::memcmp(h->magic, "DXTX", 4) != 0) return false;
+	if (h->version != TextureContainerVersion) return false;
+	if (h->format != DXGI_FORMAT_R8G8B8A8_UNORM) return false;
+	if (h->width == 0 || h->height == 0) return false;
+	if (h->mipLevels == 0 || h->mipLevels > TextureContainerMaxMips) return false;
+	if (size < sizeof(TextureContainerHeader) + sizeof(TextureContainerMip) * h->mipLevels) return false;
+
+	const auto m = reinterpret_cast<const TextureContainerMip*>(bytes + sizeof(TextureContainerHeader));
+	for (std::uint32_t i = 0; i < h->mipLevels; ++i) {
+		const std::uint64_t w = std::max<std::uint32_t>(1, h->width >> i);
+		const std::uint64_t hh = std::max<std::uint32_t>(1, h->height >> i);
+		if (m[i].rowPitch < w * 4) return false;
+		if (m[i].slicePitch < m[i].rowPitch * hh) return false;
+		if (static_cast<std::uint64_t>(m[i].offset) + m[i].slicePitch > size) return false;
+	}
+
+	header = h;
+	mips = m;
+	return true;
+}
+
+HRESULT LoadTextureContainer(ID3D11Device* device, const void* data, size_t size, ID3D11ShaderResourceView** ppShaderResourceView)
+{
+	if (ppShaderResourceView == nullptr) {
+		return S_OK;
+	}
+
+	const TextureContainerHeader* header;
+	const TextureContainerMip* mips;
+	if (!ParseTextureContainer(data, size, header, mips)) {
+		OutputDebugStringW(L"FAILED: ParseTextureContainer\n");
+		return E_FAIL;
+	}
+
+	D3D11_TEXTURE2D_DESC texture2dDesc;
+	texture2dDesc.Width = header->width;
+	texture2dDesc.Height = header->height;
+	texture2dDesc.MipLevels = header->mipLevels;  // ミップマップは変換時に作成済み
+	texture2dDesc.ArraySize = 1;
+	texture2dDesc.Format = static_cast<DXGI_FORMAT>(header->format);
+	texture2dDesc.SampleDesc.Count = 1;
+	texture2dDesc.SampleDesc.Quality = 0;
+	texture2dDesc.Usage = D3D11_USAGE_IMMUTABLE;  // 変更不可
+	texture2dDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	texture2dDesc.CPUAccessFlags = 0;
+	texture2dDesc.MiscFlags = 0;
+
+	// data をそのまま渡す
+	D3D11_SUBRESOURCE_DATA initialData[TextureContainerMaxMips];
+	const auto bytes = static_cast<const std::uint8_t*>(data);
+	for (std::uint32_t i = 0; i < header->mipLevels; ++i) {
+		initialData[i].pSysMem = bytes + mips[i].offset;
+		initialData[i].SysMemPitch = mips[i].rowPitch;
+		initialData[i].SysMemSlicePitch = mips[i].slicePitch;
+	}
+
+	// 乗算済みでなければ、コピーして変換したものを渡す
+	// 入っている2段目以降のミップは普通のアルファのまま縮小してあり、透明な画素の色がにじんでいるので使わない。
+	// 1段目を乗算済みにしてから、それを縮小して作り直す (texconv.py で乗算済みにしたものと同じになる)。
+	std::unique_ptr<std::uint8_t[]> premultiplied;
+	if (!(header->flags & TextureContainerFlagPremultipliedAlpha)) {
+		size_t total = 0;
+		for (std::uint32_t i = 0; i < header->mipLevels; ++i) {
+			total += mips[i].slicePitch;
+		}
+		premultiplied = std::make_unique<std::uint8_t[]>(total);
+
+		std::uint8_t* dst = premultiplied.get();
+		for (std::uint32_t y = 0; y < header->height; ++y) {
+			PremultiplyAlpha(bytes + mips[0].offset + mips[0].rowPitch * y, dst + mips[0].rowPitch * y, header->width);
+		}
+		initialData[0].pSysMem = dst;
+		for (std::uint32_t i = 1; i < header->mipLevels; ++i) {
+			const std::uint8_t* parent = dst;
+			dst += mips[i - 1].slicePitch;
+			DownsampleRgba(parent, std::max<std::uint32_t>(1, header->width >> (i - 1)), std::max<std::uint32_t>(1, header->height >> (i - 1)),
+				mips[i - 1].rowPitch, dst, mips[i].rowPitch);
+			initialData[i].pSysMem = dst;
+		}
+	}
+
+	ComPtr<ID3D11Texture2D> texture2d;
+	HRESULT hr = device->CreateTexture2D(&texture2dDesc, initialData, &texture2d);
+	if (FAILED(hr)) { OutputDebugStringW(L"FAILED: CreateTexture2D\n"); return hr; }
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+	srvDesc.Format = texture2dDesc.Format;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MostDetailedMip = 0;
+	srvDesc.Texture2D.MipLevels = header->mipLevels;
+
+	hr = device->CreateShaderResourceView(texture2d.Get(), &srvDesc, ppShaderResourceView);
+	if (FAILED(hr)) { OutputDebugStringW(L"FAILED: CreateShaderResourceView\n"); return hr; }
+
+	return S_OK;
+}
+
+HRESULT LoadTextureContainer(ID3D11Device* device, LPCWSTR filename, ID3D11ShaderResourceView** ppShaderResourceView)
+{
+	if (ppShaderResourceView == nullptr) {
+		return S_OK;
+	}
+
+	MappedFile file(filename);
+	if (!file) return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+
+	// マップしたページをそのまま渡す
+	HRESULT hr = LoadTextureContainer(device, file.get(), file.size(), ppShaderResourceView);
+	if (FAILED(hr)) return hr;
+
+	OutputDebugStringW(filename);
+	OutputDebugStringW(L" read\n");
+	return S_OK;
+}
+
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <d3d11.h>
+
+namespace dxstg {
+
+// Tools/texconv.py が出力するテクスチャコンテナ (.dxtex) の形式
+// すべてリトルエンディアン。
+// [TextureContainerHeader][TextureContainerMip × mipLevels][各ミップの画素 (16バイト境界)]
+// 画素は D3D11_SUBRESOURCE_DATA にそのまま渡せる並びになっている。
+struct TextureContainerHeader {
+	char magic[4];            // "DXTX"
+	std::uint32_t version;    // TextureContainerVersion
+	std::uint32_t format;     // DXGI_FORMAT (今は DXGI_FORMAT_R8G8B8A8_UNORM のみ)
+	std::uint32_t width;
+	std::uint32_t height;
+	std::uint32_t mipLevels;
+	std::uint32_t flags;      // TextureContainerFlagPremultipliedAlpha など
+	std::uint32_t reserved;
+};
+
+struct TextureContainerMip {
+	std::uint32_t offset;     // ファイルの先頭からのバイト数
+	std::uint32_t rowPitch;
+	std::uint32_t slicePitch;
+	std::uint32_t reserved;
+};
+
+static_assert(sizeof(TextureContainerHeader) == 32, "TextureContainerHeader must be 32 bytes");
+static_assert(sizeof(TextureContainerMip) == 16, "TextureContainerMip must be 16 bytes");
+
+constexpr std::uint32_t TextureContainerVersion = 1;
+constexpr std::uint32_t TextureContainerMaxMips = 16;
+constexpr std::uint32_t TextureContainerFlagPremultipliedAlpha = 1; // 色は乗算済みアルファ
+
+// data を検証して、ヘッダーとミップの表を返す。壊れていたら false
+bool ParseTextureContainer(const void* data, size_t size,
+	const TextureContainerHeader*& header, const TextureContainerMip*& mips) noexcept;
+
+// テクスチャは乗算済みアルファで作成する。
+// 変換時に乗算済みにしたもの (TextureContainerFlagPremultipliedAlpha) はコピーせずにそのまま渡し、
+// そうでない古いものは読み込むときにコピーして変換する (ミップは乗算済みの1段目から作り直す)。
+
+// .dxtex をメモリマップして、デコードもコピーもせずにテクスチャを作成する
+// ファイルがないときは HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) を返す
+HRESULT LoadTextureContainer(ID3D11Device* device, LPCWSTR filename, ID3D11ShaderResourceView** ppShaderResourceView);
+
+// メモリ上の .dxtex (アセットパックの中身など) からテクスチャを作成する
+HRESULT LoadTextureContainer(ID3D11Device* device, const void* data, size_t size, ID3D11ShaderResourceView** ppShaderResourceView);
+
+}
@@ -0,0 +1,65 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace dxstg {
+
+ThreadPool::ThreadPool(unsigned threadCount, std::function<void()> onThreadStart, std::function<void()> onThreadExit) :
+	m_onThreadStart(std::move(onThreadStart)),
+	m_onThreadExit(std::move(onThreadExit)),
+	m_quit(false)
+{
+	if (threadCount == 0) {
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	m_threads.reserve(threadCount);
+	for (unsigned i = 0; i < threadCount; ++i) {
+		m_threads.emplace_back([this] { run(); });
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_cv.notify_all();
+	for (auto& thread : m_threads) {
+		thread.join();
+	}
+}
+
+void ThreadPool::push(std::function<void()>&& job)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push_back(std::move(job));
+	}
+	m_cv.notify_one();
+}
+
+void ThreadPool::run()
+{
+	if (m_onThreadStart) m_onThreadStart();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while (true) {
+		m_cv.wait(lock, [this] { return m_quit || !m_jobs.empty(); });
+		if (m_jobs.empty()) break; // m_quit で、仕事が残っていない
+
+		std::function<void()> job = std::move(m_jobs.front());
+		m_jobs.pop_front();
+		lock.unlock();
+
+		job(); // 例外は packaged_task が future に入れる
+
+		lock.lock();
+	}
+	lock.unlock();
+
+	if (m_onThreadExit) m_onThreadExit();
+}
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace dxstg {
+
+// 決まった数のワーカースレッドで仕事を順に処理する
+// submit() は std::future を返す。仕事の中で投げられた例外は future.get() で再送出される。
+// デストラクタは、残っている仕事をすべて終えてからスレッドを終了する。
+class ThreadPool final {
+public:
+	// threadCount が 0 なら std::thread::hardware_concurrency() 個
+	// onThreadStart, onThreadExit は各ワーカースレッドの最初と最後に呼ばれる (COM の初期化など)
+	explicit ThreadPool(unsigned threadCount = 0,
+		std::function<void()> onThreadStart = nullptr, std::function<void()> onThreadExit = nullptr);
+	ThreadPool(const ThreadPool&) = delete;              // コピー不可
+	ThreadPool& operator = (const ThreadPool&) = delete; // コピー不可
+	~ThreadPool();
+
+	size_t threadCount() const noexcept { return m_threads.size(); }
+
+	template <class F>
+	auto submit(F&& f) -> std::future<typename std::result_of<F()>::type>
+	{
+		using Result = typename std::result_of<F()>::type;
+		// std::function はコピー可能なものしか持てないので shared_ptr で包む
+		auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(f));
+		std::future<Result> future = task->get_future();
+		push([task] { (*task)(); });
+		return future;
+	}
+
+private:
+	std::function<void()> m_onThreadStart;
+	std::function<void()> m_onThreadExit;
+
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::deque<std::function<void()>> m_jobs; // m_mutex で保護
+	bool m_quit;                              // m_mutex で保護
+	std::vector<std::thread> m_threads;
+
+	void push(std::function<void()>&& job);
+	void run();
+};
+
+}
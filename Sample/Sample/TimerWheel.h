@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace dxstg {
+
+// 階層タイマーホイール
+// 何ティック後に T を取り出すかを登録しておき、advance() で期限が来たものだけを取り出す。
+// 登録も取り出しも O(1) (上の段から下の段へ移すときに、1つあたり段の数まで)。
+// 毎ティックすべての登録を数え直さないので、手間は期限が来た数に比例する。
+//
+// 段 k の1スロットは 64^k ティック分。近いものは下の段、遠いものは上の段に入れておき、
+// 下の段が1周するたびに上の段の次のスロットを下の段に移す。
+// 一番上の段でも届かないほど遠いものは、一番上の段に置いておき、移すときに入れ直す。
+template <class T>
+class TimerWheel final {
+public:
+	static constexpr int LevelBits = 6;
+	static constexpr int LevelCount = 4;
+	static constexpr std::uint64_t SlotCount = std::uint64_t(1) << LevelBits;
+
+	// 今のティック (最後に advance したティック)
+	std::uint64_t now() const noexcept { return m_now; }
+
+	// 登録されている数 (期限が来ていないもの)
+	size_t size() const noexcept { return m_size; }
+
+	// delay ティック後に取り出す。0 は 1 として扱う (今のティックはもう取り出し中か済んでいる)
+	void schedule(std::uint64_t delay, T value)
+	{
+		insert({ m_now + (delay != 0 ? delay : 1), std::move(value) });
+		++m_size;
+	}
+
+	// tick まで進めて、期限が来たものを期限の順に fire に渡す。渡した数を返す
+	// fire の中で schedule してよい (期限は次のティック以降になる)。
+	template <class F>
+	size_t advance(std::uint64_t tick, F&& fire)
+	{
+		size_t fired = 0;
+		while (m_now < tick) {
+			++m_now;
+
+			// 下の段が1周したら、上の段の今のスロットを移す (上から順に)
+			int top = 0;
+			while (top + 1 < LevelCount && (m_now & ((std::uint64_t(1) << (LevelBits * (top + 1))) - 1)) == 0) {
+				++top;
+			}
+			for (int level = top; level >= 1; --level) {
+				cascade(level);
+			}
+
+			// 取り出し中に schedule されても困らないように、スロットを入れ替えてから渡す
+			std::vector<Entry>& slot = m_levels[0][slotIndex(0, m_now)];
+			if (slot.empty()) continue;
+			m_firing.swap(slot);
+			m_size -= m_firing.size();
+			for (auto& entry : m_firing) {
+				fire(entry.value);
+			}
+			fired += m_firing.size();
+			m_firing.clear();
+		}
+		return fired;
+	}
+
+	void clear()
+	{
+		for (auto& level : m_levels) {
+			for (auto& slot : level) {
+				slot.clear();
+			}
+		}
+		m_size = 0;
+	}
+
+private:
+	struct Entry {
+		std::uint64_t due;
+		T value;
+	};
+
+	static size_t slotIndex(int level, std::uint64_t tick) noexcept
+	{
+		return static_cast<size_t>((tick >> (LevelBits * level)) & (SlotCount - 1));
+	}
+
+	// 期限までの距離で段を決めて入れる (due >= m_now)
+	void insert(Entry&& entry)
+	{
+		const std::uint64_t delta = entry.due - m_now;
+		for (int level = 0; level < LevelCount; ++level) {
+			if (delta < (std::uint64_t(1) << (LevelBits * (level + 1)))) {
+				m_levels[level][slotIndex(level, entry.due)].push_back(std::move(entry));
+				return;
+			}
+		}
+		// 遠すぎるものは一番上の段の届く限り先に置く (移したときに入れ直す)
+		const int top = LevelCount - 1;
+		const std::uint64_t reach = m_now + (std::uint64_t(1) << (LevelBits * LevelCount)) - 1;
+		m_levels[top][slotIndex(top, reach)].push_back(std::move(entry));
+	}
+
+	// level の今のスロットの中身を入れ直す (下の段に入る)
+	void cascade(int level)
+	{
+		std::vector<Entry>& slot = m_levels[level][slotIndex(level, m_now)];
+		if (slot.empty()) return;
+		m_cascading.swap(slot);
+		for (auto& entry : m_cascading) {
+			insert(std::move(entry));
+		}
+		m_cascading.clear();
+	}
+
+	std::array<std::array<std::vector<Entry>, SlotCount>, LevelCount> m_levels;
+	std::vector<Entry> m_firing;    // 取り出し中のスロット (確保した領域は使い回す)
+	std::vector<Entry> m_cascading; // 移している途中のスロット
+	std::uint64_t m_now = 0;
+	size_t m_size = 0;
+};
+
+}
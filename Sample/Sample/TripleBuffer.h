@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace dxstg {
+
+// 書き込み側スレッド1つと読み込み側スレッド1つの間で、最新の値を受け渡すトリプルバッファ
+// ロックを使わず、どちらも相手を待たない。
+// 書き込み側は back() に書いて publish() する。読み込み側は update() してから front() を読む。
+// 読み込みが追いつかなかった値は捨てられ、読み込み側は常にその時点で最新のものを得る。
+// T は使い回すので、書き込み側で中身を作り直すこと (vector の clear など。確保した領域も使い回せる)。
+template <class T>
+class TripleBuffer final {
+public:
+	TripleBuffer() : m_middle(1), m_back(0), m_front(2) {}
+	TripleBuffer(const TripleBuffer&) = delete;              // コピー不可
+	TripleBuffer& operator = (const TripleBuffer&) = delete; // コピー不可
+
+	// 書き込み側: 次に公開するもの
+	T& back() noexcept { return m_buffers[m_back]; }
+
+	// 書き込み側: back() を最新として公開する。back() は別のバッファになる
+	void publish() noexcept
+	{
+		m_back = m_middle.exchange(static_cast<std::uint8_t>(m_back | DirtyBit), std::memory_order_acq_rel) & IndexMask;
+	}
+
+	// 読み込み側: 新しく公開されたものがあれば front() をそれにして true を返す
+	bool update() noexcept
+	{
+		if (!(m_middle.load(std::memory_order_relaxed) & DirtyBit)) return false;
+		m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & IndexMask;
+		return true;
+	}
+
+	// 読み込み側: 最後に update() で得たもの
+	const T& front() const noexcept { return m_buffers[m_front]; }
+
+private:
+	static constexpr std::uint8_t IndexMask = 3;
+	static constexpr std::uint8_t DirtyBit = 4; // 中間のバッファがまだ読まれていない
+
+	T m_buffers[3];
+	alignas(64) std::atomic<std::uint8_t> m_middle; // 受け渡し中のバッファの番号 | DirtyBit
+	alignas(64) std::uint8_t m_back;                // 書き込み側だけが触る
+	alignas(64) std::uint8_t m_front;               // 読み込み側だけが触る
+};
+
+}
@@ -2,12 +2,17 @@
 
 cbuffer CBuffer : register(b0) {
     matrix viewProj;
+    float2 positionOrigin;  // バッチの原点
+    float positionUnit;     // 頂点の位置の 1 あたりの大きさ
 }
 
 PSIn main(VSIn input)
 {
+    // 下位1ビットがテクスチャの角、残りが原点からの位置
     PSIn output;
-    output.pos = mul(float4(input.pos, 1), viewProj);
-    output.uv = input.uv;
+    float2 pos = (input.pos >> 1) * positionUnit + positionOrigin;
+    output.pos = mul(float4(pos, 0, 1), viewProj);
+    output.uv = float2(input.pos & 1);
+    output.color = input.color;
 	return output;
-}
\ No newline at end of file
+}
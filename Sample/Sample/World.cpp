@@ -0,0 +1,381 @@
+#include "World.h"
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <random>
+
+#include "ThreadPool.h"
+
+namespace dxstg {
+
+namespace {
+
+// 今のスレッドで進めている World
+thread_local World* t_currentWorld = nullptr;
+
+// この間、t_currentWorld を world にする
+class CurrentWorldScope final {
+public:
+	explicit CurrentWorldScope(World* world) noexcept : m_previous(t_currentWorld) { t_currentWorld = world; }
+	~CurrentWorldScope() { t_currentWorld = m_previous; }
+	CurrentWorldScope(const CurrentWorldScope&) = delete;
+	CurrentWorldScope& operator = (const CurrentWorldScope&) = delete;
+
+private:
+	World* m_previous;
+};
+
+constexpr int botHoldTicks = 15; // ボットはこの間、同じキーを押し続ける
+
+double ElapsedMs(std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end)
+{
+	return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+} // end unnamed namespace
+
+World::World(const WorldSettings& settings, ThreadPool* collisionPool)
+	: m_settings(settings)
+	, m_contactFinder(collisionPool)
+	, m_particles(settings.particleCapacity)
+{
+	if (settings.stage != nullptr) {
+		m_stageCursor = StageCursor(*settings.stage);
+	}
+}
+
+// オブジェクトのデストラクタから Game.h の関数を呼んでもよいように
+World::~World()
+{
+	CurrentWorldScope scope(this);
+	m_objects.clear();
+}
+
+World& World::current()
+{
+	// step() などの外 (World がないスレッド) から Game.h の関数を呼んではいけない
+	return *t_currentWorld;
+}
+
+void World::populate()
+{
+	CurrentWorldScope scope(this);
+	setPlayer(addObject(std::make_unique<Player>()));
+
+	// ステージがなければ、決まった敵を1つだけ置く
+	if (m_settings.stage == nullptr) {
+		addObject(std::make_unique<Enemy>(3.f, 0.f));
+	}
+}
+
+void World::step(const TickInput& input)
+{
+	CurrentWorldScope scope(this);
+
+	++m_tick;
+	m_input = input;
+	m_stats = WorldTickStats();
+
+	// エフェクト (このティックで出したものは、次のティックから動く)
+	const auto particleBegin = std::chrono::steady_clock::now();
+	m_particles.update();
+	m_stats.particleUpdateMs = ElapsedMs(particleBegin, std::chrono::steady_clock::now());
+
+	// ステージのスクリプトで、このティックに出る敵を出す (この後の更新にも入る)
+	m_stats.stageSpawnCount = m_stageCursor.advance(m_tick, [this](const StageRecord& record) {
+		addObject(std::make_unique<Enemy>(record.x, record.y, MakeEnemySpec(record)));
+	});
+
+	// 更新
+	// update の中で追加されたもの (弾など) も、このティックで更新する
+	// 追加すると m_objects の要素は動くが、オブジェクトそのものは動かないので obj はそのまま使える
+	const Rectangle& retireRect = m_settings.retireRect;
+	for (size_t i = 0; i < m_objects.size(); ++i) {
+		StgObject* obj = m_objects[i].get();
+		obj->update();
+		if (m_settings.retireOffscreen && obj->isRetiredOffscreen() && !obj->removable
+			&& !obj->getDrawRect().intersects(retireRect)) {
+			obj->removable = true;
+			++m_stats.retiredCount;
+		}
+	}
+	EnemyBullet::update(m_enemyBullets);
+
+	// 期限が来たタイマーを届ける (消えたオブジェクトの分は捨てる)
+	m_stats.firedTimerCount = m_timers.advance(m_tick, [this](const ObjectTimer& timer) {
+		StgObject* obj = findObject(timer.target);
+		if (obj != nullptr && !obj->removable) {
+			obj->onTimer(timer.event);
+		}
+	});
+
+	// 寿命が来た弾と、画面から十分離れた弾を消す
+	const size_t bulletCountBefore = m_enemyBullets.size();
+	m_stats.firedTimerCount += m_enemyBulletExpiry.advance(m_tick, [this](SlotHandle bullet) { m_enemyBullets.erase(bullet); });
+	if (m_settings.retireOffscreen) {
+		const Position* positions = m_enemyBullets.column<Position>().data();
+		m_stats.retiredCount += m_enemyBullets.eraseIf([positions, &retireRect](size_t i) {
+			return !EnemyBullet::rect(positions[i]).intersects(retireRect);
+		});
+	}
+	m_totalRemovedCount += bulletCountBefore - m_enemyBullets.size();
+
+	// 削除可能要素の削除 (残りの順番は変わらない)
+	m_totalRemovedCount += m_objects.eraseIf([](const auto& obj) { return obj->removable; });
+
+	// 衝突判定の実施
+	// 重なりを調べるところ (オブジェクトには触らない) はワーカースレッドに分け、
+	// 見つかった組を (first, second) の順に1つずつ hit() に渡す。順番はスレッドの数によらない。
+	// 弾は StgObject とだけ調べる (弾どうしや、弾の側の反応はない)。弾の矩形は Position の列から作る。
+	const auto collisionBegin = std::chrono::steady_clock::now();
+	m_hitRects.clear();
+	for (const auto& obj : m_objects) {
+		m_hitRects.push_back(obj->getHitRect());
+	}
+	const std::vector<Contact>& contacts = m_contactFinder.find(m_hitRects.data(), m_hitRects.size());
+	size_t collisionThreads = m_contactFinder.lastThreadCount();
+	const std::vector<CrossContact>& bulletContacts = m_contactFinder.findCross(m_hitRects.data(), m_hitRects.size(),
+		m_enemyBullets.column<Position>().data(), m_enemyBullets.handles(), m_enemyBullets.size(),
+		EnemyBullet::halfWidth, EnemyBullet::halfHeight);
+	collisionThreads = std::max(collisionThreads, m_contactFinder.lastThreadCount());
+	const auto detectEnd = std::chrono::steady_clock::now();
+	// 消すのは後の eraseIf で、hit() の中で追加しても後ろに付くだけなので、番号はこの間変わらない
+	for (const auto& contact : contacts) {
+		StgObject& obj1 = *m_objects[contact.first];
+		StgObject& obj2 = *m_objects[contact.second];
+		obj1.hit(obj2.getType());
+		obj2.hit(obj1.getType());
+	}
+	// 弾はここでは消さないので、bulletContacts のハンドルはこの間ずっと有効
+	for (const auto& contact : bulletContacts) {
+		m_objects[contact.object]->hit(EnemyBullet::type);
+	}
+	m_stats.contactCount = contacts.size() + bulletContacts.size();
+	const auto collisionEnd = std::chrono::steady_clock::now();
+	m_stats.detectMs = ElapsedMs(collisionBegin, detectEnd);
+	m_stats.resolveMs = ElapsedMs(detectEnd, collisionEnd);
+	m_stats.collisionThreads = collisionThreads;
+
+	// 削除可能要素の削除
+	m_totalRemovedCount += m_objects.eraseIf([](const auto& obj) { return obj->removable; });
+
+	m_totalRetiredCount += m_stats.retiredCount;
+}
+
+void World::collectSprites(RenderList& list, const Rectangle& visibleRect) const
+{
+	list.tick = m_tick;
+	list.totalRetiredCount = m_totalRetiredCount;
+	list.objectCount = objectCount();
+	list.culledCount = 0;
+	for (const auto& obj : m_objects) {
+		const auto& rect = obj->getDrawRect();
+		if (!rect.intersects(visibleRect)) {
+			++list.culledCount;
+			continue;
+		}
+
+		RenderSprite sprite;
+		sprite.x0 = rect.maxX; sprite.y0 = rect.maxY;
+		sprite.x1 = rect.minX; sprite.y1 = rect.minY;
+		sprite.u0 = obj->isMirrorX() ? 0.f : 1.f; sprite.v0 = obj->isMirrorY() ? 1.f : 0.f;
+		sprite.u1 = obj->isMirrorX() ? 1.f : 0.f; sprite.v1 = obj->isMirrorY() ? 0.f : 1.f;
+		sprite.color = obj->getColor();
+		sprite.texture = obj->getTextureID();
+		sprite.layer = obj->getLayer();
+		list.sprites.push_back(sprite);
+	}
+	for (const Position& position : m_enemyBullets.column<Position>()) {
+		const auto rect = EnemyBullet::rect(position);
+		if (!rect.intersects(visibleRect)) {
+			++list.culledCount;
+			continue;
+		}
+
+		RenderSprite sprite;
+		sprite.x0 = rect.maxX; sprite.y0 = rect.maxY;
+		sprite.x1 = rect.minX; sprite.y1 = rect.minY;
+		sprite.u0 = 1.f; sprite.v0 = 0.f;
+		sprite.u1 = 0.f; sprite.v1 = 1.f;
+		sprite.color = Color();
+		sprite.texture = EnemyBullet::textureID;
+		sprite.layer = EnemyBullet::layer;
+		list.sprites.push_back(sprite);
+	}
+
+	// エフェクト (弾の画像を色と α を変えて描く)
+	const float* xs = m_particles.x();
+	const float* ys = m_particles.y();
+	const float* alphas = m_particles.alpha();
+	const float* halfSizes = m_particles.halfSize();
+	const std::uint32_t* rgbs = m_particles.rgb();
+	for (size_t i = 0; i < m_particles.size(); ++i) {
+		const Rectangle rect = { xs[i] - halfSizes[i], ys[i] - halfSizes[i], xs[i] + halfSizes[i], ys[i] + halfSizes[i] };
+		if (!rect.intersects(visibleRect)) {
+			continue;
+		}
+
+		RenderSprite sprite;
+		sprite.x0 = rect.maxX; sprite.y0 = rect.maxY;
+		sprite.x1 = rect.minX; sprite.y1 = rect.minY;
+		sprite.u0 = 1.f; sprite.v0 = 0.f;
+		sprite.u1 = 0.f; sprite.v1 = 1.f;
+		sprite.color = Color((rgbs[i] & 0xff) / 255.f, ((rgbs[i] >> 8) & 0xff) / 255.f, ((rgbs[i] >> 16) & 0xff) / 255.f, alphas[i]);
+		sprite.texture = StgObject::TextureID::BULLET;
+		sprite.layer = StgObject::Layer::EFFECT;
+		list.sprites.push_back(sprite);
+	}
+}
+
+ObjectHandle World::addObject(std::unique_ptr<StgObject>&& newObject)
+{
+	StgObject* obj = newObject.get();
+	const ObjectHandle handle = m_objects.insert(std::move(newObject));
+	obj->attach(handle);
+	++m_totalSpawnedCount;
+	return handle;
+}
+
+void World::spawnEnemyBullet(Position position, Velocity velocity)
+{
+	const SlotHandle bullet = m_enemyBullets.insert(position, velocity);
+	m_enemyBulletExpiry.schedule(EnemyBullet::lifetime, bullet);
+	++m_totalSpawnedCount;
+}
+
+size_t World::objectCount(StgObject::Type type) const noexcept
+{
+	size_t count = 0;
+	for (const auto& obj : m_objects) {
+		if (obj->getType() == type) ++count;
+	}
+	return count;
+}
+
+void World::scheduleTimer(ObjectHandle target, std::uint32_t delayTicks, TimerEvent event)
+{
+	m_timers.schedule(delayTicks, { target, event });
+}
+
+StgObject* World::findObject(ObjectHandle handle)
+{
+	const auto obj = m_objects.get(handle);
+	return obj ? obj->get() : nullptr;
+}
+
+WorldController MakeRandomBot(std::uint32_t seed)
+{
+	std::mt19937 random(seed);
+	Input held = {};
+	int remaining = 0;
+	return [random, held, remaining](const World&) mutable {
+		if (--remaining <= 0) {
+			const std::uint32_t bits = random();
+			held.left = (bits & 1) != 0;
+			held.right = (bits & 2) != 0;
+			held.up = (bits & 4) != 0;
+			held.down = (bits & 8) != 0;
+			remaining = botHoldTicks;
+		}
+		return held;
+	};
+}
+
+WorldBatchResult RunWorldBatch(ThreadPool& pool, std::vector<std::unique_ptr<World>>& worlds,
+	std::vector<WorldController>& controllers, std::uint64_t ticks)
+{
+	const auto begin = std::chrono::steady_clock::now();
+
+	std::vector<std::future<void>> futures;
+	futures.reserve(worlds.size());
+	std::vector<LatencyHistogram> latencies(worlds.size());
+	for (size_t i = 0; i < worlds.size(); ++i) {
+		World& world = *worlds[i];
+		WorldController& controller = controllers[i];
+		LatencyHistogram& latency = latencies[i];
+		futures.push_back(pool.submit([&world, &controller, &latency, ticks] {
+			// 前の呼び出しの最後のティックで押していたキーから続ける
+			InputEventQueue queue;
+			InputTracker tracker;
+			tracker.resync(world.input().down);
+			for (std::uint64_t t = 0; t < ticks; ++t) {
+				const Input held = controller(world);
+				PushInputChanges(queue, tracker.held(), held, InputClockNow());
+				tracker.beginTick(queue, InputClockNow());
+				world.step({ tracker.down(), tracker.pressed(), tracker.released() });
+			}
+			latency = tracker.latency();
+		}));
+	}
+	for (auto& future : futures) {
+		future.get();
+	}
+
+	WorldBatchResult result;
+	for (const auto& latency : latencies) {
+		result.inputLatency.merge(latency);
+	}
+	result.worldCount = worlds.size();
+	result.worldTicks = ticks * worlds.size();
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	for (const auto& world : worlds) {
+		if (world->isPlayerAlive()) ++result.survivorCount;
+	}
+	return result;
+}
+
+// Game.h の関数は、今のスレッドの World に対して働く
+
+ObjectHandle AddObject(std::unique_ptr<StgObject>&& newObject)
+{
+	return World::current().addObject(std::move(newObject));
+}
+
+void SpawnEnemyBullet(Position position, Velocity velocity)
+{
+	World::current().spawnEnemyBullet(position, velocity);
+}
+
+void ScheduleTimer(ObjectHandle target, std::uint32_t delayTicks, TimerEvent event)
+{
+	World::current().scheduleTimer(target, delayTicks, event);
+}
+
+StgObject* FindObject(ObjectHandle handle)
+{
+	return World::current().findObject(handle);
+}
+
+Player* GetPlayer()
+{
+	// SetPlayer には Player のハンドルしか渡さない
+	return static_cast<Player*>(World::current().findObject(World::current().player()));
+}
+
+void EmitParticles(const ParticleBurst& burst)
+{
+	World::current().emitParticles(burst);
+}
+
+void SetPlayer(ObjectHandle player)
+{
+	World::current().setPlayer(player);
+}
+
+Input GetInput()
+{
+	return World::current().input().down;
+}
+
+Input GetPressedInput()
+{
+	return World::current().input().pressed;
+}
+
+Input GetReleasedInput()
+{
+	return World::current().input().released;
+}
+
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "Collision.h"
+#include "Game.h"
+#include "InputEvents.h"
+#include "Particles.h"
+#include "RenderList.h"
+#include "SlotMap.h"
+#include "Stage.h"
+#include "StgObject.h"
+#include "TimerWheel.h"
+
+namespace dxstg {
+
+class ThreadPool;
+
+// 1ティック分の入力
+struct TickInput {
+	Input down;     // 押されていたキー (ティックの途中で押して離したものも含む)
+	Input pressed;  // 押されたキー
+	Input released; // 離されたキー
+};
+
+struct WorldSettings {
+	Rectangle retireRect;        // 弾などはこれから出たら消す
+	bool retireOffscreen = true; // false なら画面外でも消さない
+	size_t particleCapacity = 0; // エフェクトのパーティクルの数の上限 (0 ならエフェクトを出さない)
+	const StageTimeline* stage = nullptr; // 敵を出すスクリプト (World より長く生きること)。nullptr なら決まった敵を1つだけ置く
+};
+
+// 1ティックの統計
+struct WorldTickStats {
+	size_t retiredCount = 0;    // 画面外に出て消した数
+	size_t contactCount = 0;    // 当たった組の数
+	size_t firedTimerCount = 0; // 届けたタイマーの数
+	size_t stageSpawnCount = 0; // ステージのスクリプトで出した数
+	double detectMs = 0;        // 衝突判定 (重なりを調べる)
+	double resolveMs = 0;       // 衝突判定 (hit を呼ぶ)
+	size_t collisionThreads = 0;
+	double particleUpdateMs = 0;
+};
+
+// ゲームの状態をすべて持つもの
+// Game.h の関数 (AddObject, GetPlayer, GetInput など) は、今のスレッドで step() などを呼んでいる World に対して働く。
+// 別々の World は、別々のスレッドで同時に進めてよい (1つの World を複数のスレッドから触ってはいけない)。
+class World final {
+public:
+	using ObjectMap = SlotMap<std::unique_ptr<StgObject>>;
+
+	// collisionPool は衝突判定を分けるワーカー (nullptr なら step を呼んだスレッドだけで調べる)
+	explicit World(const WorldSettings& settings, ThreadPool* collisionPool = nullptr);
+	~World();
+	World(const World&) = delete;              // コピー不可
+	World& operator = (const World&) = delete; // コピー不可
+
+	// 最初のオブジェクト (自機と敵) を置く
+	void populate();
+
+	// 1ティック進める
+	void step(const TickInput& input);
+
+	// 描画内容を list に書く (visibleRect に入らないものは入れない)
+	void collectSprites(RenderList& list, const Rectangle& visibleRect) const;
+
+	std::uint64_t tick() const noexcept { return m_tick; }
+	size_t objectCount() const noexcept { return m_objects.size() + m_enemyBullets.size(); }
+	size_t enemyBulletCount() const noexcept { return m_enemyBullets.size(); }
+	size_t pendingTimerCount() const noexcept { return m_timers.size() + m_enemyBulletExpiry.size(); }
+	size_t totalRetiredCount() const noexcept { return m_totalRetiredCount; }
+	std::uint64_t totalSpawnedCount() const noexcept { return m_totalSpawnedCount; } // 追加したオブジェクトと弾の数の合計
+	std::uint64_t totalRemovedCount() const noexcept { return m_totalRemovedCount; } // 消したオブジェクトと弾の数の合計
+	size_t objectCount(StgObject::Type type) const noexcept; // 弾 (enemyBulletCount) は入らない
+	bool isPlayerAlive() const noexcept { return m_objects.contains(m_player); }
+	const WorldTickStats& lastStats() const noexcept { return m_stats; }
+	const ParticleSystem& particles() const noexcept { return m_particles; }
+	const StageCursor& stageCursor() const noexcept { return m_stageCursor; }
+	bool isStageFinished() const noexcept { return m_settings.stage != nullptr && m_stageCursor.finished(); }
+
+	// Game.h の関数の中身
+	static World& current();
+	ObjectHandle addObject(std::unique_ptr<StgObject>&& newObject);
+	void spawnEnemyBullet(Position position, Velocity velocity);
+	void scheduleTimer(ObjectHandle target, std::uint32_t delayTicks, TimerEvent event);
+	void emitParticles(const ParticleBurst& burst) { m_particles.emit(burst); }
+	StgObject* findObject(ObjectHandle handle);
+	ObjectHandle player() const noexcept { return m_player; }
+	void setPlayer(ObjectHandle player) noexcept { m_player = player; }
+	const TickInput& input() const noexcept { return m_input; }
+
+private:
+	// オブジェクトに届けるタイマー
+	struct ObjectTimer {
+		ObjectHandle target;
+		TimerEvent event;
+	};
+
+	WorldSettings m_settings;
+	std::uint64_t m_tick = 0;
+	TickInput m_input = {};
+	ObjectMap m_objects;
+	ObjectHandle m_player;
+	TimerWheel<ObjectTimer> m_timers;
+	EnemyBullet::Storage m_enemyBullets;
+	TimerWheel<SlotHandle> m_enemyBulletExpiry; // 弾の寿命
+	ContactFinder m_contactFinder;
+	std::vector<Rectangle> m_hitRects; // 衝突判定に渡す当たり判定 (m_objects と同じ順)
+	ParticleSystem m_particles;
+	StageCursor m_stageCursor;
+	WorldTickStats m_stats;
+	size_t m_totalRetiredCount = 0;
+	std::uint64_t m_totalSpawnedCount = 0;
+	std::uint64_t m_totalRemovedCount = 0;
+};
+
+// World の様子を見て、押しているキーを決めるもの (ボットや決まった入力)
+using WorldController = std::function<Input(const World& world)>;
+
+// seed で決まる乱数で、ときどき押すキーを変えるボット
+WorldController MakeRandomBot(std::uint32_t seed);
+
+struct WorldBatchResult {
+	size_t worldCount = 0;
+	std::uint64_t worldTicks = 0; // 進めたティックの合計
+	double seconds = 0;
+	size_t survivorCount = 0;     // 最後まで自機が残った World の数
+	LatencyHistogram inputLatency; // ボットの入力がキューを通ってティックに届くまでの遅延 (すべての World の合計)
+
+	double worldTicksPerSecond() const noexcept { return seconds > 0 ? worldTicks / seconds : 0.0; }
+};
+
+// worlds[i] を controllers[i] の入力で ticks ティックずつ進める
+// World ごとに pool の仕事を1つ作る (World の中は1つのスレッドで進める)。
+// 入力はウィンドウのときと同じく、イベントにしてキューと InputTracker を通す。
+WorldBatchResult RunWorldBatch(ThreadPool& pool, std::vector<std::unique_ptr<World>>& worlds,
+	std::vector<WorldController>& controllers, std::uint64_t ticks);
+
+}
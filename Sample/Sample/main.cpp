@@ -1,157 +1,155 @@
-// WCu
+// 標準ライブラリ
 #include <iostream>
 #include <chrono>
+#include <cmath>
 #include <sstream>
 #include <memory>
-#include <list>
 #include <algorithm>
-#include <fstream>
-
-// WindowsnCu
+#include <atomic>
+#include <future>
+#include <iomanip>
+#include <string>
+#include <thread>
+#include <random>
+#include <vector>
+#include <cwchar>
+#include <cwctype>
+
+// Windows系ライブラリ
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 #include <tchar.h>
 #include <wrl/client.h>
 #include <wincodec.h>
 #include <d3d11.h>
-#include <DirectXMath.h>  // s̉ZȂ
+#include <DirectXMath.h>  // 行列の演算など
 
-// wb_[
+// 自作ヘッダー
 #include "Common.h"
 #include "FontTextureMap.h"
 #include "Game.h"
 #include "StgObject.h"
-
-// Cut@C̃N
+#include "TextureContainer.h"
+#include "PixelConvert.h"
+#include "AssetPack.h"
+#include "Stage.h"
+#include "ThreadPool.h"
+#include "StateCache.h"
+#include "RenderQueue.h"
+#include "SpriteEncoding.h"
+#include "RenderList.h"
+#include "TripleBuffer.h"
+#include "InputEvents.h"
+#include "World.h"
+#include "FrameArena.h"
+#include "Metrics.h"
+
+// ライブラリファイルのリンク
 #pragma comment(lib, "d3d11.lib")
 
 using Microsoft::WRL::ComPtr;
 
 namespace {
 
-class BinFile {
-public:
-	BinFile(const wchar_t* fpath)
-	{
-		std::ifstream binfile(fpath, std::ios::in|std::ios::binary);
-
-		if (binfile.is_open()) {
-			m_size = static_cast<int>(binfile.seekg(0, std::ios::end).tellg());
-			binfile.seekg(0, std::ios::beg);
-			m_data = std::make_unique<char[]>(m_size);
-			binfile.read(m_data.get(), m_size);
-			m_ok = true;
-		}
-	}
-
-	explicit operator bool() const noexcept { return m_ok; }
-	const void* get() const noexcept { return m_data.get(); }
-	size_t size() const noexcept { return m_size; }
-
-private:
-	bool m_ok = false;
-	size_t m_size = 0;
-	std::unique_ptr<char[]> m_data;
+// 頂点シェーダーの定数バッファ (VertexShader.hlsl, InstancedVertexShader.hlsl と合わせること)
+struct VSConstants {
+	DirectX::XMFLOAT4X4 viewProj;    // 転置済み
+	dxstg::SpriteEncoding encoding; // 位置の詰め方 (バッチの原点と1あたりの大きさ)
+	float padding;
 };
+static_assert(sizeof(VSConstants) % 16 == 0, "constant buffer size must be a multiple of 16");
 
-struct Vertex {
-	float x, y, z;
-	float u, v;
+// デコードした画像 (乗算済みアルファの RGBA)
+struct DecodedImage {
+	UINT width = 0;
+	UINT height = 0;
+	std::unique_ptr<BYTE[]> pixels;  // ピクセルの色値
 };
 
-// eNX`̓ǂݍ݂̎p
-HRESULT GetWICFactory(IWICImagingFactory** factory)
+// 画像 (PNG など) をデコードする
+// wicFactory は呼び出したスレッドで作ったものを渡す
+HRESULT DecodeImage(IWICImagingFactory* wicFactory, LPCWSTR filename, DecodedImage& image)
 {
-	static ComPtr<IWICImagingFactory> m_pWICFactory;
-	HRESULT hr = S_OK;
+	HRESULT hr;
+	const auto targetFormat = GUID_WICPixelFormat32bppRGBA;
 
-	if (nullptr == m_pWICFactory) {
-		hr = CoCreateInstance(
-			CLSID_WICImagingFactory, nullptr,
-			CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&m_pWICFactory));
+	// PNG画像をバイト列として読み込む
+	ComPtr<IWICBitmapDecoder> decoder;
+	ComPtr<IWICBitmapFrameDecode> bitmapSource;
+	ComPtr<IWICFormatConverter> converter;
+
+	hr = wicFactory->CreateDecoderFromFilename(
+		filename,
+		nullptr, GENERIC_READ, WICDecodeMetadataCacheOnLoad, &decoder);
+	if (FAILED(hr)) { OutputDebugString(_T("FAILED: CreateDecoderFromFilename\n")); return hr; }
+
+	hr = decoder->GetFrame(0, &bitmapSource);
+	if (FAILED(hr)) { OutputDebugString(_T("FAILED: GetFrame\n")); return hr; }
+
+	UINT w, h;  // 画像のサイズ
+	hr = bitmapSource->GetSize(&w, &h);
+	if (FAILED(hr)) { OutputDebugString(_T("FAILED: GetSize\n")); return hr; }
+	auto buf = std::make_unique<BYTE[]>(w * h * 4);
+
+	WICPixelFormatGUID pixelFormat;
+	hr = bitmapSource->GetPixelFormat(&pixelFormat);
+	if (FAILED(hr)) { OutputDebugString(_T("FAILED: GetPixelFormat\n")); return hr; }
+
+	// フォーマットを直す
+	if (pixelFormat == targetFormat) {
+		bitmapSource->CopyPixels(nullptr, w * 4, w * h * 4, buf.get());
+	} else {
+		hr = wicFactory->CreateFormatConverter(&converter);
+		if (FAILED(hr)) { OutputDebugString(_T("FAILED: CreateFormatConverter\n")); return hr; }
+
+		// GUID_WICPixelFormat32bppRGBA  --- 普通のアルファ
+		// GUID_WICPixelFormat32bppPRGBA --- 乗算済みアルファ
+		hr = converter->Initialize(
+			bitmapSource.Get(), targetFormat,
+			WICBitmapDitherTypeErrorDiffusion, nullptr, 0.f,
+			WICBitmapPaletteTypeMedianCut);
+		if (FAILED(hr)) { OutputDebugString(_T("FAILED: Initialize\n")); return hr; }
+		converter->CopyPixels(nullptr, w * 4, w * h * 4, buf.get());
 	}
 
-	if (SUCCEEDED(hr)) {
-		*factory = m_pWICFactory.Get();
-		(*factory)->AddRef();
-	}
+	// 乗算済みアルファにする
+	// (WIC の GUID_WICPixelFormat32bppPRGBA でもできるが、.dxtex と同じ丸め方にそろえる)
+	dxstg::PremultiplyAlpha(buf.get(), static_cast<size_t>(w) * h);
 
-	return hr;
+	image.width = w;
+	image.height = h;
+	image.pixels = std::move(buf);
+	return S_OK;
 }
 
-// eNX`̓ǂݍ
-HRESULT LoadTexture(ID3D11Device* device, LPCWSTR filename, ID3D11ShaderResourceView** ppShaderResourceView)
+// デコードした画像からテクスチャを作成
+HRESULT CreateTextureFromImage(ID3D11Device* device, const DecodedImage& image, ID3D11ShaderResourceView** ppShaderResourceView)
 {
 	if (ppShaderResourceView == nullptr) {
 		return S_OK;
 	}
 
 	HRESULT hr;
-	UINT w, h;  // 摜̃TCY
-	std::unique_ptr<BYTE[]> buf;  // sNZ̐Fl
-	const auto targetFormat = GUID_WICPixelFormat32bppRGBA;
-
-	{
-		// PNG摜oCgƂēǂݍ
-		ComPtr<IWICBitmapDecoder> decoder;
-		ComPtr<IWICBitmapFrameDecode> bitmapSource;
-		ComPtr<IWICFormatConverter> converter;
-		ComPtr<IWICImagingFactory> wicFactory;
-
-		hr = GetWICFactory(&wicFactory);
-		if (FAILED(hr)) { OutputDebugString(_T("FAILED: GetWICFactory\n")); return hr; }
-
-		hr = wicFactory->CreateDecoderFromFilename(
-			filename,
-			nullptr, GENERIC_READ, WICDecodeMetadataCacheOnLoad, &decoder);
-		if (FAILED(hr)) { OutputDebugString(_T("FAILED: CreateDecoderFromFilename\n")); return hr; }
-
-		hr = decoder->GetFrame(0, &bitmapSource);
-		if (FAILED(hr)) { OutputDebugString(_T("FAILED: GetFrame\n")); return hr; }
-
-		hr = bitmapSource->GetSize(&w, &h);
-		if (FAILED(hr)) { OutputDebugString(_T("FAILED: GetSize\n")); return hr; }
-    	buf = std::make_unique<BYTE[]>(w * h * 4);
-
-		WICPixelFormatGUID pixelFormat;
-        hr = bitmapSource->GetPixelFormat(&pixelFormat);
-		if (FAILED(hr)) { OutputDebugString(_T("FAILED: GetPixelFormat\n")); return hr; }
-
-		// tH[}bg𒼂
-		if (pixelFormat == targetFormat) {
-			bitmapSource->CopyPixels(nullptr, w * 4, w * h * 4, buf.get());
-		} else {
-			hr = wicFactory->CreateFormatConverter(&converter);
-			if (FAILED(hr)) { OutputDebugString(_T("FAILED: CreateFormatConverter\n")); return hr; }
-
-			// GUID_WICPixelFormat32bppRGBA  --- ʂ̃At@
-			// GUID_WICPixelFormat32bppPRGBA --- Zς݃At@
-			hr = converter->Initialize(
-				bitmapSource.Get(), targetFormat,
-				WICBitmapDitherTypeErrorDiffusion, nullptr, 0.f,
-				WICBitmapPaletteTypeMedianCut);
-			if (FAILED(hr)) { OutputDebugString(_T("FAILED: Initialize\n")); return hr; }
-			converter->CopyPixels(nullptr, w * 4, w * h * 4, buf.get());
-		}
-	}
+	const UINT w = image.width;
+	const UINT h = image.height;
 
 	D3D11_TEXTURE2D_DESC texture2dDesc;
 	texture2dDesc.Width = w;
 	texture2dDesc.Height = h;
-	texture2dDesc.MipLevels = 1;  // ~j}bv쐬ȂBŃ~j}bv̂̓n[hEFAIɑΉĂȂꍇAG[ɂȂ邽߁B
+	texture2dDesc.MipLevels = 1;  // ミニマップを作成しない。ここでミニマップをつくるのはハードウェア的に対応していない場合が多く、エラーになるため。
 	texture2dDesc.ArraySize = 1;
 	texture2dDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
 	texture2dDesc.SampleDesc.Count = 1;
 	texture2dDesc.SampleDesc.Quality = 0;
-	texture2dDesc.Usage = D3D11_USAGE_IMMUTABLE;  // ύXs
+	texture2dDesc.Usage = D3D11_USAGE_IMMUTABLE;  // 変更不可
 	texture2dDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
 	texture2dDesc.CPUAccessFlags = 0;
 	texture2dDesc.MiscFlags = 0;
 
 	D3D11_SUBRESOURCE_DATA initialData;
-	initialData.pSysMem = buf.get();
+	initialData.pSysMem = image.pixels.get();
 	initialData.SysMemPitch = w * 4;
-	initialData.SysMemSlicePitch = w * h * 4;  // ͈Ӗ͂Ȃ
+	initialData.SysMemSlicePitch = w * h * 4;  // これは意味はない
 
 	ComPtr<ID3D11Texture2D> texture2d;
 	hr = device->CreateTexture2D(&texture2dDesc, &initialData, &texture2d);
@@ -166,51 +164,197 @@ HRESULT LoadTexture(ID3D11Device* device, LPCWSTR filename, ID3D11ShaderResource
 	hr = device->CreateShaderResourceView(texture2d.Get(), &srvDesc, ppShaderResourceView);
 	if (FAILED(hr)) { OutputDebugString(_T("FAILED: CreateShaderResourceView\n")); return hr; }
 	
-	OutputDebugStringW(filename);
-	OutputDebugStringW(L" read\n");
 	return S_OK;
 }
 
-// V[eBO֘A
-dxstg::Input _input;
-std::list<std::unique_ptr<dxstg::StgObject>> _objects;
-dxstg::Player* _player = nullptr;
+using StartupClock = std::chrono::steady_clock;
+
+double ElapsedMs(StartupClock::time_point begin)
+{
+	return std::chrono::duration<double, std::milli>(StartupClock::now() - begin).count();
+}
+
+// アセットパック (data/assets.pak)。なければ data/ 以下のファイルを直接読む
+// パックは Tools/pack.py で作成する。
+dxstg::AssetPack assetPack;
+
+std::wstring AssetPath(const std::string& name)
+{
+	return L"data/" + std::wstring(name.begin(), name.end()); // 名前は ASCII のみ
+}
+
+// ワーカースレッドで読み込んだアセット (デバイスのオブジェクトを作る前の段階)
+struct LoadedAsset {
+	std::string name;
+	dxstg::AssetView data;   // .cso や .dxtex の中身
+	DecodedImage image;      // .dxtex がなく PNG をデコードしたとき
+	HRESULT hr = S_OK;
+	double loadMs = 0;       // 読み込み・デコードにかかった時間
+};
+
+// アセットを名前 (例: "VertexShader.cso") で読み込む。パックにあればパックから、なければ data/ から
+// ワーカースレッドから呼んでよい。
+LoadedAsset ReadAsset(const std::string& name)
+{
+	const auto begin = StartupClock::now();
+	LoadedAsset asset;
+	asset.name = name;
+	asset.data = assetPack.find(name.c_str());
+	if (!asset.data) {
+		asset.data = dxstg::ReadAssetFile(AssetPath(name).c_str());
+	}
+
+	if (!asset.data) {
+		asset.hr = HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+	} else if (asset.data.isZeroCopy()) {
+		dxstg::TouchPages(asset.data.get(), asset.data.size()); // ディスクからの読み込みもここで済ませる
+	}
+	asset.loadMs = ElapsedMs(begin);
+	return asset;
+}
+
+// ステージ (stage1.stage)。なければ決まった敵を1つだけ置く
+// Tools/stage.py でテキストから作る。
+const char* const stageAssetName = "stage1.stage";
+dxstg::StageTimeline stageTimeline;
+
+// ステージを開く。パックにあればパックから、なければ data/ から
+// ReadAsset と違ってページを先読みしない (レコードはそのティックが来たときに読む)。
+void OpenStage()
+{
+	dxstg::AssetView data = assetPack.find(stageAssetName);
+	if (!data) {
+		data = dxstg::ReadAssetFile(AssetPath(stageAssetName).c_str());
+	}
+	stageTimeline = dxstg::StageTimeline(std::move(data));
+	if (stageTimeline) {
+		std::wostringstream buf;
+		buf << L"stage: " << stageTimeline.size() << L" records, " << stageTimeline.lastTick() << L" ticks\n";
+		OutputDebugStringW(buf.str().c_str());
+	}
+}
+
+// 変換済みのテクスチャ (name.dxtex) があればそれを、なければ PNG (data/name.png) をデコードする
+// .dxtex は Tools/texconv.py で作成する。デコードが要らないので起動が速い。
+// ワーカースレッドから呼んでよい (COM を初期化しておくこと)。
+LoadedAsset ReadTextureAsset(const std::string& name)
+{
+	const auto begin = StartupClock::now();
+	LoadedAsset asset = ReadAsset(name + ".dxtex");
+	if (!asset.data) {
+		asset.name = name + ".png";
+		ComPtr<IWICImagingFactory> wicFactory;  // このスレッド用
+		asset.hr = CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&wicFactory));
+		if (SUCCEEDED(asset.hr)) {
+			asset.hr = DecodeImage(wicFactory.Get(), AssetPath(asset.name).c_str(), asset.image);
+		}
+	}
+	asset.loadMs = ElapsedMs(begin);
+	return asset;
+}
+
+// 読み込んだテクスチャから ShaderResourceView を作成
+HRESULT CreateTextureAsset(ID3D11Device* device, const LoadedAsset& asset, ID3D11ShaderResourceView** ppShaderResourceView)
+{
+	if (FAILED(asset.hr)) return asset.hr;
+	if (asset.data) {
+		return dxstg::LoadTextureContainer(device, asset.data.get(), asset.data.size(), ppShaderResourceView);
+	}
+	return CreateTextureFromImage(device, asset.image, ppShaderResourceView);
+}
+
+// 起動時間の記録
+struct StartupRecord {
+	std::string name;
+	double loadMs;    // ワーカースレッドでの読み込み・デコード
+	double createMs;  // メインスレッドでのオブジェクトの作成
+};
+
+void ReportStartup(const std::vector<StartupRecord>& records, double totalMs, size_t threadCount)
+{
+	double loadTotal = 0;
+	std::wostringstream buf;
+	buf << std::fixed << std::setprecision(2);
+	buf << L"startup:  load(ms) create(ms)  name" << std::endl;
+	for (const auto& record : records) {
+		buf << L"startup: " << std::setw(9) << record.loadMs << L" " << std::setw(10) << record.createMs
+			<< L"  " << std::wstring(record.name.begin(), record.name.end()) << std::endl;
+		loadTotal += record.loadMs;
+	}
+	buf << L"startup: Init " << totalMs << L" ms (load " << loadTotal << L" ms in total on "
+		<< threadCount << L" threads)" << std::endl;
+	OutputDebugStringW(buf.str().c_str());
+}
+
+// シューティング関連
+// スプライトの描画方法 (F2 で切り替える)
+enum class SpritePath {
+	VERTEX,    // 1枚ごとに4頂点を書き込んで DrawIndexed
+	INSTANCED  // 1枚ごとに SpriteInstance を1つ書き込んで DrawInstanced
+};
+SpritePath spritePath = SpritePath::INSTANCED;  // メインスレッドだけが触る
+
+// F3 で、パーティクルを particleStressCount 個くらいに保つ (負荷試験)
+constexpr size_t particleStressCount = 200000;
+std::atomic<bool> particleStress{ false };
+
+// ゲームの状態 (World) はシミュレーションスレッドが持つ
+// キー入力は WndProc (メインスレッド) がイベントにしてキューに入れ、シミュレーションスレッドがティックの最初に取り出す
+dxstg::InputEventQueue _inputEvents;
+std::atomic<std::uint32_t> _droppedInputEvents{ 0 }; // キューがいっぱいで捨てたイベントの数
+std::atomic<dxstg::KeyMask> _heldKeys{ 0 };          // WndProc から見て押しているキー (捨てたイベントがあったときに合わせる)
+dxstg::InputTracker _inputTracker; // シミュレーションスレッドだけが触る
 
 LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 {
 	switch (message) {
 		case WM_KEYDOWN:
-			switch (wParam) {
-				case VK_LEFT:
-					_input.left = true;
-					break;
-				case VK_RIGHT:
-					_input.right = true;
-					break;
-				case VK_UP:
-					_input.up = true;
-					break;
-				case VK_DOWN:
-					_input.down = true;
-					break;
+		case WM_KEYUP: {
+			const bool pressed = (message == WM_KEYDOWN);
+			if (pressed && (lParam & (1 << 30))) {  // キーリピートは無視
+				break;
 			}
-			break;
-		case WM_KEYUP:
+			if (wParam == VK_F2 && pressed) {
+				spritePath = (spritePath == SpritePath::VERTEX) ? SpritePath::INSTANCED : SpritePath::VERTEX;
+			}
+			if (wParam == VK_F3 && pressed) {
+				particleStress.store(!particleStress.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			}
+
+			dxstg::InputEvent e;
+			e.time = dxstg::InputClockNow();
+			e.pressed = pressed;
+			bool isGameKey = true;
 			switch (wParam) {
 				case VK_LEFT:
-					_input.left = false;
+					e.key = dxstg::Key::LEFT;
 					break;
 				case VK_RIGHT:
-					_input.right = false;
+					e.key = dxstg::Key::RIGHT;
 					break;
 				case VK_UP:
-					_input.up = false;
+					e.key = dxstg::Key::UP;
 					break;
 				case VK_DOWN:
-					_input.down = false;
+					e.key = dxstg::Key::DOWN;
+					break;
+				default:
+					isGameKey = false;
 					break;
 			}
+			if (isGameKey) {
+				// 離したイベントを捨てるとキーが押しっぱなしになるので、押しているキーは別にも持っておく
+				if (pressed) {
+					_heldKeys.fetch_or(dxstg::KeyBit(e.key), std::memory_order_release);
+				} else {
+					_heldKeys.fetch_and(static_cast<dxstg::KeyMask>(~dxstg::KeyBit(e.key)), std::memory_order_release);
+				}
+				if (!_inputEvents.tryPush(e)) {
+					_droppedInputEvents.fetch_add(1, std::memory_order_release);
+				}
+			}
 			break;
+		}
 		case WM_CLOSE:
 			PostMessage(hWnd, WM_DESTROY, 0, 0);
 			break;
@@ -222,7 +366,163 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
 	return DefWindowProc(hWnd, message, wParam, lParam);
 }
 
-// foCX֘A\[X
+// カメラ
+// z = -cameraDistance から原点を見る。ゲームオブジェクトは z = 0 の平面上にある
+constexpr float cameraDistance = 8.f;
+constexpr float cameraFovY = 45.f;  // 縦の視野角 (度)
+dxstg::Rectangle visibleWorldRect;  // z = 0 の平面のうちカメラに映る範囲
+
+// カメラに映る範囲 (視錐台と z = 0 の平面の交わり)
+dxstg::Rectangle ComputeVisibleWorldRect()
+{
+	const float aspect = (float)dxstg::clientWidth / dxstg::clientHeight;
+	const float halfHeight = cameraDistance * std::tan(DirectX::XMConvertToRadians(cameraFovY) * 0.5f);
+	const float halfWidth = halfHeight * aspect;
+	return { -halfWidth, -halfHeight, halfWidth, halfHeight };
+}
+
+// 弾などは、画面の外にこの距離以上出たら消す (負なら画面外でも消さない)
+float projectileRetireMargin = 1.f;
+
+// エフェクトのパーティクルの数の上限
+constexpr size_t particleCapacity = 1 << 18;
+
+dxstg::WorldSettings MakeWorldSettings()
+{
+	dxstg::WorldSettings settings;
+	settings.retireRect = ComputeVisibleWorldRect().inflated(projectileRetireMargin);
+	settings.retireOffscreen = projectileRetireMargin >= 0;
+	settings.particleCapacity = particleCapacity;
+	settings.stage = stageTimeline ? &stageTimeline : nullptr;
+	return settings;
+}
+
+// 外に出すメトリクス (-metrics-port / -metrics-file を付けたときだけ出す)
+// 値を作るスレッド (シミュレーション・描画・バッチ) が書き、エクスポーターのスレッドが読む。
+struct EngineMetrics {
+	dxstg::MetricGauge players;      // StgObject::Type::PLAYER
+	dxstg::MetricGauge enemies;      // StgObject::Type::ENEMY (弾は入らない)
+	dxstg::MetricGauge enemyBullets;
+	dxstg::MetricGauge particles;
+	dxstg::MetricCounter spawned;
+	dxstg::MetricCounter removed;
+	dxstg::MetricCounter ticks;
+
+	// 処理ごとの時間
+	dxstg::MetricHistogram simTick;
+	dxstg::MetricHistogram collisionDetect;
+	dxstg::MetricHistogram collisionResolve;
+	dxstg::MetricHistogram particleUpdate;
+	dxstg::MetricHistogram renderFrame;
+	dxstg::MetricHistogram renderBuild;
+	dxstg::MetricHistogram renderFlush;
+	dxstg::MetricHistogram present;
+	dxstg::MetricHistogram batchChunk;
+
+	dxstg::MetricGauge fontGlyphs;
+	dxstg::MetricGauge fontTextureBytes;
+	dxstg::MetricGauge fontPendingGlyphs;
+	dxstg::MetricCounter fontMisses;
+
+	dxstg::MetricGauge simArenaPeakBytes;
+	dxstg::MetricCounter simArenaOverflows;
+	dxstg::MetricGauge renderArenaPeakBytes;
+	dxstg::MetricCounter renderArenaOverflows;
+
+	dxstg::MetricGauge batchWorlds;
+	dxstg::MetricGauge batchWorldTicksPerSecond;
+};
+EngineMetrics engineMetrics;
+
+constexpr auto metricsFileInterval = std::chrono::seconds(1);
+
+// メトリクスの本文を作る (エクスポーターのスレッドで呼ばれる)
+void WriteEngineMetrics(dxstg::MetricsText& text)
+{
+	const EngineMetrics& m = engineMetrics;
+
+	text.family("dxstg_objects", "gauge", "Live game objects by StgObject::Type and storage.");
+	text.value("dxstg_objects", "type=\"player\",storage=\"object\"", m.players.value());
+	text.value("dxstg_objects", "type=\"enemy\",storage=\"object\"", m.enemies.value());
+	text.value("dxstg_objects", "type=\"enemy\",storage=\"bullet\"", m.enemyBullets.value());
+	text.family("dxstg_particles", "gauge", "Live effect particles.");
+	text.value("dxstg_particles", nullptr, m.particles.value());
+	text.family("dxstg_spawned_total", "counter", "Objects and bullets added to the world.");
+	text.value("dxstg_spawned_total", nullptr, m.spawned.value());
+	text.family("dxstg_removed_total", "counter", "Objects and bullets removed from the world.");
+	text.value("dxstg_removed_total", nullptr, m.removed.value());
+	text.family("dxstg_ticks_total", "counter", "Simulation ticks run.");
+	text.value("dxstg_ticks_total", nullptr, m.ticks.value());
+
+	// 処理ごとの時間。分布と、始めからの分布で推定したパーセンタイル
+	const struct {
+		const char* labels;
+		const dxstg::MetricHistogram* histogram;
+	} phases[] = {
+		{ "phase=\"sim_tick\"", &m.simTick },
+		{ "phase=\"collision_detect\"", &m.collisionDetect },
+		{ "phase=\"collision_resolve\"", &m.collisionResolve },
+		{ "phase=\"particle_update\"", &m.particleUpdate },
+		{ "phase=\"render_frame\"", &m.renderFrame },
+		{ "phase=\"render_build\"", &m.renderBuild },
+		{ "phase=\"render_flush\"", &m.renderFlush },
+		{ "phase=\"present\"", &m.present },
+		{ "phase=\"batch_chunk\"", &m.batchChunk },
+	};
+	dxstg::MetricHistogram::Snapshot snapshots[_countof(phases)];
+	text.family("dxstg_phase_seconds", "histogram", "Time spent per frame or tick in each phase.");
+	for (size_t i = 0; i < _countof(phases); ++i) {
+		snapshots[i] = phases[i].histogram->snapshot();
+		text.histogram("dxstg_phase_seconds", phases[i].labels, snapshots[i]);
+	}
+	text.family("dxstg_phase_quantile_seconds", "gauge", "Estimated percentiles of dxstg_phase_seconds since start.");
+	const char* const quantiles[] = { "0.5", "0.9", "0.99" };
+	for (size_t i = 0; i < _countof(phases); ++i) {
+		for (const char* q : quantiles) {
+			const std::string labels = std::string(phases[i].labels) + ",quantile=\"" + q + "\"";
+			text.value("dxstg_phase_quantile_seconds", labels.c_str(), snapshots[i].quantile(std::atof(q)));
+		}
+	}
+
+	text.family("dxstg_font_glyphs", "gauge", "Glyphs held by the font texture map.");
+	text.value("dxstg_font_glyphs", nullptr, m.fontGlyphs.value());
+	text.family("dxstg_font_texture_bytes", "gauge", "Texture memory held by the font texture map.");
+	text.value("dxstg_font_texture_bytes", nullptr, m.fontTextureBytes.value());
+	text.family("dxstg_font_pending_glyphs", "gauge", "Glyphs waiting for the rasterizer thread.");
+	text.value("dxstg_font_pending_glyphs", nullptr, m.fontPendingGlyphs.value());
+	text.family("dxstg_font_glyph_misses_total", "counter", "Glyph lookups that had to create the glyph.");
+	text.value("dxstg_font_glyph_misses_total", nullptr, m.fontMisses.value());
+
+	if (dxstg::AllocationCountEnabled) {
+		text.family("dxstg_allocations_total", "counter", "Calls to global operator new.");
+		text.value("dxstg_allocations_total", nullptr, dxstg::AllocationCount());
+		text.family("dxstg_deallocations_total", "counter", "Calls to global operator delete.");
+		text.value("dxstg_deallocations_total", nullptr, dxstg::DeallocationCount());
+	}
+	text.family("dxstg_frame_arena_peak_bytes", "gauge", "Peak per-frame arena usage.");
+	text.value("dxstg_frame_arena_peak_bytes", "thread=\"sim\"", m.simArenaPeakBytes.value());
+	text.value("dxstg_frame_arena_peak_bytes", "thread=\"render\"", m.renderArenaPeakBytes.value());
+	text.family("dxstg_frame_arena_overflows_total", "counter", "Per-frame arena allocations that fell back to the heap.");
+	text.value("dxstg_frame_arena_overflows_total", "thread=\"sim\"", m.simArenaOverflows.value());
+	text.value("dxstg_frame_arena_overflows_total", "thread=\"render\"", m.renderArenaOverflows.value());
+
+	text.family("dxstg_batch_worlds", "gauge", "Worlds run by the headless batch mode.");
+	text.value("dxstg_batch_worlds", nullptr, m.batchWorlds.value());
+	text.family("dxstg_batch_world_ticks_per_second", "gauge", "Batch mode throughput over the last chunk.");
+	text.value("dxstg_batch_world_ticks_per_second", nullptr, m.batchWorldTicksPerSecond.value());
+}
+
+// シミュレーションスレッド
+// 一定の間隔でゲームを進め、描画内容 (RenderList) をトリプルバッファで描画スレッドに渡す。
+// 描画スレッドが Present の垂直同期で待っていても、シミュレーションは遅れない。
+constexpr auto simulationTickPeriod = std::chrono::nanoseconds(1000000000 / 60);
+constexpr int maxCatchUpTicks = 5;  // 遅れたときにまとめて進めるティック数の上限
+constexpr size_t frameArenaCapacity = 64 * 1024; // 1ティック (1フレーム) の間だけ使うメモリの大きさ
+dxstg::TripleBuffer<dxstg::RenderList> renderLists;
+std::thread simulationThread;
+std::atomic<bool> simulationQuit{ false };
+
+// デバイス関連リソース
 const TCHAR wndclassName[] = _T("DX11TutorialWindowClass");
 HWND hWnd;
 ComPtr<ID3D11Device> device;
@@ -232,91 +532,150 @@ D3D_FEATURE_LEVEL featureLevel;
 ComPtr<ID3D11Texture2D> backBuffer;
 ComPtr<ID3D11RenderTargetView> renderTargetView;
 D3D11_VIEWPORT viewports[1];
-ComPtr<ID3D11ShaderResourceView> srvXchu;   // xchũeNX`
-ComPtr<ID3D11ShaderResourceView> srvBullet; // bullet̃eNX`
+ComPtr<ID3D11ShaderResourceView> srvXchu;   // xchuのテクスチャ
+ComPtr<ID3D11ShaderResourceView> srvBullet; // bulletのテクスチャ
 ComPtr<ID3D11InputLayout> inputLayout;
 ComPtr<ID3D11VertexShader> vertexShader;
-ComPtr<ID3D11Buffer> vsCBuffer;
+ComPtr<ID3D11InputLayout> instancedInputLayout;
+ComPtr<ID3D11VertexShader> instancedVertexShader;
+ComPtr<ID3D11Buffer> vsCBuffer;       // カメラの行列
+ComPtr<ID3D11Buffer> vsScreenCBuffer; // スクリーン座標系の行列 (文字用)
 ComPtr<ID3D11PixelShader> pixelShader;
-ComPtr<ID3D11Buffer> psCBuffer;
+ComPtr<ID3D11PixelShader> textPixelShader; // α値のみのフォント用
+ComPtr<ID3D11PixelShader> sdfTextPixelShader; // 距離場のフォント用
 ComPtr<ID3D11SamplerState> psSamplerState;
+ComPtr<ID3D11SamplerState> textSamplerState; // 距離場のフォント用 (バイリニア)
 ComPtr<ID3D11Buffer> vertexBuffer;
 ComPtr<ID3D11RasterizerState> rasterizerState;
 ComPtr<ID3D11BlendState> blendState;
 std::unique_ptr<dxstg::FontTextureMap> font;
+std::unique_ptr<dxstg::StateCache> stateCache; // シェーダーなどの設定はこれを通す
+dxstg::RenderQueue renderQueue; // 1フレーム分の描画要求
+ComPtr<ID3D11Buffer> indexBuffer;
+ComPtr<ID3D11Buffer> instanceBuffer;
+VSConstants cameraVSConstants; // ゲームオブジェクト用
+VSConstants screenVSConstants; // 文字用
+
+// スプライトの頂点バッファ・インスタンスバッファ
+// 同じマテリアル・テクスチャが続くスプライトをまとめて書き込み、1回で描画する。
+// 書き込む位置は毎回進めて、最後まで使ったら捨てて先頭に戻る (WRITE_NO_OVERWRITE / WRITE_DISCARD)。
+constexpr UINT SpriteBufferCapacity = 4096; // 1つのバッファに入るスプライトの数 (インデックスは16ビット)
+UINT vertexBufferCursor = 0;                // 次に書き込むスプライトの位置
+UINT instanceBufferCursor = 0;
+
+// 頂点バッファへの書き込みの統計 (1フレーム分)
+struct SpriteUploadStats {
+	size_t sprites = 0;
+	size_t batches = 0;
+	size_t bytes = 0;
+};
+SpriteUploadStats spriteUploadStats;
 
-// \[X̏
+// リソースの初期化
 void Init(HINSTANCE hInstance)
 {
 	using namespace dxstg;
 
-	// Window쐬
+	const auto initBegin = StartupClock::now();
+	std::vector<StartupRecord> startupRecords;
+
+	// アセットパックを開く (なくてもよい)
+	assetPack = dxstg::AssetPack(L"data/assets.pak");
+	if (assetPack) {
+		OutputDebugStringW(L"data/assets.pak opened\n");
+	}
+	OpenStage();
+
+	// アセットの読み込みとデコードは、ウィンドウやデバイスの作成と並行してワーカースレッドで行う
+	// PNG のデコードに WIC (COM) を使うので、各スレッドで COM を初期化する
+	ThreadPool loader(0,
+		[] { CoInitializeEx(nullptr, COINIT_MULTITHREADED); },
+		[] { CoUninitialize(); });
+	auto xchuTexture = loader.submit([] { return ReadTextureAsset("xchu"); });
+	auto bulletTexture = loader.submit([] { return ReadTextureAsset("bullet"); });
+	auto vertexShaderBin = loader.submit([] { return ReadAsset("VertexShader.cso"); });
+	auto instancedVertexShaderBin = loader.submit([] { return ReadAsset("InstancedVertexShader.cso"); });
+	auto pixelShaderBin = loader.submit([] { return ReadAsset("PixelShader.cso"); });
+	auto textPixelShaderBin = loader.submit([] { return ReadAsset("TextPixelShader.cso"); });
+	auto sdfTextPixelShaderBin = loader.submit([] { return ReadAsset("SdfTextPixelShader.cso"); });
+
+	// 読み込みが終わるのを待って、デバイスのオブジェクトを作成する
+	auto createFromAsset = [&startupRecords](std::future<LoadedAsset>& future, auto&& createObject) {
+		const LoadedAsset asset = future.get();
+		const auto begin = StartupClock::now();
+		createObject(asset);
+		startupRecords.push_back({ asset.name, asset.loadMs, ElapsedMs(begin) });
+	};
+
+	// Windowを作成
 	WNDCLASS wndclass;
-	wndclass.style = 0;  // Ɏg萔ꗗ: https://docs.microsoft.com/ja-jp/windows/desktop/winmsg/window-class-styles
+	wndclass.style = 0;  // ここに使える定数一覧: https://docs.microsoft.com/ja-jp/windows/desktop/winmsg/window-class-styles
 	wndclass.lpfnWndProc = WndProc;
 	wndclass.cbClsExtra = 0;
 	wndclass.cbWndExtra = 0;
 	wndclass.hInstance = hInstance;
 	wndclass.hIcon = nullptr;
 	wndclass.hCursor = LoadCursor(nullptr, IDC_ARROW);
-	wndclass.hbrBackground = (HBRUSH)GetStockObject(BLACK_BRUSH);  // \[XDirectXSample
+	wndclass.hbrBackground = (HBRUSH)GetStockObject(BLACK_BRUSH);  // ソースはDirectXのSample
 	wndclass.lpszMenuName = nullptr;
 	wndclass.lpszClassName = wndclassName;
 
-	if (!RegisterClass(&wndclass)) { // G[
+	if (!RegisterClass(&wndclass)) { // エラー
 		OutputDebugStringW(L"failed: RegisterClass\n");
 		throw 0;
 	}
 
-	// NCAg̈悪 640 x 480 ̃EBhE쐬
+	// クライアント領域が 640 x 480 のウィンドウを作成
 	RECT rc = { 0, 0, dxstg::clientWidth, dxstg::clientHeight };
 	AdjustWindowRect(&rc, WS_OVERLAPPEDWINDOW, false);
 
-	hWnd = CreateWindow(wndclassName, _T("uTv"),
+	hWnd = CreateWindow(wndclassName, _T("裏講座サンプル"),
 		WS_OVERLAPPEDWINDOW,
 		CW_USEDEFAULT, CW_USEDEFAULT, rc.right - rc.left, rc.bottom - rc.top, nullptr,
 		nullptr, hInstance, nullptr);
 
-	if (hWnd == NULL) { // G[
+	if (hWnd == NULL) { // エラー
 		OutputDebugStringW(L"failed: CreateWindow\n");
 		throw 0;
 	}
 
-	//  DirectX11 ̏
-	// Xbv`FCAfoCXAfoCXReNXg̍쐬
+	// ここから DirectX11 の初期化
+	const auto deviceBegin = StartupClock::now();
+
+	// スワップチェイン、デバイス、デバイスコンテクストの作成
 	{
 		DXGI_SWAP_CHAIN_DESC swapChainDesc;
-		swapChainDesc.BufferDesc.Width = clientWidth;   // ʉ𑜓x
-		swapChainDesc.BufferDesc.Height = clientHeight; // ʉ𑜓x
-		swapChainDesc.BufferDesc.RefreshRate.Numerator = 60; // tbV[g̕q
-		swapChainDesc.BufferDesc.RefreshRate.Denominator = 1; // tbV[g̕
-		// swapChainDesc.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB; // tH[}bgB https://docs.microsoft.com/ja-jp/previous-versions/direct-x/ee418116%28v%3dvs.85%29
-		swapChainDesc.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM; // sRGBB̂ق̂܂܂Ō邩炱ɂĂB https://docs.microsoft.com/ja-jp/previous-versions/direct-x/ee418116%28v%3dvs.85%29
-		swapChainDesc.BufferDesc.ScanlineOrdering = DXGI_MODE_SCANLINE_ORDER_UNSPECIFIED;  // ̏w肵Ȃ
-		swapChainDesc.BufferDesc.Scaling = DXGI_MODE_SCALING_UNSPECIFIED;  // XP[(?)
-		swapChainDesc.SampleDesc.Count = 1;  // sNZPʂ̃}`TvO̐
-		swapChainDesc.SampleDesc.Quality = 0;  // C[W̕ixB0͍ŒB
-		swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT; // o̓_[^[QbgƂĎgpB DXGI_USAGE_SHADER_INPUT ΃VF[_[̓͂ƂĂgp\B
-		swapChainDesc.BufferCount = 2; // tgobt@܂߂obt@
-		swapChainDesc.OutputWindow = hWnd; // o͐̃EBhE
-		swapChainDesc.Windowed = true; // EBhE[h
-		swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;  // obNobt@tgɕ\̓obNobt@̓ejB
-		swapChainDesc.Flags = DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH;  // IDXGISwapChain::ResizeTarget ɂEBhETCY̕ύXɑΉB
+		swapChainDesc.BufferDesc.Width = clientWidth;   // 画面解像度
+		swapChainDesc.BufferDesc.Height = clientHeight; // 画面解像度
+		swapChainDesc.BufferDesc.RefreshRate.Numerator = 60; // リフレッシュレートの分子
+		swapChainDesc.BufferDesc.RefreshRate.Denominator = 1; // リフレッシュレートの分母
+		// swapChainDesc.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM_SRGB; // フォーマット。 https://docs.microsoft.com/ja-jp/previous-versions/direct-x/ee418116%28v%3dvs.85%29
+		swapChainDesc.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM; // 上はsRGB。こっちのほうがそのままで見えるからこっちにしておく。 https://docs.microsoft.com/ja-jp/previous-versions/direct-x/ee418116%28v%3dvs.85%29
+		swapChainDesc.BufferDesc.ScanlineOrdering = DXGI_MODE_SCANLINE_ORDER_UNSPECIFIED;  // 走査線の順序を指定しない
+		swapChainDesc.BufferDesc.Scaling = DXGI_MODE_SCALING_UNSPECIFIED;  // スケール(?)
+		swapChainDesc.SampleDesc.Count = 1;  // ピクセル単位のマルチサンプリングの数
+		swapChainDesc.SampleDesc.Quality = 0;  // イメージの品質レベル。0は最低。
+		swapChainDesc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT; // 出力レンダーターゲットとして使用。ここに DXGI_USAGE_SHADER_INPUT も入れればシェーダーの入力としても使用可能。
+		swapChainDesc.BufferCount = 2; // フロントバッファも含めたバッファ数
+		swapChainDesc.OutputWindow = hWnd; // 出力先のウィンドウ
+		swapChainDesc.Windowed = true; // ウィンドウモード
+		swapChainDesc.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;  // バックバッファをフロントに表示した後はバックバッファの内容を破棄する。
+		swapChainDesc.Flags = DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH;  // IDXGISwapChain::ResizeTarget によるウィンドウサイズの変更に対応。
 
 		ThrowIfFailed(L"D3D11CreateDeviceAndSwapChain",
-			D3D11CreateDeviceAndSwapChain( // t@X: https://docs.microsoft.com/ja-jp/previous-versions/direct-x/ee416033%28v%3dvs.85%29
-				nullptr, // rfIA_v^[(rfIJ[h): nullptrŃftHĝ̂gp
-				D3D_DRIVER_TYPE_HARDWARE, // hCo[: n[hEFAhCo[Bɓ삷
-				nullptr, // \tgEFA: Ńn[hEFAhCo[gpƂ nullptr w肷B
-				0, // tO: w͂ȂBVOXbhł̎gp͂B https://docs.microsoft.com/ja-jp/previous-versions/direct-x/ee416076%28v%3dvs.85%29
-				nullptr, // 쐬݂@\x̔zBnullptȑꍇő̋@\x쐬B
-				0, // ̔z̗vf
-				D3D11_SDK_VERSION, // SDK̃o[WB̒lw肷B
-				&swapChainDesc,  // Őݒ肵Xbv`FC̐ݒ
-				swapChain.ReleaseAndGetAddressOf(),  // ߂l
-				device.ReleaseAndGetAddressOf(),  // ߂l
-				&featureLevel,  // ߂l
-				immediateContext.ReleaseAndGetAddressOf()  // ߂l
+			D3D11CreateDeviceAndSwapChain( // リファレンス: https://docs.microsoft.com/ja-jp/previous-versions/direct-x/ee416033%28v%3dvs.85%29
+				nullptr, // ビデオアダプター(ビデオカード): nullptrでデフォルトのものを使用
+				D3D_DRIVER_TYPE_HARDWARE, // ドライバー: ハードウェアドライバー。高速に動作する
+				nullptr, // ソフトウェア: 上でハードウェアドライバーを使用するときは nullptr を指定する。
+				0, // フラグ: 指定はしない。シングルスレッドでの使用はあり。 https://docs.microsoft.com/ja-jp/previous-versions/direct-x/ee416076%28v%3dvs.85%29
+				nullptr, // 作成を試みる機能レベルの配列。nullptrの場合最大の機能レベルを作成する。
+				0, // 上の配列の要素数
+				D3D11_SDK_VERSION, // SDKのバージョン。この値を指定する。
+				&swapChainDesc,  // 上で設定したスワップチェインの設定
+				swapChain.ReleaseAndGetAddressOf(),  // 戻り値
+				device.ReleaseAndGetAddressOf(),  // 戻り値
+				&featureLevel,  // 戻り値
+				immediateContext.ReleaseAndGetAddressOf()  // 戻り値
 			));
 	}
 
@@ -334,19 +693,19 @@ void Init(HINSTANCE hInstance)
 			break;
 	}
 
-	// Xbv`FCobNobt@𓾂
+	// スワップチェインからバックバッファを得る
 	ThrowIfFailed(L"SwapChain::GetBuffer",
 		swapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (void**)backBuffer.ReleaseAndGetAddressOf()));
 
-	// _[^[Qbgr[쐬
+	// レンダーターゲットビューを作成
 	ThrowIfFailed(L"CreateRenderTargetView",
 		device->CreateRenderTargetView(backBuffer.Get(), nullptr, renderTargetView.ReleaseAndGetAddressOf()));
 
-	// _[^[Qbgݒ
-	// [xXeV͎gȂB
+	// レンダーターゲットを設定
+	// 深度ステンシルは使わない。
 	immediateContext->OMSetRenderTargets(1, renderTargetView.GetAddressOf(), nullptr);
 
-	// r[|[gݒ
+	// ビューポートを設定
 	viewports[0].Width = clientWidth;
 	viewports[0].Height = clientHeight;
 	viewports[0].MinDepth = 0.0f;
@@ -355,40 +714,66 @@ void Init(HINSTANCE hInstance)
 	viewports[0].TopLeftY = 0;
 	immediateContext->RSSetViewports(1, viewports);
 
-	// DirectX11 I
+	// DirectX11 初期化終わり
+	startupRecords.push_back({ "(device)", 0, ElapsedMs(deviceBegin) });
 
 
-	// eNX`ǂݍ݁AShaderResourceView쐬B
+	// テクスチャの ShaderResourceViewを作成。
 
-	ThrowIfFailed(L"LoadTexture (xchu.png)",
-		LoadTexture(device.Get(), L"data/xchu.png", &srvXchu)); // TODO
+	createFromAsset(xchuTexture, [](const LoadedAsset& asset) {
+		ThrowIfFailed(L"CreateTextureAsset (xchu)",
+			CreateTextureAsset(device.Get(), asset, &srvXchu)); // TODO
+	});
 
-	ThrowIfFailed(L"LoadTexture (bullet.png)",
-		LoadTexture(device.Get(), L"data/bullet.png", &srvBullet));
+	createFromAsset(bulletTexture, [](const LoadedAsset& asset) {
+		ThrowIfFailed(L"CreateTextureAsset (bullet)",
+			CreateTextureAsset(device.Get(), asset, &srvBullet));
+	});
 
-	// _VF[_[쐬
-	{
-		BinFile vsBin(L"data/VertexShader.cso");
+	// 頂点シェーダーを作成
+	createFromAsset(vertexShaderBin, [](const LoadedAsset& asset) {
+		const dxstg::AssetView& vsBin = asset.data;
 		if (!vsBin) {
-			OutputDebugStringW(L"failed: BinFile (VertexShader.cso)\n");
+			OutputDebugStringW(L"failed: ReadAsset (VertexShader.cso)\n");
 			throw 0;
 		}
 		ThrowIfFailed(L"CreateVertexShader",
 			device->CreateVertexShader(vsBin.get(), vsBin.size(), nullptr, vertexShader.ReleaseAndGetAddressOf()));
 
-		// CvbgCAEg̍쐬
+		// インプットレイアウトの作成
 		D3D11_INPUT_ELEMENT_DESC inputElems[] = {
-			{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-			{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, offsetof(Vertex, u), D3D11_INPUT_PER_VERTEX_DATA, 0 }
+			{ "POSITION", 0, DXGI_FORMAT_R16G16_SINT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+			{ "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, offsetof(SpriteVertex, r), D3D11_INPUT_PER_VERTEX_DATA, 0 }
 		};
 		ThrowIfFailed(L"CreateInputLayout",
 			device->CreateInputLayout(inputElems, ARRAYSIZE(inputElems), vsBin.get(), vsBin.size(), inputLayout.ReleaseAndGetAddressOf()));
-	}
+	});
 
-	// _VF[_̒萔obt@쐬
+	// インスタンス描画用の頂点シェーダーを作成
+	createFromAsset(instancedVertexShaderBin, [](const LoadedAsset& asset) {
+		const dxstg::AssetView& vsBin = asset.data;
+		if (!vsBin) {
+			OutputDebugStringW(L"failed: ReadAsset (InstancedVertexShader.cso)\n");
+			throw 0;
+		}
+		ThrowIfFailed(L"CreateVertexShader (instanced)",
+			device->CreateVertexShader(vsBin.get(), vsBin.size(), nullptr, instancedVertexShader.ReleaseAndGetAddressOf()));
+
+		// インプットレイアウトの作成 (すべてインスタンスごと)
+		D3D11_INPUT_ELEMENT_DESC inputElems[] = {
+			{ "POSITION", 0, DXGI_FORMAT_R16G16_SINT, 0, offsetof(SpriteInstance, centerX), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "SIZE", 0, DXGI_FORMAT_R16G16_UINT, 0, offsetof(SpriteInstance, halfWidth), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "TEXCOORD", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, offsetof(SpriteInstance, u0), D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+			{ "COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, offsetof(SpriteInstance, r), D3D11_INPUT_PER_INSTANCE_DATA, 1 }
+		};
+		ThrowIfFailed(L"CreateInputLayout (instanced)",
+			device->CreateInputLayout(inputElems, ARRAYSIZE(inputElems), vsBin.get(), vsBin.size(), instancedInputLayout.ReleaseAndGetAddressOf()));
+	});
+
+	// 頂点シェーダの定数バッファを作成
 	{
 		D3D11_BUFFER_DESC bufferDesc;
-		bufferDesc.ByteWidth = 4 * 4 * 4;  // 16̔{łKvB
+		bufferDesc.ByteWidth = sizeof(VSConstants);  // 16の倍数である必要がある。
 		bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
 		bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
 		bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
@@ -396,44 +781,88 @@ void Init(HINSTANCE hInstance)
 
 		ThrowIfFailed(L"CreateBuffer (vs cbuffer)",
 			device->CreateBuffer(&bufferDesc, nullptr, vsCBuffer.ReleaseAndGetAddressOf()));
+		ThrowIfFailed(L"CreateBuffer (vs screen cbuffer)",
+			device->CreateBuffer(&bufferDesc, nullptr, vsScreenCBuffer.ReleaseAndGetAddressOf()));
 	}
 
-	// sNZVF[_[쐬
+	// カメラの配置を決定
+	// カメラは動かないので、行列は最初に1回だけ計算する
 	{
-		BinFile psBin(L"data/PixelShader.cso");
+		using namespace DirectX;
+		const float aspect = (float)clientWidth / clientHeight;
+		XMMATRIX viewProj
+			= XMMatrixLookAtLH(XMVectorSet(0, 0, -cameraDistance, 1), XMVectorSet(0, 0, 0, 1), XMVectorSet(0, 1, 0, 1))
+			* XMMatrixPerspectiveFovLH(XMConvertToRadians(cameraFovY), aspect, 0.1f, 100.f);
+		XMStoreFloat4x4(&cameraVSConstants.viewProj, XMMatrixTranspose(viewProj));  // 行列は転置します。
+
+		// 頂点の位置は原点から ±16 (画面の幅の倍以上) までを 1/1024 の精度で表す
+		cameraVSConstants.encoding.originX = 0;
+		cameraVSConstants.encoding.originY = 0;
+		cameraVSConstants.encoding.positionUnit = 1.f / 1024;
+		cameraVSConstants.padding = 0;
+
+		visibleWorldRect = ComputeVisibleWorldRect();
+
+		// 文字用のスクリーン座標系
+		XMMATRIX screen = XMMatrixSet(
+			2 / (float)clientWidth, 0, 0, 0,
+			0, -2 / (float)clientHeight, 0, 0,
+			0, 0, 1, 0,
+			-1, 1, 0, 1
+		);
+		XMStoreFloat4x4(&screenVSConstants.viewProj, XMMatrixTranspose(screen));  // 行列は転置します。
+
+		// 頂点の位置は画面の中心から ±2048 ピクセルまでを 1/8 ピクセルの精度で表す
+		screenVSConstants.encoding.originX = clientWidth * 0.5f;
+		screenVSConstants.encoding.originY = clientHeight * 0.5f;
+		screenVSConstants.encoding.positionUnit = 1.f / 8;
+		screenVSConstants.padding = 0;
+	}
+
+	// ピクセルシェーダーを作成
+	createFromAsset(pixelShaderBin, [](const LoadedAsset& asset) {
+		const dxstg::AssetView& psBin = asset.data;
 		if (!psBin) {
-			OutputDebugStringW(L"failed: BinFile (PixelShader.cso)\n");
+			OutputDebugStringW(L"failed: ReadAsset (PixelShader.cso)\n");
 			throw 0;
 		}
 		ThrowIfFailed(L"CreatePixelShader",
 			device->CreatePixelShader(psBin.get(), psBin.size(), nullptr, pixelShader.ReleaseAndGetAddressOf()));
-	}
+	});
 
-	// sNZVF[_[̒萔obt@쐬
-	// _VF[_̒萔obt@쐬
-	{
-		D3D11_BUFFER_DESC bufferDesc;
-		bufferDesc.ByteWidth = 16;  // 16̔{łKvB
-		bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-		bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-		bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-		bufferDesc.MiscFlags = 0;
+	// 文字用のピクセルシェーダーを作成
+	createFromAsset(textPixelShaderBin, [](const LoadedAsset& asset) {
+		const dxstg::AssetView& psBin = asset.data;
+		if (!psBin) {
+			OutputDebugStringW(L"failed: ReadAsset (TextPixelShader.cso)\n");
+			throw 0;
+		}
+		ThrowIfFailed(L"CreatePixelShader (text)",
+			device->CreatePixelShader(psBin.get(), psBin.size(), nullptr, textPixelShader.ReleaseAndGetAddressOf()));
+	});
 
-		ThrowIfFailed(L"CreateBuffer (ps cbuffer)",
-			device->CreateBuffer(&bufferDesc, nullptr, psCBuffer.ReleaseAndGetAddressOf()));
-	}
+	// 距離場の文字用のピクセルシェーダーを作成
+	createFromAsset(sdfTextPixelShaderBin, [](const LoadedAsset& asset) {
+		const dxstg::AssetView& psBin = asset.data;
+		if (!psBin) {
+			OutputDebugStringW(L"failed: ReadAsset (SdfTextPixelShader.cso)\n");
+			throw 0;
+		}
+		ThrowIfFailed(L"CreatePixelShader (sdf text)",
+			device->CreatePixelShader(psBin.get(), psBin.size(), nullptr, sdfTextPixelShader.ReleaseAndGetAddressOf()));
+	});
 
-	// sNZVF[_[̃Tv[Xe[g쐬
+	// ピクセルシェーダーのサンプラーステートを作成
 	{
 		D3D11_SAMPLER_DESC samplerDesc;
-		samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_POINT;  // |CgTvO
+		samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_POINT;  // ポイントサンプリング
 		samplerDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
 		samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
 		samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
-		// samplerDesc.MipLODBias = 0;  // ftHg
-		// samplerDesc.MaxAnisotropy = 16;  // ftHg
-		// samplerDesc.MinLOD = -FLT_MAX;  // ftHg
-		// samplerDesc.MaxLOD = FLT_MAX;  // ftHg
+		// samplerDesc.MipLODBias = 0;  // デフォルト
+		// samplerDesc.MaxAnisotropy = 16;  // デフォルト
+		// samplerDesc.MinLOD = -FLT_MAX;  // デフォルト
+		// samplerDesc.MaxLOD = FLT_MAX;  // デフォルト
 		samplerDesc.MipLODBias = 0.0f;
 		samplerDesc.MaxAnisotropy = 1;
 		samplerDesc.ComparisonFunc = D3D11_COMPARISON_ALWAYS;
@@ -446,12 +875,17 @@ void Init(HINSTANCE hInstance)
 
 		ThrowIfFailed(L"CreateSamplerState",
 			device->CreateSamplerState(&samplerDesc, psSamplerState.ReleaseAndGetAddressOf()));
+
+		// 距離場は補間して使うのでバイリニアにする
+		samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+		ThrowIfFailed(L"CreateSamplerState (text)",
+			device->CreateSamplerState(&samplerDesc, textSamplerState.ReleaseAndGetAddressOf()));
 	}
 
-	// _obt@쐬
+	// 頂点バッファを作成
 	{
 		D3D11_BUFFER_DESC bufferDesc;
-		bufferDesc.ByteWidth = 4 * sizeof(Vertex);  // 16̔{łKv͂ȂB
+		bufferDesc.ByteWidth = SpriteBufferCapacity * 4 * sizeof(SpriteVertex);  // 16の倍数である必要はない。
 		bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
 		bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 		bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
@@ -461,7 +895,50 @@ void Init(HINSTANCE hInstance)
 			device->CreateBuffer(&bufferDesc, nullptr, vertexBuffer.ReleaseAndGetAddressOf()));
 	}
 
-	// X^CU[Xe[g쐬
+	// インスタンスバッファを作成
+	{
+		D3D11_BUFFER_DESC bufferDesc;
+		bufferDesc.ByteWidth = SpriteBufferCapacity * sizeof(SpriteInstance);
+		bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+		bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		bufferDesc.MiscFlags = 0;
+
+		ThrowIfFailed(L"CreateBuffer (instance buffer)",
+			device->CreateBuffer(&bufferDesc, nullptr, instanceBuffer.ReleaseAndGetAddressOf()));
+	}
+
+	// インデックスバッファを作成
+	// スプライトごとに頂点4つを三角形2つにする。中身は変わらない
+	{
+		std::vector<std::uint16_t> indices(SpriteBufferCapacity * 6);
+		for (UINT i = 0; i < SpriteBufferCapacity; ++i) {
+			const auto v = static_cast<std::uint16_t>(i * 4);
+			indices[i * 6 + 0] = v + 0;
+			indices[i * 6 + 1] = v + 1;
+			indices[i * 6 + 2] = v + 2;
+			indices[i * 6 + 3] = v + 2;
+			indices[i * 6 + 4] = v + 1;
+			indices[i * 6 + 5] = v + 3;
+		}
+
+		D3D11_BUFFER_DESC bufferDesc;
+		bufferDesc.ByteWidth = static_cast<UINT>(indices.size() * sizeof(std::uint16_t));
+		bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+		bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+		bufferDesc.CPUAccessFlags = 0;
+		bufferDesc.MiscFlags = 0;
+
+		D3D11_SUBRESOURCE_DATA initData;
+		initData.pSysMem = indices.data();
+		initData.SysMemPitch = 0;
+		initData.SysMemSlicePitch = 0;
+
+		ThrowIfFailed(L"CreateBuffer (index buffer)",
+			device->CreateBuffer(&bufferDesc, &initData, indexBuffer.ReleaseAndGetAddressOf()));
+	}
+
+	// ラスタライザーステートを作成
 	{
 		D3D11_RASTERIZER_DESC rasterizerDesc;
 		rasterizerDesc.FillMode = D3D11_FILL_SOLID;
@@ -479,19 +956,23 @@ void Init(HINSTANCE hInstance)
 			device->CreateRasterizerState(&rasterizerDesc, rasterizerState.ReleaseAndGetAddressOf()));
 	}
 
-	// uhXe[g쐬
+	// ブレンドステートを作成
+	// テクスチャも頂点の色も乗算済みアルファなので、スプライトも文字もこの1つで描画する。
+	// 乗算済みアルファなら、α = 0 で色を入れたものは加算合成になる (ブレンドステートを切り替えなくてよい)
 	{
 		D3D11_BLEND_DESC blendDesc;
 		blendDesc.AlphaToCoverageEnable = false;
 		blendDesc.IndependentBlendEnable = false;
 		blendDesc.RenderTarget[0].BlendEnable = true;
-		// blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_ONE;    // At@uh
-		// blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_ZERO;  // At@uh
-		blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;      // At@uhL
-		blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA; // At@uhL
+		// blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_ONE;    // アルファブレンド無し
+		// blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_ZERO;  // アルファブレンド無し
+		// blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;      // アルファブレンド有り (普通のアルファ)
+		// blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA; // アルファブレンド有り (普通のアルファ)
+		blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_ONE;            // アルファブレンド有り (乗算済みアルファ)
+		blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA; // アルファブレンド有り (乗算済みアルファ)
 		blendDesc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
 		blendDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
-		blendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_ZERO;
+		blendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_INV_SRC_ALPHA;
 		blendDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
 		blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
 
@@ -499,32 +980,29 @@ void Init(HINSTANCE hInstance)
 			device->CreateBlendState(&blendDesc, blendState.ReleaseAndGetAddressOf()));
 	}
 
-	// _OpCvC̐ݒ
+	// レンダリングパイプラインの設定
+	// 毎フレーム変わりうるものは stateCache を通して設定する
+	stateCache = std::make_unique<StateCache>(immediateContext.Get());
 	{
-		UINT strides[1] = { sizeof(Vertex) };
-		UINT offsets[1] = { 0 };
-		immediateContext->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), strides, offsets);
-		immediateContext->IASetInputLayout(inputLayout.Get());
-		immediateContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-		immediateContext->VSSetShader(vertexShader.Get(), nullptr, 0);
-		immediateContext->VSSetConstantBuffers(0, 1, vsCBuffer.GetAddressOf());
-		immediateContext->PSSetShader(pixelShader.Get(), nullptr, 0);
-		immediateContext->PSSetConstantBuffers(0, 1, psCBuffer.GetAddressOf());
-		immediateContext->PSSetSamplers(0, 1, psSamplerState.GetAddressOf());
+		// 頂点バッファなどは描画方法に合わせて FlushRenderQueue で設定する
+		immediateContext->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
+		stateCache->setVSConstantBuffer(0, vsCBuffer.Get());
+		stateCache->setPixelShader(pixelShader.Get());
+		stateCache->setPSSampler(0, psSamplerState.Get());
 		immediateContext->RSSetState(rasterizerState.Get());
 
 		float blendColor[] = { 1, 1, 1, 1 };
-		immediateContext->OMSetBlendState(blendState.Get(), blendColor, 0xffffffff);
+		stateCache->setBlendState(blendState.Get(), blendColor, 0xffffffff);
 	}
 
-	// LOGFONT̉ https://msdn.microsoft.com/ja-jp/windows/desktop/dd145037
+	// LOGFONTの解説 https://msdn.microsoft.com/ja-jp/windows/desktop/dd145037
 	LOGFONTW logfont;
-	logfont.lfHeight = 30;
+	logfont.lfHeight = 48;  // 距離場を作る基準の大きさ。描画するときは DrawString の scale で拡大縮小する
 	logfont.lfWidth = 0;
 	logfont.lfEscapement = 0;
 	logfont.lfOrientation = 0;
-	logfont.lfWeight = FW_DONTCARE; // 
-	// logfont.lfWeight = FW_BOLD;  // {[h
+	logfont.lfWeight = FW_DONTCARE; // 普通
+	// logfont.lfWeight = FW_BOLD;  // ボールド
 	logfont.lfItalic = FALSE;
 	logfont.lfUnderline = FALSE;
 	logfont.lfStrikeOut = FALSE;
@@ -533,23 +1011,31 @@ void Init(HINSTANCE hInstance)
 	logfont.lfClipPrecision = CLIP_DEFAULT_PRECIS;
 	logfont.lfQuality = PROOF_QUALITY;
 	logfont.lfPitchAndFamily = DEFAULT_PITCH | FF_DONTCARE;
-	wchar_t fontName[] = L"CI";
+	wchar_t fontName[] = L"メイリオ";
 	CopyMemory(logfont.lfFaceName, fontName, sizeof(fontName));
 
-	font = std::make_unique<FontTextureMap>(device.Get(), logfont, false);
+	// 距離場にしておくと、1つのフォントでどの大きさの文字も描画できる
+	// ほかのテクスチャと同じく乗算済みアルファにする (Format::R8G8B8A8 のときに使われる)
+	const auto fontBegin = StartupClock::now();
+	font = std::make_unique<FontTextureMap>(device.Get(), logfont, true, FontTextureMap::Format::SDF8);
+	font->setAsync(true);  // 文字の作成はワーカースレッドで行い、描画を止めない
+	startupRecords.push_back({ "(font)", 0, ElapsedMs(fontBegin) });
 
-	// window \
+	ReportStartup(startupRecords, ElapsedMs(initBegin), loader.threadCount());
+
+	// window を表示
 	ShowWindow(hWnd, SW_SHOW);
 }
 
-// \[X̉
+// リソースの解放
 void CleanUp(HINSTANCE hInstance)
 {
 	if (hWnd) {
-		ShowWindow(hWnd, SW_HIDE); // window \
+		ShowWindow(hWnd, SW_HIDE); // window を非表示
 	}
 
 	font.reset();
+	stateCache.reset();
 
 	backBuffer.Reset();
 	renderTargetView.Reset();
@@ -557,11 +1043,18 @@ void CleanUp(HINSTANCE hInstance)
 	srvBullet.Reset();
 	inputLayout.Reset();
 	vertexShader.Reset();
+	instancedInputLayout.Reset();
+	instancedVertexShader.Reset();
 	vsCBuffer.Reset();
+	vsScreenCBuffer.Reset();
 	pixelShader.Reset();
-	psCBuffer.Reset();
+	textPixelShader.Reset();
+	sdfTextPixelShader.Reset();
 	psSamplerState.Reset();
+	textSamplerState.Reset();
 	vertexBuffer.Reset();
+	indexBuffer.Reset();
+	instanceBuffer.Reset();
 	rasterizerState.Reset();
 	blendState.Reset();
 
@@ -569,117 +1062,608 @@ void CleanUp(HINSTANCE hInstance)
 	swapChain.Reset();
 	device.Reset();
 
+	stageTimeline = dxstg::StageTimeline(); // パックのページを指しているので先に
+	assetPack = dxstg::AssetPack();
+
 	if (hWnd) {
 		DestroyWindow(hWnd);
 	}
 	UnregisterClassW(wndclassName, hInstance);
 }
 
-//  x, y Ƃĕ`
-void DrawString(float x, float y, _In_z_ const wchar_t *str)
+// RenderQueue のマテリアル
+// 描画するときのシェーダー・定数バッファ・サンプラーの組み合わせ
+enum class Material : std::uint8_t {
+	SPRITE, // ゲームオブジェクト (カメラの座標系)
+	TEXT    // 文字 (スクリーン座標系)
+};
+
+// RenderQueue の層
+// ゲームオブジェクトは StgObject::Layer の順で、文字はその上に描画する
+std::uint8_t ObjectLayer(dxstg::StgObject::Layer layer)
+{
+	return static_cast<std::uint8_t>(layer);
+}
+constexpr std::uint8_t HudLayer = 0xff;
+
+// 左上を x, y として文字列を描画する (renderQueue に追加する)
+// scale はフォントの基準の大きさに対する倍率
+void DrawString(float x, float y, _In_z_ const wchar_t *str, float scale = 1.f, const dxstg::Color& color = dxstg::Color())
 {
 	const float x0 = x;
 	for (; *str != L'\0'; ++str) {
 		if (*str == L'\n') {
 			x = x0;
-			y += font->getTextMetric().tmHeight;
+			y += font->getTextMetric().tmHeight * scale;
 		} else {
 			const auto& glyph = (*font)[*str];
 
-			if (!iswspace(*str)) {
-				// _Wݒ
-				// Ql: http://marupeke296.com/WINT_GetGlyphOutline.html
+			// 空白文字と作成待ちの文字はテクスチャがない
+			if (glyph.shaderResourceView) {
+				// 頂点座標を設定
+				// 参考: http://marupeke296.com/WINT_GetGlyphOutline.html
+				dxstg::RenderQueue::Sprite sprite;
+				sprite.x0 = x + glyph.glyphmetrics.gmptGlyphOrigin.x * scale;
+				sprite.y0 = y + (font->getTextMetric().tmAscent - glyph.glyphmetrics.gmptGlyphOrigin.y) * scale;
+				sprite.x1 = sprite.x0 + glyph.glyphmetrics.gmBlackBoxX * scale;
+				sprite.y1 = sprite.y0 + glyph.glyphmetrics.gmBlackBoxY * scale;
+				sprite.u0 = 0.f; sprite.v0 = 0.f;
+				sprite.u1 = 1.f; sprite.v1 = 1.f;
+				sprite.color = color;
+				sprite.texture = glyph.shaderResourceView.Get();
+				sprite.layer = HudLayer;
+				sprite.material = static_cast<std::uint8_t>(Material::TEXT);
+				renderQueue.push(sprite);
+			}
+
+			x += glyph.glyphmetrics.gmCellIncX * scale;
+		}
+	}
+}
+
+// ゲームオブジェクトを描画する (renderQueue に追加する)
+void DrawObject(const dxstg::RenderSprite& obj)
+{
+	dxstg::RenderQueue::Sprite sprite;
+	sprite.x0 = obj.x0; sprite.y0 = obj.y0;
+	sprite.x1 = obj.x1; sprite.y1 = obj.y1;
+	sprite.u0 = obj.u0; sprite.v0 = obj.v0;
+	sprite.u1 = obj.u1; sprite.v1 = obj.v1;
+	sprite.color = obj.color;
+
+	// テクスチャを設定
+	sprite.texture = nullptr;
+	switch (obj.texture) {
+		case dxstg::StgObject::TextureID::XCHU:
+			sprite.texture = srvXchu.Get();
+			break;
+		case dxstg::StgObject::TextureID::BULLET:
+			sprite.texture = srvBullet.Get();
+			break;
+	}
 
-				D3D11_MAPPED_SUBRESOURCE subresource;
-				immediateContext->Map(vertexBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &subresource);
+	sprite.layer = ObjectLayer(obj.layer);
+	sprite.material = static_cast<std::uint8_t>(Material::SPRITE);
+	renderQueue.push(sprite);
+}
 
-				float xtemp = x + glyph.glyphmetrics.gmptGlyphOrigin.x;
-				float ytemp = y + font->getTextMetric().tmAscent - glyph.glyphmetrics.gmptGlyphOrigin.y;
+// マテリアルに合わせてシェーダーなどを設定
+void SetMaterial(Material material)
+{
+	using dxstg::FontTextureMap;
+
+	switch (material) {
+		case Material::SPRITE:
+			// カメラの行列は変わらないので、書き込むのは最初のフレームだけ
+			stateCache->setVSConstantBuffer(0, vsCBuffer.Get());
+			stateCache->updateConstantBuffer(vsCBuffer.Get(), cameraVSConstants);
+			stateCache->setPixelShader(pixelShader.Get());
+			stateCache->setPSSampler(0, psSamplerState.Get());
+			break;
 
-				auto vertexes = (Vertex*)subresource.pData;
-				vertexes[0].x = xtemp;                                  vertexes[0].y = ytemp;
-				vertexes[1].x = xtemp + glyph.glyphmetrics.gmBlackBoxX; vertexes[1].y = ytemp;
-				vertexes[2].x = xtemp;                                  vertexes[2].y = ytemp + glyph.glyphmetrics.gmBlackBoxY;
-				vertexes[3].x = xtemp + glyph.glyphmetrics.gmBlackBoxX; vertexes[3].y = ytemp + glyph.glyphmetrics.gmBlackBoxY;
+		case Material::TEXT:
+			// スクリーン座標系に設定 (定数バッファを切り替えるだけ)
+			stateCache->setVSConstantBuffer(0, vsScreenCBuffer.Get());
+			stateCache->updateConstantBuffer(vsScreenCBuffer.Get(), screenVSConstants);
 
-				for (int i = 0; i < 4; ++i) {
-					vertexes[i].z = 0.f;
-				}
+			// 文字用のシェーダーを設定
+			switch (font->getFormat()) {
+				case FontTextureMap::Format::R8G8B8A8:
+					stateCache->setPixelShader(pixelShader.Get());
+					stateCache->setPSSampler(0, psSamplerState.Get());
+					break;
+				case FontTextureMap::Format::R8:
+					stateCache->setPixelShader(textPixelShader.Get());
+					stateCache->setPSSampler(0, psSamplerState.Get());
+					break;
+				case FontTextureMap::Format::SDF8:
+					stateCache->setPixelShader(sdfTextPixelShader.Get());
+					stateCache->setPSSampler(0, textSamplerState.Get());
+					break;
+			}
+			break;
+	}
+}
+
+// マテリアルの頂点の詰め方
+const dxstg::SpriteEncoding& MaterialEncoding(Material material)
+{
+	return (material == Material::TEXT) ? screenVSConstants.encoding : cameraVSConstants.encoding;
+}
+
+// 描画方法に合わせて入力アセンブラーと頂点シェーダーを設定する
+void SetSpritePath(SpritePath path)
+{
+	if (path == SpritePath::INSTANCED) {
+		UINT strides[1] = { sizeof(dxstg::SpriteInstance) };
+		UINT offsets[1] = { 0 };
+		immediateContext->IASetVertexBuffers(0, 1, instanceBuffer.GetAddressOf(), strides, offsets);
+		immediateContext->IASetInputLayout(instancedInputLayout.Get());
+		immediateContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+		stateCache->setVertexShader(instancedVertexShader.Get());
+	} else {
+		UINT strides[1] = { sizeof(dxstg::SpriteVertex) };
+		UINT offsets[1] = { 0 };
+		immediateContext->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), strides, offsets);
+		immediateContext->IASetInputLayout(inputLayout.Get());
+		immediateContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		stateCache->setVertexShader(vertexShader.Get());
+	}
+}
+
+// リングバッファとして使う動的バッファを、スプライト count 枚ぶん書き込めるように Map する
+// 残りに入らなければ、GPU が使っている途中のバッファは捨てて先頭から書く。
+// cursor は書き込む位置 (スプライトの番号) になる。Unmap と cursor を進めるのは呼び出し側で行う
+void* MapSpriteBuffer(ID3D11Buffer* buffer, UINT& cursor, UINT count)
+{
+	D3D11_MAP mapType = D3D11_MAP_WRITE_NO_OVERWRITE;
+	if (cursor + count > SpriteBufferCapacity) {
+		cursor = 0;
+		mapType = D3D11_MAP_WRITE_DISCARD;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE subresource;
+	dxstg::ThrowIfFailed(L"Map (sprite buffer)",
+		immediateContext->Map(buffer, 0, mapType, 0, &subresource));
+	return subresource.pData;
+}
 
-				vertexes[0].u = 0.f; vertexes[0].v = 0.f;
-				vertexes[1].u = 1.f; vertexes[1].v = 0.f;
-				vertexes[2].u = 0.f; vertexes[2].v = 1.f;
-				vertexes[3].u = 1.f; vertexes[3].v = 1.f;
+// renderQueue を並べ替えて描画する
+void FlushRenderQueue()
+{
+	using namespace dxstg;
+
+	renderQueue.sort();
+	spriteUploadStats = SpriteUploadStats();
+
+	const SpritePath path = spritePath;
+	SetSpritePath(path);
+
+	size_t i = 0;
+	while (i < renderQueue.size()) {
+		const auto& first = renderQueue.sorted(i);
+		const auto material = static_cast<Material>(first.material);
+		SetMaterial(material);
 
-				immediateContext->Unmap(vertexBuffer.Get(), 0);
+		// テクスチャを設定 (前と同じなら設定しない)
+		stateCache->setPSShaderResource(0, first.texture);
 
-				// eNX`ݒ
-				immediateContext->PSSetShaderResources(0, 1, glyph.shaderResourceView.GetAddressOf());
+		// 同じマテリアル・テクスチャが続く範囲を1回で描画する
+		size_t end = i + 1;
+		while (end < renderQueue.size() && end - i < SpriteBufferCapacity
+			&& renderQueue.sorted(end).material == first.material
+			&& renderQueue.sorted(end).texture == first.texture) {
+			++end;
+		}
+		const UINT count = static_cast<UINT>(end - i);
+
+		// 書き込んで描画
+		const SpriteEncoding& encoding = MaterialEncoding(material);
+		if (path == SpritePath::INSTANCED) {
+			void* mapped = MapSpriteBuffer(instanceBuffer.Get(), instanceBufferCursor, count);
+			auto instances = static_cast<SpriteInstance*>(mapped) + instanceBufferCursor;
+			for (size_t s = i; s < end; ++s) {
+				PackSpriteInstance(renderQueue.sorted(s), encoding, *instances++);
+			}
+			immediateContext->Unmap(instanceBuffer.Get(), 0);
 
-				// `
-				immediateContext->Draw(4, 0);
+			immediateContext->DrawInstanced(4, count, 0, instanceBufferCursor);
+			instanceBufferCursor += count;
+			spriteUploadStats.bytes += count * sizeof(SpriteInstance);
+		} else {
+			void* mapped = MapSpriteBuffer(vertexBuffer.Get(), vertexBufferCursor, count);
+			auto vertexes = static_cast<SpriteVertex*>(mapped) + vertexBufferCursor * 4;
+			for (size_t s = i; s < end; ++s, vertexes += 4) {
+				PackSpriteVertices(renderQueue.sorted(s), encoding, vertexes);
 			}
+			immediateContext->Unmap(vertexBuffer.Get(), 0);
 
-			x += glyph.glyphmetrics.gmCellIncX;
+			immediateContext->DrawIndexed(count * 6, 0, vertexBufferCursor * 4);
+			vertexBufferCursor += count;
+			spriteUploadStats.bytes += count * 4 * sizeof(SpriteVertex);
 		}
+
+		spriteUploadStats.sprites += count;
+		spriteUploadStats.batches += 1;
+		i = end;
 	}
+
+	renderQueue.clear();
 }
 
-} // end unnamed namespace
+// ゲームを1ティック進めて、描画内容を list に書く
+// 1ティックの間だけ使うものは arena から取る
+void SimulationTick(dxstg::World& world, dxstg::RenderList& list, dxstg::FrameArena& arena)
+{
+	using namespace dxstg;
 
+	const auto begin = std::chrono::steady_clock::now();
+
+	// 負荷試験: 画面のあちこちにパーティクルを足す
+	if (particleStress.load(std::memory_order_relaxed)) {
+		static std::mt19937 random(1);
+		std::uniform_real_distribution<float> x(visibleWorldRect.minX, visibleWorldRect.maxX);
+		std::uniform_real_distribution<float> y(visibleWorldRect.minY, visibleWorldRect.maxY);
+		ParticleBurst burst;
+		burst.count = 256;
+		burst.lifetime = 60;
+		burst.halfSize = 0.03f;
+		burst.rgb = 0xffc080;
+		while (world.particles().size() + burst.count <= particleStressCount) {
+			burst.position = { x(random), y(random) };
+			world.emitParticles(burst);
+		}
+	}
 
-namespace dxstg {
+	world.step({ _inputTracker.down(), _inputTracker.pressed(), _inputTracker.released() });
+
+	// 描画内容を作る (カメラに映らないものは入れない)
+	list.clear();
+	world.collectSprites(list, visibleWorldRect);
+
+	list.tickMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+	const WorldTickStats& stats = world.lastStats();
+	engineMetrics.players.set(static_cast<double>(world.objectCount(StgObject::Type::PLAYER)));
+	engineMetrics.enemies.set(static_cast<double>(world.objectCount(StgObject::Type::ENEMY)));
+	engineMetrics.enemyBullets.set(static_cast<double>(world.enemyBulletCount()));
+	engineMetrics.particles.set(static_cast<double>(world.particles().size()));
+	engineMetrics.spawned.set(world.totalSpawnedCount());
+	engineMetrics.removed.set(world.totalRemovedCount());
+	engineMetrics.ticks.set(world.tick());
+	engineMetrics.simTick.observe(list.tickMs / 1000);
+	engineMetrics.collisionDetect.observe(stats.detectMs / 1000);
+	engineMetrics.collisionResolve.observe(stats.resolveMs / 1000);
+	engineMetrics.particleUpdate.observe(stats.particleUpdateMs / 1000);
+	engineMetrics.simArenaPeakBytes.set(static_cast<double>(arena.highWater()));
+	engineMetrics.simArenaOverflows.set(arena.overflowCount());
+
+	// HUD の文字列はこのティックのアリーナに作る (ヒープから取らない)
+	ArenaTextWriter buf(arena.current());
+	buf << L"objects: " << list.objectCount << L", culled: " << list.culledCount << L", retired: " << list.totalRetiredCount << L"\n";
+	buf << L"sim: tick " << list.tick << L", " << list.tickMs << L" ms" << L"\n";
+	buf << L"collision: " << stats.contactCount << L" contacts, detect " << stats.detectMs
+		<< L" ms, resolve " << stats.resolveMs << L" ms, " << stats.collisionThreads << L" threads" << L"\n";
+	buf << L"bullets: " << world.enemyBulletCount() << L" x " << EnemyBullet::Storage::bytesPerEntity() << L" B" << L"\n";
+	buf << L"particles (F3): " << world.particles().size() << L" / " << world.particles().capacity() << L", update " << stats.particleUpdateMs
+		<< L" ms, dropped " << world.particles().droppedCount() << L"\n";
+	buf << L"timers: " << world.pendingTimerCount() << L" pending, " << stats.firedTimerCount << L" fired" << L"\n";
+	if (stageTimeline) {
+		const StageCursor& stage = world.stageCursor();
+		buf << L"stage: " << stage.position() << L" / " << stageTimeline.size() << L" records, tick " << list.tick << L" / " << stageTimeline.lastTick()
+			<< (world.isStageFinished() ? L" (finished)" : L"") << L", rejected " << stage.rejectedCount() << L"\n";
+	}
+	const LatencyHistogram& latency = _inputTracker.latency();
+	buf << L"input: " << latency.count() << L" events, p50 " << latency.percentileMs(0.5) << L" ms, p99 " << latency.percentileMs(0.99)
+		<< L" ms, max " << latency.maxMs() << L" ms, dropped " << _droppedInputEvents.load(std::memory_order_relaxed) << L"\n";
+	buf << L"arena (sim): peak " << arena.highWater() / 1024.0 << L" / " << arena.capacityPerFrame() / 1024 << L" KB, overflow " << arena.overflowCount() << L"\n";
+	buf << L"日本語も書けるよ。";
+	list.hudText.assign(buf.data(), buf.size()); // list の文字列は確保した領域を使い回す
+}
 
-void AddObject(std::unique_ptr<StgObject>&& newObject)
+// オブジェクトの種類ごとの1つあたりの大きさをデバッグ出力に書き出す
+// StgObject は本体とそれを指す SlotMap の要素の分 (ヒープの管理領域は含まない)
+void ReportObjectFootprint()
 {
-	_objects.emplace_back(std::move(newObject));
+	using namespace dxstg;
+	using ObjectMap = World::ObjectMap;
+
+	std::wostringstream buf;
+	buf << L"object footprint (bytes per object):\n";
+	buf << L"  Player:      " << sizeof(Player) + ObjectMap::bytesPerElement() << L"\n";
+	buf << L"  Enemy:       " << sizeof(Enemy) + ObjectMap::bytesPerElement() << L"\n";
+	buf << L"  EnemyBullet: " << EnemyBullet::Storage::bytesPerEntity()
+		<< L" (components " << EnemyBullet::Storage::componentBytes() << L")\n";
+	OutputDebugStringW(buf.str().c_str());
 }
 
-Player* GetPlayer()
+// フレームアリーナの使われ方をデバッグ出力に書き出す (容量を決める目安)
+void ReportFrameArena(const wchar_t* name, const dxstg::FrameArena& arena)
 {
-	return _player;
+	std::wostringstream buf;
+	buf << L"frame arena (" << name << L"): peak " << arena.highWater() << L" / " << arena.capacityPerFrame()
+		<< L" bytes, overflow " << arena.overflowCount() << L"\n";
+	OutputDebugStringW(buf.str().c_str());
 }
 
-void SetPlayer(Player* p)
+// 入力の遅延の分布を書く
+void WriteInputLatency(std::wostream& buf, const dxstg::LatencyHistogram& latency)
 {
-	_player = p;
+	using dxstg::LatencyHistogram;
+
+	buf << L"input latency: " << latency.count() << L" events, mean " << latency.meanMs() << L" ms, p50 " << latency.percentileMs(0.5)
+		<< L" ms, p99 " << latency.percentileMs(0.99) << L" ms, max " << latency.maxMs() << L" ms\n";
+	for (int i = 0; i < LatencyHistogram::BucketCount; ++i) {
+		if (latency.bucket(i) != 0) {
+			buf << L"  < " << LatencyHistogram::bucketUpperMs(i) << L" ms: " << latency.bucket(i) << L"\n";
+		}
+	}
 }
 
-Input GetInput()
+// 入力の遅延の分布をデバッグ出力に書き出す
+void ReportInputLatency(const dxstg::LatencyHistogram& latency)
 {
-	return _input;
+	std::wostringstream buf;
+	WriteInputLatency(buf, latency);
+	OutputDebugStringW(buf.str().c_str());
 }
 
-} // end dxstg
+// シミュレーションスレッドの本体
+void SimulationMain()
+{
+	try {
+		ReportObjectFootprint();
+
+		// 衝突判定のワーカー (シミュレーションスレッドも1つ受け持つので、1つ少なく)
+		const unsigned hardwareThreads = std::thread::hardware_concurrency();
+		dxstg::ThreadPool collisionWorkers(hardwareThreads > 2 ? hardwareThreads - 1 : 1);
+
+		// ゲームの状態はすべて World が持つ
+		dxstg::World world(MakeWorldSettings(), &collisionWorkers);
+		world.populate();
+
+		dxstg::FrameArena simArena(frameArenaCapacity);
+		std::uint32_t seenDroppedInputEvents = 0;
+
+		auto next = std::chrono::steady_clock::now();
+		while (!simulationQuit.load(std::memory_order_acquire)) {
+			const auto now = std::chrono::steady_clock::now();
+			if (now < next) {
+				std::this_thread::sleep_until(next);
+				continue;
+			}
+
+			// 遅れていたら追いつくまで続けて進める (止まっていたときは諦める)
+			if (now - next > simulationTickPeriod * maxCatchUpTicks) {
+				next = now;
+			}
+			next += simulationTickPeriod;
+
+			// ティックの最初に、それまでのキー入力をすべて取り出す
+			_inputTracker.beginTick(_inputEvents, dxstg::InputClockNow());
+			// 捨てたイベントがあったら、押しているキーを WndProc から見たものに合わせる
+			const std::uint32_t droppedInputEvents = _droppedInputEvents.load(std::memory_order_acquire);
+			if (droppedInputEvents != seenDroppedInputEvents) {
+				seenDroppedInputEvents = droppedInputEvents;
+				_inputTracker.resync(dxstg::InputFromKeyMask(_heldKeys.load(std::memory_order_acquire)));
+			}
+
+			SimulationTick(world, renderLists.back(), simArena);
+			renderLists.publish();
+			simArena.endFrame();
+		}
+
+		ReportInputLatency(_inputTracker.latency());
+		ReportFrameArena(L"sim", simArena);
+	} catch (...) {
+		OutputDebugStringW(L"failed: simulation thread\n");
+		PostMessage(hWnd, WM_CLOSE, 0, 0);
+	}
+}
+
+void StartSimulation()
+{
+	simulationQuit.store(false, std::memory_order_release);
+	simulationThread = std::thread(SimulationMain);
+}
+
+void StopSimulation()
+{
+	simulationQuit.store(true, std::memory_order_release);
+	if (simulationThread.joinable()) {
+		simulationThread.join();
+	}
+}
+
+constexpr std::uint64_t batchChunkTicks = 60; // バッチモードでメトリクスを更新する間隔
+
+// バッチモードのメトリクス (すべての World の合計)
+void PublishBatchMetrics(const std::vector<std::unique_ptr<dxstg::World>>& worlds, const dxstg::WorldBatchResult& chunk)
+{
+	size_t players = 0, enemies = 0, bullets = 0;
+	std::uint64_t spawned = 0, removed = 0, ticks = 0;
+	for (const auto& world : worlds) {
+		players += world->objectCount(dxstg::StgObject::Type::PLAYER);
+		enemies += world->objectCount(dxstg::StgObject::Type::ENEMY);
+		bullets += world->enemyBulletCount();
+		spawned += world->totalSpawnedCount();
+		removed += world->totalRemovedCount();
+		ticks += world->tick();
+	}
+	engineMetrics.players.set(static_cast<double>(players));
+	engineMetrics.enemies.set(static_cast<double>(enemies));
+	engineMetrics.enemyBullets.set(static_cast<double>(bullets));
+	engineMetrics.spawned.set(spawned);
+	engineMetrics.removed.set(removed);
+	engineMetrics.ticks.set(ticks);
+	engineMetrics.batchChunk.observe(chunk.seconds);
+	engineMetrics.batchWorldTicksPerSecond.set(chunk.worldTicksPerSecond());
+}
+
+// ウィンドウを出さずに、たくさんの World をボットの入力で進めて速さを測る (バランス調整用)
+// 結果はデバッグ出力と標準出力に書く
+void RunBatchMode(size_t worldCount, std::uint64_t ticks)
+{
+	using namespace dxstg;
+
+	// すべての World で同じステージを読む
+	assetPack = AssetPack(L"data/assets.pak");
+	OpenStage();
+
+	ThreadPool pool;
+	std::vector<std::unique_ptr<World>> worlds;
+	std::vector<WorldController> controllers;
+	WorldSettings settings = MakeWorldSettings();
+	settings.particleCapacity = 0; // 見た目だけなので出さない
+	for (size_t i = 0; i < worldCount; ++i) {
+		worlds.push_back(std::make_unique<World>(settings));
+		worlds.back()->populate();
+		controllers.push_back(MakeRandomBot(static_cast<std::uint32_t>(i + 1)));
+	}
+
+	engineMetrics.batchWorlds.set(static_cast<double>(worldCount));
+
+	// メトリクスを途中でも見られるように、少しずつ進める
+	WorldBatchResult result;
+	for (std::uint64_t done = 0; done < ticks; ) {
+		const std::uint64_t chunk = std::min<std::uint64_t>(batchChunkTicks, ticks - done);
+		const WorldBatchResult chunkResult = RunWorldBatch(pool, worlds, controllers, chunk);
+		done += chunk;
+		result.worldCount = chunkResult.worldCount;
+		result.worldTicks += chunkResult.worldTicks;
+		result.seconds += chunkResult.seconds;
+		result.survivorCount = chunkResult.survivorCount;
+		result.inputLatency.merge(chunkResult.inputLatency);
+		PublishBatchMetrics(worlds, chunkResult);
+	}
+
+	// 1つの World が実時間の何倍で進んだか
+	const double simulatedSeconds = ticks * std::chrono::duration<double>(simulationTickPeriod).count();
+	const double realTimeRatio = result.seconds > 0 ? simulatedSeconds / result.seconds : 0.0;
+	std::wostringstream buf;
+	buf << L"batch: " << result.worldCount << L" worlds x " << ticks << L" ticks on " << pool.threadCount() << L" threads, " << result.seconds << L" s\n";
+	buf << L"  " << result.worldTicksPerSecond() << L" world-ticks/s, " << realTimeRatio << L"x real time per world\n";
+	buf << L"  " << result.survivorCount << L" / " << result.worldCount << L" players survived\n";
+	WriteInputLatency(buf, result.inputLatency);
+	OutputDebugStringW(buf.str().c_str());
+	std::wcout << buf.str();
+}
+
+// コマンドラインの引数
+//   -batch [World の数] [ティック数]  ウィンドウを出さずにバッチモードで進める
+//   -metrics-port <ポート>            127.0.0.1:<ポート>/metrics でメトリクスを出す
+//   -metrics-file <パス>              メトリクスを1秒ごとにファイルに書き出す (パスに空白は使えない)
+struct CommandLine {
+	bool batch = false;
+	size_t worldCount = 256;
+	std::uint64_t ticks = 60 * 60;
+	std::uint16_t metricsPort = 0; // 0 なら HTTP で出さない
+	std::wstring metricsFile;      // 空ならファイルに出さない
+};
+
+bool ParseNumber(const std::wstring& text, std::uint64_t& value)
+{
+	if (text.empty() || !iswdigit(text[0])) return false;
+	wchar_t* end = nullptr;
+	value = std::wcstoull(text.c_str(), &end, 10);
+	return *end == L'\0';
+}
+
+CommandLine ParseCommandLine(const wchar_t* commandLine)
+{
+	std::wistringstream args(commandLine);
+	std::vector<std::wstring> words;
+	std::wstring word;
+	while (args >> word) {
+		words.push_back(word);
+	}
+
+	CommandLine result;
+	for (size_t i = 0; i < words.size(); ++i) {
+		std::uint64_t number;
+		if (words[i] == L"-batch") {
+			result.batch = true;
+			if (i + 1 < words.size() && ParseNumber(words[i + 1], number)) {
+				result.worldCount = static_cast<size_t>(number);
+				++i;
+				if (i + 1 < words.size() && ParseNumber(words[i + 1], number)) {
+					result.ticks = number;
+					++i;
+				}
+			}
+		} else if (words[i] == L"-metrics-port" && i + 1 < words.size() && ParseNumber(words[i + 1], number) && number <= 0xffff) {
+			result.metricsPort = static_cast<std::uint16_t>(number);
+			++i;
+		} else if (words[i] == L"-metrics-file" && i + 1 < words.size()) {
+			result.metricsFile = words[++i];
+		} else {
+			OutputDebugStringW((L"unknown option: " + words[i] + L"\n").c_str());
+		}
+	}
+	return result;
+}
+
+// メトリクスのエクスポーターを動かす (どちらも指定されていなければ nullptr)
+std::unique_ptr<dxstg::MetricsExporter> StartMetrics(const CommandLine& commandLine)
+{
+	if (commandLine.metricsPort == 0 && commandLine.metricsFile.empty()) return nullptr;
+
+	auto exporter = std::make_unique<dxstg::MetricsExporter>(WriteEngineMetrics);
+	if (commandLine.metricsPort != 0 && exporter->serveHttp(commandLine.metricsPort)) {
+		std::wostringstream buf;
+		buf << L"metrics: http://127.0.0.1:" << commandLine.metricsPort << L"/metrics\n";
+		OutputDebugStringW(buf.str().c_str());
+	}
+	if (!commandLine.metricsFile.empty()) {
+		exporter->writeFile(commandLine.metricsFile, metricsFileInterval);
+	}
+	return exporter;
+}
+
+} // end unnamed namespace
+
 
 
 int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdLine, int nCmdShow)
 {
 	using namespace dxstg;
 
+	const CommandLine commandLine = ParseCommandLine(lpCmdLine);
+	const std::unique_ptr<MetricsExporter> metrics = StartMetrics(commandLine);
+
+	if (commandLine.batch) {
+		try {
+			RunBatchMode(commandLine.worldCount, commandLine.ticks);
+		} catch (...) {
+			OutputDebugStringW(L"failed: batch mode\n");
+			return 1;
+		}
+		if (metrics) metrics->writeFileNow(); // 最後の値
+		return 0;
+	}
+
 	try {
 		ThrowIfFailed(L"CoInitialize",
-			CoInitialize(nullptr));  // eNX`̓ǂݍ݂COM̂߁AĂяoKvB
+			CoInitialize(nullptr));  // テクスチャの読み込みがCOMのため、これを呼び出す必要がある。
 
-		OutputDebugString(_T("ɂ[\n"));
+		OutputDebugString(_T("こんにちわーるど\n"));
 
-		Init(hInstance);  // \[X
+		Init(hInstance);  // リソース初期化
 
-		// Q[IuWFNg̒ǉ
-		{
-			auto player = std::make_unique<Player>();
-			SetPlayer(player.get());
-			AddObject(std::move(player));
-			AddObject(std::make_unique<Enemy>(3.f, 0.f));
-		}
+		// ゲームはシミュレーションスレッドで進める
+		StartSimulation();
+
+		// 1フレームの間だけ使うメモリ (描画スレッド用)
+		FrameArena renderArena(frameArenaCapacity);
 
-		//C[v
+		//メインループ (描画)
 		double frameTime = 0.f;
+		StateCacheStats stateStats;  // 前のフレームの stateCache の統計
 		auto begin = std::chrono::high_resolution_clock::now();
 		MSG hMsg;
 		while (true) {
-			// EBhEbZ[W
-			// ̒ŃL[{[h͏XV
+			// ウィンドウメッセージ処理
+			// この中でキーボード入力情報も更新される
 			while (PeekMessageW(&hMsg, NULL, 0, 0, PM_REMOVE)) {
 				if (hMsg.message == WM_QUIT) {
 					goto End;
@@ -688,156 +1672,86 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdLi
 				DispatchMessage(&hMsg);
 			}
 
-			// ʂ̃NA
-			float clearColor[] = { 0.1f, 0.3f, 0.5f, 1.0f };
-			immediateContext->ClearRenderTargetView(renderTargetView.Get(), clearColor);
-
-			// XV
-			for (const auto& obj : _objects) {
-				obj->update();
-			}
-
-			// 폜\vf̍폜
-			{
-				auto it = std::remove_if(_objects.begin(), _objects.end(),
-					[](const auto& obj) { return obj->removable; });
-				_objects.erase(it, _objects.end());
-			}
-
-			// Փ˔̎{
-			for (auto it1 = _objects.begin(); it1 != _objects.end(); ++it1) {
-				auto it2 = it1;
-				++it2;
-				for (; it2 != _objects.end(); ++it2) {
-					if ((*it1)->getHitRect().intersects((*it2)->getHitRect())) {
-						(*it1)->hit(**it2);
-						(*it2)->hit(**it1);
-					}
-				}
-			}
-
-			// 폜\vf̍폜
-			{
-				auto it = std::remove_if(_objects.begin(), _objects.end(),
-					[](const auto& obj) { return obj->removable; });
-				_objects.erase(it, _objects.end());
-			}
-
-			// _O
+			// ワーカースレッドで作成された文字をテクスチャにする
+			font->upload();
 
-			// J̔zu
-			{
-				using namespace DirectX;
-				XMMATRIX viewProj
-					= XMMatrixLookAtLH(XMVectorSet(0, 0, -8, 1), XMVectorSet(0, 0, 0, 1), XMVectorSet(0, 1, 0, 1))
-					* XMMatrixPerspectiveFovLH(XMConvertToRadians(45), (float)clientWidth / clientHeight, 0.1f, 100.f);
-
-				D3D11_MAPPED_SUBRESOURCE subresource;
-				immediateContext->Map(vsCBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &subresource);
-				XMStoreFloat4x4((XMFLOAT4X4*)subresource.pData, XMMatrixTranspose(viewProj));  // s͓]u܂B
-				immediateContext->Unmap(vsCBuffer.Get(), 0);
-			}
+			stateStats = stateCache->getStats();
+			stateCache->resetStats();
 
-			// IuWFNg̕`
-			for (const auto& obj : _objects) {
-				// _Wݒ
-				{
-					D3D11_MAPPED_SUBRESOURCE subresource;
-					immediateContext->Map(vertexBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &subresource);
-
-					auto vertexes = (Vertex*)subresource.pData;
-					vertexes[0].x = obj->getDrawRect().maxX; vertexes[0].y = obj->getDrawRect().maxY;
-					vertexes[1].x = obj->getDrawRect().minX; vertexes[1].y = obj->getDrawRect().maxY;
-					vertexes[2].x = obj->getDrawRect().maxX; vertexes[2].y = obj->getDrawRect().minY;
-					vertexes[3].x = obj->getDrawRect().minX; vertexes[3].y = obj->getDrawRect().minY;
-
-					for (int i = 0; i < 4; ++i) {
-						vertexes[i].z = 0.f;
-					}
-
-					vertexes[0].u = obj->isMirrorX() ? 0.f : 1.f; vertexes[0].v = obj->isMirrorY() ? 1.f : 0.f;
-					vertexes[1].u = obj->isMirrorX() ? 1.f : 0.f; vertexes[1].v = obj->isMirrorY() ? 1.f : 0.f;
-					vertexes[2].u = obj->isMirrorX() ? 0.f : 1.f; vertexes[2].v = obj->isMirrorY() ? 0.f : 1.f;
-					vertexes[3].u = obj->isMirrorX() ? 1.f : 0.f; vertexes[3].v = obj->isMirrorY() ? 0.f : 1.f;
-
-					immediateContext->Unmap(vertexBuffer.Get(), 0);
-				}
-
-				// Fݒ
-				{
-					D3D11_MAPPED_SUBRESOURCE subresource;
-					immediateContext->Map(psCBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &subresource);
-					*reinterpret_cast<Color*>(subresource.pData) = obj->getColor();
-					immediateContext->Unmap(psCBuffer.Get(), 0);
-				}
+			// シミュレーションスレッドが公開した最新の描画内容を受け取る
+			// 新しいものがなければ前と同じものを描画する
+			renderLists.update();
+			const RenderList& renderList = renderLists.front();
+			const auto buildBegin = std::chrono::steady_clock::now();
 
-				// eNX`ݒ
-				ComPtr<ID3D11ShaderResourceView> selectedSrv;
-				switch (obj->getTextureID()) {
-					case StgObject::TextureID::XCHU:
-						selectedSrv = srvXchu;
-						break;
-					case StgObject::TextureID::BULLET:
-						selectedSrv = srvBullet;
-						break;
-				}
-				immediateContext->PSSetShaderResources(0, 1, selectedSrv.GetAddressOf());
+			// 画面のクリア
+			float clearColor[] = { 0.1f, 0.3f, 0.5f, 1.0f };
+			immediateContext->ClearRenderTargetView(renderTargetView.Get(), clearColor);
 
-				// `
-				immediateContext->Draw(4, 0);
-			}
+			// レンダリング
+			// 描画要求を renderQueue に集めて、層・マテリアル・テクスチャの順に並べてから描画する
 
-			// ̕`
-			// XN[Wnɐݒ
-			{
-				using namespace DirectX;
-				XMMATRIX viewProj = XMMatrixSet(
-					2 / (float)clientWidth, 0, 0, 0,
-					0, -2 / (float)clientHeight, 0, 0,
-					0, 0, 1, 0,
-					-1, 1, 0, 1
-				);
-
-				D3D11_MAPPED_SUBRESOURCE subresource;
-				immediateContext->Map(vsCBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &subresource);
-				XMStoreFloat4x4((XMFLOAT4X4*)subresource.pData, XMMatrixTranspose(viewProj));  // s͓]u܂B
-				immediateContext->Unmap(vsCBuffer.Get(), 0);
+			// オブジェクトの描画
+			for (const auto& sprite : renderList.sprites) {
+				DrawObject(sprite);
 			}
 
-			// Fݒ
+			// 文字を描画
 			{
-				D3D11_MAPPED_SUBRESOURCE subresource;
-				immediateContext->Map(psCBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &subresource);
-				*reinterpret_cast<Color*>(subresource.pData) = Color(1, 1, 1, 0.8f);
-				immediateContext->Unmap(psCBuffer.Get(), 0);
+				ArenaTextWriter buf(renderArena.current());
+				buf << L"fps: " << (1.0 / frameTime * 1000) << L"\n";
+				buf << L"font: " << font->size() << L" glyphs, " << (font->getTextureMemorySize() / 1024.0) << L" KB" << L"\n";
+				const StateCacheCounter stateTotal = stateStats.total();
+				buf << L"state: " << stateTotal.issued << L" issued, " << stateTotal.filtered << L" filtered" << L"\n";
+				buf << L"sprites (F2: " << (spritePath == SpritePath::INSTANCED ? L"instanced" : L"vertex") << L"): " << spriteUploadStats.sprites << L" in " << spriteUploadStats.batches << L" batches, "
+					<< (spriteUploadStats.bytes / 1024.0) << L" KB" << L"\n";
+				buf << L"arena (render): peak " << renderArena.highWater() / 1024.0 << L" / " << renderArena.capacityPerFrame() / 1024 << L" KB, overflow " << renderArena.overflowCount() << L"\n";
+				buf << renderList.hudText;
+
+				const float textScale = 30.f / font->getLogFont().lfHeight;  // 30ピクセル相当の大きさで描画
+				DrawString(0, 0, buf.c_str(), textScale, Color(1, 1, 1, 0.8f));
 			}
 
-			// `
-			{
-				std::wostringstream buf;
-				buf << L"fps: " << (1.0 / frameTime * 1000) << std::endl;
-				buf << L"{B";
+			const auto flushBegin = std::chrono::steady_clock::now();
+			FlushRenderQueue();
 
-				DrawString(0, 0, buf.str().c_str());
-			}
-			// \
-			// 1邱ƂŁA1񐂒ƂB
+			// 表示
+			// 第一引数に1を入れることで、1回垂直同期をとる。
+			const auto presentBegin = std::chrono::steady_clock::now();
 			swapChain->Present(1, 0);
+			const auto presentEnd = std::chrono::steady_clock::now();
 
-			// t[[ǧvZ
+			// フレームレートの計算
 			auto end = std::chrono::high_resolution_clock::now();
 			std::chrono::duration<double, std::milli> duration = end - begin;
 			frameTime = frameTime * 0.95 + duration.count() * 0.05;
 
+			engineMetrics.renderFrame.observe(duration.count() / 1000);
+			engineMetrics.renderBuild.observe(std::chrono::duration<double>(flushBegin - buildBegin).count());
+			engineMetrics.renderFlush.observe(std::chrono::duration<double>(presentBegin - flushBegin).count());
+			engineMetrics.present.observe(std::chrono::duration<double>(presentEnd - presentBegin).count());
+			engineMetrics.fontGlyphs.set(static_cast<double>(font->size()));
+			engineMetrics.fontTextureBytes.set(static_cast<double>(font->getTextureMemorySize()));
+			engineMetrics.fontPendingGlyphs.set(static_cast<double>(font->getPendingCount()));
+			engineMetrics.fontMisses.set(font->getMissCount());
+			engineMetrics.renderArenaPeakBytes.set(static_cast<double>(renderArena.highWater()));
+			engineMetrics.renderArenaOverflows.set(renderArena.overflowCount());
+
 			begin = std::move(end);
+
+			renderArena.endFrame();
 		}
 
 	End:
+		ReportFrameArena(L"render", renderArena);
+		StopSimulation();
 		CleanUp(hInstance);
 	} catch (...) {
+		StopSimulation();
 		CleanUp(hInstance);
 	}
+	if (metrics) metrics->writeFileNow(); // 最後の値
 
-	// CoUninitialize();  // ႤWICImagingFactorỷɎs
+	// CoUninitialize();  // これやっちゃうとWICImagingFactoryの解放に失敗する
 	return 0;
 }
@@ -0,0 +1,282 @@
+// AssetPackIndex (.pak の目次) と Lz4Decompress のテスト
+// 壊れたデータを開いたり展開したりしても失敗するだけで、範囲外を読み書きしないことを確かめる。
+//   AssetPackTest                                 壊れたデータのテスト
+//   AssetPackTest --pack <pak> <file>...          pack.py の出力から、すべてのファイルが元どおりに取り出せるか
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "AssetPackIndex.h"
+#include "Lz4.h"
+#include "TestCheck.h"
+
+using namespace dxstg;
+using namespace dxstg::test;
+
+namespace {
+
+using Bytes = std::vector<std::uint8_t>;
+
+constexpr std::size_t GuardSize = 16;
+constexpr std::uint8_t GuardByte = 0xcd;
+
+// ちょうど src.size() バイトの入力と、後ろに見張りを付けた dstSize バイトの出力で展開する
+// 見張りが書き換えられていたら失敗にする
+bool Decompress(const Bytes& src, std::size_t dstSize, Bytes* out = nullptr)
+{
+	const auto input = std::make_unique<std::uint8_t[]>(src.size());
+	std::copy(src.begin(), src.end(), input.get());
+	Bytes dst(dstSize + GuardSize, GuardByte);
+	const bool ok = Lz4Decompress(input.get(), src.size(), dst.data(), dstSize);
+	TEST_CHECK(std::all_of(dst.begin() + dstSize, dst.end(), [](std::uint8_t b) { return b == GuardByte; }));
+	if (out) out->assign(dst.begin(), dst.begin() + dstSize);
+	return ok;
+}
+
+Bytes Text(const char* s)
+{
+	return Bytes(s, s + std::strlen(s));
+}
+
+void TestLz4Valid()
+{
+	Bytes out;
+	// リテラルだけ
+	TEST_CHECK(Decompress({ 0x40, 'a', 'b', 'c', 'd' }, 4, &out) && out == Text("abcd"));
+	// 重なるマッチ (offset 1 で 'a' を 4 回) と最後のリテラル
+	TEST_CHECK(Decompress({ 0x10, 'a', 1, 0, 0x10, 'b' }, 6, &out) && out == Text("aaaaab"));
+	// 255 が続く長さ (リテラル 15 + 255 + 10 = 280 バイト)
+	Bytes longLiteral = { 0xf0, 255, 10 };
+	longLiteral.resize(longLiteral.size() + 280, 'x');
+	TEST_CHECK(Decompress(longLiteral, 280, &out) && out == Bytes(280, 'x'));
+	// 空
+	TEST_CHECK(Decompress({}, 0));
+	TEST_CHECK(Decompress({ 0x00 }, 0));
+}
+
+void TestLz4Broken()
+{
+	// マッチの offset が出力の先頭より前を指している
+	TEST_CHECK(!Decompress({ 0x10, 'a', 2, 0, 0x10, 'b' }, 6));
+	TEST_CHECK(!Decompress({ 0x10, 'a', 0xff, 0xff, 0x10, 'b' }, 6));
+	TEST_CHECK(!Decompress({ 0x00, 1, 0, 0x10, 'b' }, 5)); // 出力がまだ空
+	// offset 0
+	TEST_CHECK(!Decompress({ 0x10, 'a', 0, 0, 0x10, 'b' }, 6));
+	// リテラルが入力の終わりを越える
+	TEST_CHECK(!Decompress({ 0x50, 'a', 'b', 'c' }, 5));
+	TEST_CHECK(!Decompress({ 0xf0 }, 15));                     // 長さの追加バイトがない
+	TEST_CHECK(!Decompress({ 0xf0, 255, 255 }, 600));
+	// offset や マッチの長さの途中で入力が終わる
+	TEST_CHECK(!Decompress({ 0x10, 'a', 1 }, 5));
+	TEST_CHECK(!Decompress({ 0x1f, 'a', 1, 0 }, 100));
+	// 出力があふれる (リテラル、マッチ)
+	TEST_CHECK(!Decompress({ 0x40, 'a', 'b', 'c', 'd' }, 3));
+	TEST_CHECK(!Decompress({ 0x10, 'a', 1, 0, 0x10, 'b' }, 3));
+	TEST_CHECK(!Decompress({ 0x10, 'a', 1, 0, 0x10, 'b' }, 5));
+	TEST_CHECK(!Decompress({ 0x1f, 'a', 1, 0, 255, 255, 0, 0x10, 'b' }, 64));
+	// 出力が足りない
+	TEST_CHECK(!Decompress({ 0x40, 'a', 'b', 'c', 'd' }, 5));
+}
+
+// 正しいストリームの途中までや、1バイト書き換えたものを展開しても範囲外に触らない
+void TestLz4Mutations(const Bytes& stream, std::size_t originalSize)
+{
+	for (std::size_t n = 0; n < stream.size(); ++n) {
+		TEST_CHECK(!Decompress(Bytes(stream.begin(), stream.begin() + n), originalSize));
+	}
+	TestRandom random(32);
+	for (int i = 0; i < 2000 && !stream.empty(); ++i) {
+		Bytes broken = stream;
+		broken[random.next() % broken.size()] = random.nextByte();
+		Decompress(broken, originalSize); // 成功してもよいが、見張りは壊さない
+	}
+}
+
+// テスト用のパックを作る (pack.py と同じ並び)
+struct PackItem {
+	std::string name;
+	Bytes stored;
+	std::uint32_t originalSize;
+	std::uint32_t flags;
+};
+
+Bytes MakePack(const std::vector<PackItem>& items)
+{
+	const auto align16 = [](std::size_t n) { return (n + 15) / 16 * 16; };
+	std::size_t nameOffset = sizeof(AssetPackHeader) + sizeof(AssetPackEntry) * items.size();
+	std::size_t dataOffset = nameOffset;
+	for (const PackItem& item : items) dataOffset += item.name.size();
+	dataOffset = align16(dataOffset);
+
+	std::vector<AssetPackEntry> entries;
+	for (const PackItem& item : items) {
+		AssetPackEntry e = {};
+		e.nameOffset = static_cast<std::uint32_t>(nameOffset);
+		e.nameLength = static_cast<std::uint32_t>(item.name.size());
+		e.dataOffset = static_cast<std::uint32_t>(dataOffset);
+		e.storedSize = static_cast<std::uint32_t>(item.stored.size());
+		e.originalSize = item.originalSize;
+		e.flags = item.flags;
+		entries.push_back(e);
+		nameOffset += item.name.size();
+		dataOffset = align16(dataOffset + item.stored.size());
+	}
+
+	Bytes pack(dataOffset);
+	AssetPackHeader header = { { 'D', 'X', 'P', 'K' }, AssetPackVersion, static_cast<std::uint32_t>(items.size()), 0 };
+	std::memcpy(pack.data(), &header, sizeof(header));
+	for (std::size_t i = 0; i < items.size(); ++i) {
+		std::memcpy(pack.data() + sizeof(header) + sizeof(AssetPackEntry) * i, &entries[i], sizeof(AssetPackEntry));
+		std::memcpy(pack.data() + entries[i].nameOffset, items[i].name.data(), items[i].name.size());
+		std::copy(items[i].stored.begin(), items[i].stored.end(), pack.begin() + entries[i].dataOffset);
+	}
+	return pack;
+}
+
+// ちょうど pack.size() バイトのバッファで開けるか
+bool Opens(const Bytes& pack)
+{
+	const auto data = std::make_unique<std::uint8_t[]>(pack.size());
+	std::copy(pack.begin(), pack.end(), data.get());
+	const AssetPackIndex index(data.get(), pack.size());
+	return static_cast<bool>(index);
+}
+
+AssetPackEntry* EntryAt(Bytes& pack, std::size_t i)
+{
+	return reinterpret_cast<AssetPackEntry*>(pack.data() + sizeof(AssetPackHeader) + sizeof(AssetPackEntry) * i);
+}
+
+// 取り出したときに範囲外にならないパックだけが開ける
+void TestBrokenIndex()
+{
+	const std::vector<PackItem> items = {
+		{ "a.txt", Text("alpha"), 5, 0 },
+		{ "b.bin", { 0x10, 'a', 1, 0, 0x10, 'b' }, 6, AssetPackFlagLz4 },
+		{ "c.dat", Text("charlie"), 7, 0 },
+	};
+	const Bytes pack = MakePack(items);
+	TEST_CHECK(Opens(pack));
+
+	{
+		const AssetPackIndex index(pack.data(), pack.size());
+		TEST_CHECK(index.size() == 3);
+		for (const PackItem& item : items) {
+			const AssetPackEntry* e = index.find(item.name.c_str());
+			TEST_CHECK(e != nullptr);
+			if (!e) continue;
+			TEST_CHECK(std::string(index.name(*e), e->nameLength) == item.name);
+			TEST_CHECK(Bytes(index.stored(*e), index.stored(*e) + e->storedSize) == item.stored);
+		}
+		TEST_CHECK(index.find("a.tx") == nullptr && index.find("a.txtx") == nullptr && index.find("") == nullptr);
+	}
+
+	Bytes broken = pack;
+	broken[0] = 'X'; // マジック
+	TEST_CHECK(!Opens(broken));
+
+	broken = pack;
+	reinterpret_cast<AssetPackHeader*>(broken.data())->version = AssetPackVersion + 1;
+	TEST_CHECK(!Opens(broken));
+
+	// エントリーの表がファイルに収まらない
+	broken = pack;
+	reinterpret_cast<AssetPackHeader*>(broken.data())->entryCount = 0xffffffff;
+	TEST_CHECK(!Opens(broken));
+
+	// データや名前がファイルの外
+	const std::uint32_t size = static_cast<std::uint32_t>(pack.size());
+	const auto expectBroken = [&](std::size_t i, void (*edit)(AssetPackEntry&, std::uint32_t)) {
+		Bytes b = pack;
+		edit(*EntryAt(b, i), size);
+		TEST_CHECK(!Opens(b));
+	};
+	expectBroken(0, [](AssetPackEntry& e, std::uint32_t s) { e.dataOffset = s; });
+	expectBroken(2, [](AssetPackEntry& e, std::uint32_t s) { e.dataOffset = s - e.storedSize + 1; });
+	expectBroken(2, [](AssetPackEntry& e, std::uint32_t) { e.dataOffset = 0xfffffff0; e.storedSize = e.originalSize = 0x20; }); // 32ビットでは桁あふれする
+	expectBroken(1, [](AssetPackEntry& e, std::uint32_t s) { e.storedSize = s; });
+	expectBroken(0, [](AssetPackEntry& e, std::uint32_t s) { e.nameOffset = s - 2; });
+	expectBroken(0, [](AssetPackEntry& e, std::uint32_t) { e.nameLength = 0xffffffff; });
+	// 圧縮していないのに展開後の大きさが違う
+	expectBroken(0, [](AssetPackEntry& e, std::uint32_t) { e.originalSize = e.storedSize + 1; });
+
+	// 途中までしかないファイル (最後のデータの後ろの詰め物だけがないときは開ける)
+	const AssetPackIndex index(pack.data(), pack.size());
+	const AssetPackEntry& last = index.entry(index.size() - 1);
+	const std::size_t end = last.dataOffset + last.storedSize;
+	for (std::size_t n = 0; n < pack.size(); ++n) {
+		TEST_CHECK(Opens(Bytes(pack.begin(), pack.begin() + n)) == (n >= end));
+	}
+}
+
+// pack.py で作ったパックから、すべてのファイルが元どおりに取り出せるか
+void TestPackRoundTrip(const char* packPath, const std::vector<const char*>& files)
+{
+	const Bytes pack = ReadWholeFile(packPath);
+	TEST_CHECK(!pack.empty());
+	const AssetPackIndex index(pack.data(), pack.size());
+	TEST_CHECK(static_cast<bool>(index));
+	TEST_CHECK(index.size() == files.size());
+
+	for (const char* path : files) {
+		const Bytes original = ReadWholeFile(path);
+		std::string name = path;
+		const auto slash = name.find_last_of("/\\");
+		if (slash != std::string::npos) name.erase(0, slash + 1);
+
+		const AssetPackEntry* e = index.find(name.c_str());
+		TEST_CHECK(e != nullptr);
+		if (!e) continue;
+		TEST_CHECK(e->originalSize == original.size());
+		TEST_CHECK(e->dataOffset % 16 == 0);
+
+		const Bytes stored(index.stored(*e), index.stored(*e) + e->storedSize);
+		if (e->flags & AssetPackFlagLz4) {
+			Bytes out;
+			TEST_CHECK(Decompress(stored, e->originalSize, &out));
+			TEST_CHECK(out == original);
+			TestLz4Mutations(stored, e->originalSize);
+		} else {
+			TEST_CHECK(stored == original);
+		}
+		std::printf("%-24s %8u -> %8u%s\n", name.c_str(), e->originalSize, e->storedSize, (e->flags & AssetPackFlagLz4) ? " (lz4)" : "");
+	}
+
+	// 名前順に並んでいる (二分探索できる)
+	for (std::size_t i = 1; i < index.size(); ++i) {
+		const AssetPackEntry& a = index.entry(i - 1);
+		const AssetPackEntry& b = index.entry(i);
+		TEST_CHECK(std::string(index.name(a), a.nameLength) < std::string(index.name(b), b.nameLength));
+	}
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	if (argc == 1) {
+		TestLz4Valid();
+		TestLz4Broken();
+		TestBrokenIndex();
+		return TestResult("AssetPack");
+	}
+
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--pack") == 0 && i + 1 < argc) {
+			const char* packPath = argv[++i];
+			std::vector<const char*> files;
+			while (i + 1 < argc && std::strcmp(argv[i + 1], "--pack") != 0) {
+				files.push_back(argv[++i]);
+			}
+			TestPackRoundTrip(packPath, files);
+		} else {
+			std::fprintf(stderr, "usage: AssetPackTest [--pack <pak> <file>...]\n");
+			return 2;
+		}
+	}
+	return TestResult("AssetPack");
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+namespace dxstg {
+namespace test {
+
+// ベンチマークの引数
+// --quick なら回数を減らす (ctest から結果の一致だけを確かめるとき)
+struct BenchOptions {
+	bool quick = false;
+
+	BenchOptions(int argc, char** argv) noexcept
+	{
+		for (int i = 1; i < argc; ++i) {
+			if (std::strcmp(argv[i], "--quick") == 0) quick = true;
+		}
+	}
+
+	int repeats() const noexcept { return quick ? 1 : 7; }
+};
+
+// f() を iterations 回呼ぶのを repeats 回くり返し、いちばん速かった回の1回あたりのナノ秒を返す
+template <class F>
+double MeasureNs(int repeats, std::uint64_t iterations, F&& f)
+{
+	double best = 0;
+	for (int r = 0; r < repeats; ++r) {
+		const auto begin = std::chrono::steady_clock::now();
+		for (std::uint64_t i = 0; i < iterations; ++i) {
+			f();
+		}
+		const auto end = std::chrono::steady_clock::now();
+		const double ns = std::chrono::duration<double, std::nano>(end - begin).count() / static_cast<double>(iterations);
+		best = (r == 0) ? ns : std::min(best, ns);
+	}
+	return best;
+}
+
+// 最適化で計算が消されないように値を使ったことにする (整数などの型のみ)
+template <class T>
+void KeepValue(const T& value) noexcept
+{
+#if defined(__GNUC__)
+	asm volatile("" : : "g"(value) : "memory");
+#else
+	static volatile T sink;
+	sink = value;
+	static_cast<void>(sink); // 読み返して使ったことにする
+#endif
+}
+
+inline void PrintBench(const char* name, double baselineNs, double ns) noexcept
+{
+	std::printf("%-32s %10.1f ns -> %10.1f ns  (x%.2f)\n", name, baselineNs, ns, baselineNs / ns);
+}
+
+}
+}
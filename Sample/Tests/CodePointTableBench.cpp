@@ -0,0 +1,125 @@
+// CodePointTable と以前使っていた std::unordered_map の引く速さを比べる
+// FontTextureMap と同じように、HUD と会話の文字列を1文字ずつ引く。会話の文字はほぼキャッシュ済み。
+// 時間を測る前に、両方が同じ結果を返すかを確かめる。
+//   CodePointTableBench [--quick]
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "Bench.h"
+#include "CodePointTable.h"
+#include "TestCheck.h"
+
+using namespace dxstg;
+using namespace dxstg::test;
+
+namespace {
+
+// FontTextureMap::GlyphData くらいの大きさの値
+struct Glyph {
+	std::int32_t originX, originY;
+	std::int32_t cellIncX, cellIncY;
+	std::uint32_t width, height;
+	void* texture;
+	bool pending;
+};
+
+Glyph MakeGlyph(wchar_t code) noexcept
+{
+	Glyph glyph = {};
+	glyph.originX = static_cast<std::int32_t>(code % 7);
+	glyph.cellIncX = static_cast<std::int32_t>(code % 13) + 8;
+	glyph.width = static_cast<std::uint32_t>(code & 0xff);
+	return glyph;
+}
+
+// 1フレームで引く文字列 (HUD と会話の2行)
+const wchar_t* const FrameLines[] = {
+	L"FPS 59.94  frame 1.21 ms  objects 1234  bullets 5678  spawned 42  score 0001234500",
+	L"隊長「前方に敵の編隊を確認した。弾幕が濃くなるから、低速移動で抜けるんだ。」",
+	L"「了解！ボムは温存して、翔ぶように避けてみせます。」",
+};
+const wchar_t UncachedCode = L'翔'; // 初めて出てきた (まだキャッシュにない) 文字
+
+std::vector<wchar_t> FrameText()
+{
+	std::vector<wchar_t> text;
+	for (const wchar_t* line : FrameLines) {
+		for (const wchar_t* p = line; *p; ++p) text.push_back(*p);
+	}
+	return text;
+}
+
+// キャッシュに入っている文字
+// 会話に出てくる文字 (UncachedCode 以外) と、それまでに出てきた文字のつもりの ASCII・かな・漢字
+std::vector<wchar_t> CachedCodes(const std::vector<wchar_t>& text)
+{
+	std::vector<wchar_t> codes;
+	for (wchar_t c = 0x20; c < 0x7f; ++c) codes.push_back(c);         // ASCII
+	for (wchar_t c = 0x3041; c <= 0x3096; ++c) codes.push_back(c);    // ひらがな
+	for (wchar_t c = 0x30a1; c <= 0x30fa; ++c) codes.push_back(c);    // カタカナ
+	TestRandom random(29);
+	for (int i = 0; i < 600; ++i) {                                  // 漢字
+		codes.push_back(static_cast<wchar_t>(0x4e00 + random.next() % 0x5000));
+	}
+	codes.insert(codes.end(), text.begin(), text.end());
+	codes.erase(std::remove(codes.begin(), codes.end(), UncachedCode), codes.end());
+	return codes;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	const BenchOptions options(argc, argv);
+	const auto text = FrameText();
+	const auto cached = CachedCodes(text);
+
+	CodePointTable<Glyph> table;
+	std::unordered_map<wchar_t, Glyph> map;
+	for (wchar_t code : cached) {
+		table[code] = MakeGlyph(code);
+		map[code] = MakeGlyph(code);
+	}
+
+	// 同じ結果になるか
+	TEST_CHECK(table.size() == map.size());
+	TEST_CHECK(table.count(UncachedCode) == 0);
+	for (wchar_t code : text) {
+		const auto t = table.find(code);
+		const auto m = map.find(code);
+		TEST_CHECK((t == table.end()) == (m == map.end()));
+		if (t != table.end() && m != map.end()) {
+			TEST_CHECK(t->second.cellIncX == m->second.cellIncX && t->second.width == m->second.width);
+		}
+	}
+	if (FailureCount() != 0) {
+		return TestResult("CodePointTableBench");
+	}
+
+	// DrawString と同じく、1文字につき find してから値を読む
+	const std::uint64_t iterations = options.quick ? 100 : 200000;
+	const double mapNs = MeasureNs(options.repeats(), iterations, [&] {
+		std::int32_t advance = 0;
+		for (wchar_t code : text) {
+			const auto it = map.find(code);
+			if (it != map.end()) advance += it->second.cellIncX;
+		}
+		KeepValue(advance);
+	});
+	const double tableNs = MeasureNs(options.repeats(), iterations, [&] {
+		std::int32_t advance = 0;
+		for (wchar_t code : text) {
+			const auto it = table.find(code);
+			if (it != table.end()) advance += it->second.cellIncX;
+		}
+		KeepValue(advance);
+	});
+
+	std::printf("%zu cached glyphs, %zu pages, %zu lookups per frame\n", table.size(), table.pageCount(), text.size());
+	PrintBench("frame text (unordered_map)", mapNs, tableNs);
+	PrintBench("per lookup", mapNs / text.size(), tableNs / text.size());
+	return TestResult("CodePointTableBench");
+}
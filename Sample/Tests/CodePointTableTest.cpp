@@ -0,0 +1,110 @@
+// CodePointTable のテスト
+// FontTextureMap::erase が使う erase の後も、find・count・走査・追加し直しが正しいかを確かめる。
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "CodePointTable.h"
+#include "TestCheck.h"
+
+using namespace dxstg;
+using namespace dxstg::test;
+
+namespace {
+
+// 走査した結果が model と同じか (順番は問わない)
+bool SameAs(const CodePointTable<int>& table, const std::unordered_map<wchar_t, int>& model)
+{
+	if (table.size() != model.size()) return false;
+	std::size_t visited = 0;
+	for (const auto& kv : table) {
+		const auto it = model.find(kv.first);
+		if (it == model.end() || it->second != kv.second) return false;
+		++visited;
+	}
+	return visited == model.size();
+}
+
+void TestErase()
+{
+	CodePointTable<int> table;
+	const wchar_t codes[] = { L'A', L'あ', L'漢', L'字', L'Z' };
+	for (int i = 0; i < 5; ++i) table[codes[i]] = i + 1;
+	TEST_CHECK(table.size() == 5);
+
+	// 途中の要素を消すと末尾の要素が詰められる
+	TEST_CHECK(table.erase(L'あ') == 1);
+	TEST_CHECK(table.size() == 4);
+	TEST_CHECK(table.find(L'あ') == table.end() && table.count(L'あ') == 0);
+	TEST_CHECK(table.find(L'Z') != table.end() && table.find(L'Z')->second == 5);
+	TEST_CHECK(table.at(L'A') == 1 && table.at(L'漢') == 3 && table.at(L'字') == 4 && table.at(L'Z') == 5);
+	TEST_CHECK(SameAs(table, { { L'A', 1 }, { L'漢', 3 }, { L'字', 4 }, { L'Z', 5 } }));
+
+	// ないものや、消したものをもう一度消しても何もしない
+	TEST_CHECK(table.erase(L'あ') == 0);
+	TEST_CHECK(table.erase(L'ん') == 0);
+	TEST_CHECK(table.erase(static_cast<wchar_t>(0xfffe)) == 0); // ページもない
+	TEST_CHECK(table.size() == 4);
+
+	// 末尾の要素を消す
+	const wchar_t last = (table.end() - 1)->first;
+	TEST_CHECK(table.erase(last) == 1);
+	TEST_CHECK(table.count(last) == 0 && table.size() == 3);
+
+	// 消したものを追加し直すとデフォルト値から始まり、ほかの要素は変わらない
+	TEST_CHECK(table[L'あ'] == 0);
+	table[L'あ'] = 10;
+	TEST_CHECK(table.size() == 4 && table.at(L'あ') == 10 && table.count(L'あ') == 1);
+	std::unordered_map<wchar_t, int> expected = { { L'A', 1 }, { L'漢', 3 }, { L'字', 4 }, { L'Z', 5 }, { L'あ', 10 } };
+	expected.erase(last);
+	TEST_CHECK(SameAs(table, expected));
+
+	// すべて消す
+	for (const auto& kv : expected) TEST_CHECK(table.erase(kv.first) == 1);
+	TEST_CHECK(table.empty() && table.begin() == table.end());
+	for (const auto& kv : expected) TEST_CHECK(table.find(kv.first) == table.end());
+	table[L'漢'] = 7;
+	TEST_CHECK(table.size() == 1 && table.at(L'漢') == 7);
+}
+
+// 追加と削除をでたらめに繰り返し、unordered_map と同じ結果になるか
+void TestRandomOperations()
+{
+	CodePointTable<int> table;
+	std::unordered_map<wchar_t, int> model;
+	TestRandom random(29);
+	bool same = true;
+	for (int i = 0; i < 20000; ++i) {
+		// 少ない種類の文字にして、同じ文字を何度も追加・削除する (ページをまたぐ)
+		const wchar_t code = static_cast<wchar_t>(0x3000 + random.next() % 0x600);
+		switch (random.next() % 3) {
+		case 0:
+			table[code] = i;
+			model[code] = i;
+			break;
+		case 1:
+			same = same && table.erase(code) == model.erase(code);
+			break;
+		default:
+			same = same && table.count(code) == model.count(code);
+			if (model.count(code)) same = same && table.find(code)->second == model[code];
+			break;
+		}
+	}
+	TEST_CHECK(same);
+	TEST_CHECK(SameAs(table, model));
+
+	table.clear();
+	TEST_CHECK(table.empty() && table.pageCount() == 0 && table.count(L'あ') == 0);
+}
+
+}
+
+int main()
+{
+	TestErase();
+	TestRandomOperations();
+	return TestResult("CodePointTable");
+}
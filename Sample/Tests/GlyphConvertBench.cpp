@@ -0,0 +1,189 @@
+// GlyphConvert (GGO_GRAY4_BITMAP の変換) のベンチマーク
+// 以前の FontTextureMap にあった1画素ずつのループと、SIMD 版の ConvertGray4Bitmap / ConvertGray4BitmapA8 を比べる。
+// 測るのは大きな文字サイズ (64～96 ピクセルのセル) の漢字くらいのビットマップ。
+// 時間を測る前に、すべての幅 (端数を含む) と測るビットマップで結果が一致するかを確かめる。
+//   GlyphConvertBench [--quick]
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "Bench.h"
+#include "GlyphConvert.h"
+#include "TestCheck.h"
+
+using namespace dxstg;
+using namespace dxstg::test;
+
+namespace {
+
+// 以前の FontTextureMap::getCharData の変換 (1画素ずつ)
+void ReferenceConvertBitmap(const std::uint8_t* src, std::size_t srcPitch,
+	std::uint32_t* dst, std::size_t width, std::size_t height, bool preMultipliedAlpha)
+{
+	constexpr int Level = 17; // α値の段階 (GGO_GRAY4_BITMAPなので17段階)
+	std::uint32_t Alpha;
+	for (std::size_t y = 0; y < height; ++y) {
+		for (std::size_t x = 0; x < width; ++x) {
+			Alpha = (255 * src[x + srcPitch * y]) / (Level - 1);
+			if (preMultipliedAlpha) {
+				dst[x + width * y] = (Alpha << 24) | (Alpha << 16) | (Alpha << 8) | Alpha;
+			} else {
+				dst[x + width * y] = 0x00ffffff | (Alpha << 24);
+			}
+		}
+	}
+}
+
+void ReferenceConvertBitmapA8(const std::uint8_t* src, std::size_t srcPitch,
+	std::uint8_t* dst, std::size_t width, std::size_t height)
+{
+	constexpr int Level = 17;
+	for (std::size_t y = 0; y < height; ++y) {
+		for (std::size_t x = 0; x < width; ++x) {
+			dst[x + width * y] = static_cast<std::uint8_t>((255 * src[x + srcPitch * y]) / (Level - 1));
+		}
+	}
+}
+
+// GGO_GRAY4_BITMAP らしいビットマップ (0～16、行は4バイト境界。行末の詰め物はゴミ)
+std::vector<std::uint8_t> MakeGray4(std::size_t width, std::size_t height, TestRandom& random)
+{
+	const std::size_t pitch = Gray4Pitch(width);
+	std::vector<std::uint8_t> bitmap(pitch * height);
+	for (std::size_t y = 0; y < height; ++y) {
+		for (std::size_t x = 0; x < pitch; ++x) {
+			bitmap[y * pitch + x] = (x < width) ? static_cast<std::uint8_t>(random.next() % 17) : 0xee;
+		}
+	}
+	return bitmap;
+}
+
+// 大きな文字サイズで GetGlyphOutlineW (GGO_GRAY4_BITMAP) が返す漢字くらいのビットマップ
+// 横画・縦画・はらいを 4x4 のサンプルで塗り、覆った数を 0～16 にする (画の端だけが中間の値になる)。
+// 行は4バイト境界で、行末の詰め物は 0。
+std::vector<std::uint8_t> MakeGlyphGray4(std::size_t width, std::size_t height)
+{
+	struct Stroke {
+		float x0, y0, x1, y1, halfWidth; // 0～1 の座標の線分と、太さの半分
+	};
+	const Stroke strokes[] = {
+		{ 0.05f, 0.12f, 0.95f, 0.12f, 0.035f }, // 横画
+		{ 0.15f, 0.45f, 0.85f, 0.45f, 0.035f },
+		{ 0.02f, 0.88f, 0.98f, 0.88f, 0.04f },
+		{ 0.50f, 0.02f, 0.50f, 0.88f, 0.04f },  // 縦画
+		{ 0.22f, 0.45f, 0.22f, 0.75f, 0.035f },
+		{ 0.78f, 0.45f, 0.78f, 0.75f, 0.035f },
+		{ 0.45f, 0.55f, 0.08f, 0.98f, 0.03f },  // はらい
+		{ 0.55f, 0.55f, 0.95f, 0.98f, 0.03f },
+	};
+	const auto covered = [&](float x, float y) {
+		for (const Stroke& s : strokes) {
+			const float dx = s.x1 - s.x0;
+			const float dy = s.y1 - s.y0;
+			const float t = std::min(std::max(((x - s.x0) * dx + (y - s.y0) * dy) / (dx * dx + dy * dy), 0.f), 1.f);
+			const float px = s.x0 + dx * t - x;
+			const float py = s.y0 + dy * t - y;
+			if (px * px + py * py <= s.halfWidth * s.halfWidth) return true;
+		}
+		return false;
+	};
+
+	const std::size_t pitch = Gray4Pitch(width);
+	std::vector<std::uint8_t> bitmap(pitch * height);
+	for (std::size_t y = 0; y < height; ++y) {
+		for (std::size_t x = 0; x < width; ++x) {
+			int samples = 0;
+			for (int sy = 0; sy < 4; ++sy) {
+				for (int sx = 0; sx < 4; ++sx) {
+					samples += covered((x + (sx + 0.5f) / 4) / width, (y + (sy + 0.5f) / 4) / height) ? 1 : 0;
+				}
+			}
+			bitmap[y * pitch + x] = static_cast<std::uint8_t>(samples);
+		}
+	}
+	return bitmap;
+}
+
+// 大きな文字サイズのセルと、そのときの漢字の黒い部分 (gmBlackBoxX, gmBlackBoxY) の大きさ
+struct GlyphSize {
+	std::size_t cell, width, height;
+};
+const GlyphSize GlyphSizes[] = { { 64, 58, 61 }, { 80, 73, 75 }, { 96, 87, 90 } };
+
+void CheckSame(const std::uint8_t* src, std::size_t width, std::size_t height)
+{
+	for (bool preMultiplied : { false, true }) {
+		std::vector<std::uint32_t> expected(width * height), actual(width * height);
+		ReferenceConvertBitmap(src, Gray4Pitch(width), expected.data(), width, height, preMultiplied);
+		ConvertGray4Bitmap(src, Gray4Pitch(width), actual.data(), width, height, preMultiplied);
+		TEST_CHECK(expected == actual);
+	}
+	std::vector<std::uint8_t> expectedA8(width * height), actualA8(width * height);
+	ReferenceConvertBitmapA8(src, Gray4Pitch(width), expectedA8.data(), width, height);
+	ConvertGray4BitmapA8(src, Gray4Pitch(width), actualA8.data(), width, height);
+	TEST_CHECK(expectedA8 == actualA8);
+}
+
+void CheckMatches()
+{
+	// すべての値 (0～16) と、すべての端数
+	TestRandom random(2024);
+	for (std::size_t width = 1; width <= 67; ++width) {
+		const std::size_t height = 3;
+		CheckSame(MakeGray4(width, height, random).data(), width, height);
+	}
+	// 測るときと同じビットマップ
+	for (const GlyphSize& size : GlyphSizes) {
+		CheckSame(MakeGlyphGray4(size.width, size.height).data(), size.width, size.height);
+	}
+}
+
+void Bench(const BenchOptions& options)
+{
+	for (const GlyphSize& size : GlyphSizes) {
+		const std::size_t width = size.width;
+		const std::size_t height = size.height;
+		const std::size_t pixels = width * height;
+		const auto src = MakeGlyphGray4(width, height);
+		const std::size_t pitch = Gray4Pitch(width);
+		std::vector<std::uint32_t> rgba(pixels);
+		std::vector<std::uint8_t> a8(pixels);
+		const std::uint64_t iterations = (options.quick ? 200000 : 20000000) / pixels + 1;
+
+		const double baseline = MeasureNs(options.repeats(), iterations, [&] {
+			ReferenceConvertBitmap(src.data(), pitch, rgba.data(), width, height, true);
+			KeepValue(rgba[pixels / 2]);
+		});
+		const double simd = MeasureNs(options.repeats(), iterations, [&] {
+			ConvertGray4Bitmap(src.data(), pitch, rgba.data(), width, height, true);
+			KeepValue(rgba[pixels / 2]);
+		});
+		const double baselineA8 = MeasureNs(options.repeats(), iterations, [&] {
+			ReferenceConvertBitmapA8(src.data(), pitch, a8.data(), width, height);
+			KeepValue(a8[pixels / 2]);
+		});
+		const double simdA8 = MeasureNs(options.repeats(), iterations, [&] {
+			ConvertGray4BitmapA8(src.data(), pitch, a8.data(), width, height);
+			KeepValue(a8[pixels / 2]);
+		});
+
+		char name[64];
+		std::snprintf(name, sizeof(name), "RGBA %zupx (%zux%zu)", size.cell, width, height);
+		PrintBench(name, baseline, simd);
+		std::snprintf(name, sizeof(name), "A8   %zupx (%zux%zu)", size.cell, width, height);
+		PrintBench(name, baselineA8, simdA8);
+	}
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	const BenchOptions options(argc, argv);
+	CheckMatches();
+	if (FailureCount() == 0) {
+		Bench(options);
+	}
+	return TestResult("GlyphConvertBench");
+}
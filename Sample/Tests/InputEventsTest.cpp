@@ -0,0 +1,114 @@
+// InputEvents (キー入力のキューと InputTracker) のテスト
+
+#include "InputEvents.h"
+#include "TestCheck.h"
+
+using namespace dxstg;
+using namespace dxstg::test;
+
+namespace {
+
+// 押して離したキーは、同じティックの中でも押されていたことになる
+void TestShortPress()
+{
+	InputEventQueue queue;
+	InputTracker tracker;
+	TEST_CHECK(queue.tryPush({ 0, Key::LEFT, true }));
+	TEST_CHECK(queue.tryPush({ 0, Key::LEFT, false }));
+	tracker.beginTick(queue, 0);
+	TEST_CHECK(tracker.down().left && tracker.pressed().left && tracker.released().left);
+	TEST_CHECK(!tracker.held().left);
+
+	tracker.beginTick(queue, 0);
+	TEST_CHECK(!tracker.down().left && !tracker.pressed().left && !tracker.released().left);
+}
+
+// キューがいっぱいで離したイベントを捨てても、resync で押しっぱなしにならない
+void TestDroppedRelease()
+{
+	InputEventQueue queue;
+	InputTracker tracker;
+	TEST_CHECK(queue.tryPush({ 0, Key::UP, true }));
+	tracker.beginTick(queue, 0);
+	TEST_CHECK(tracker.held().up);
+
+	// 別のキーでキューを埋めてから、UP を離す
+	KeyMask held = KeyBit(Key::UP);
+	size_t dropped = 0;
+	for (int i = 0; i < 1000; ++i) {
+		const bool pressed = (i % 2) == 0;
+		held = pressed ? static_cast<KeyMask>(held | KeyBit(Key::RIGHT)) : static_cast<KeyMask>(held & ~KeyBit(Key::RIGHT));
+		if (!queue.tryPush({ 0, Key::RIGHT, pressed })) ++dropped;
+	}
+	held = static_cast<KeyMask>(held & ~KeyBit(Key::UP));
+	if (!queue.tryPush({ 0, Key::UP, false })) ++dropped;
+	TEST_CHECK(dropped > 0);
+
+	tracker.beginTick(queue, 0);
+	TEST_CHECK(tracker.held().up); // 離したイベントは届いていない
+	tracker.resync(InputFromKeyMask(held));
+	TEST_CHECK(!tracker.held().up && tracker.released().up);
+	TEST_CHECK(!tracker.held().right);
+
+	tracker.beginTick(queue, 0);
+	TEST_CHECK(!tracker.down().up && !tracker.down().right);
+}
+
+// 最初の beginTick より前の resync は、押されたことにせず状態だけを決める
+void TestInitialResync()
+{
+	InputEventQueue queue;
+	InputTracker tracker;
+	Input held = Input();
+	held.down = true;
+	tracker.resync(held);
+	tracker.beginTick(queue, 0);
+	TEST_CHECK(tracker.down().down && !tracker.pressed().down);
+}
+
+// ボットの入力を変わったキーだけイベントにする
+void TestPushInputChanges()
+{
+	InputEventQueue queue;
+	InputTracker tracker;
+	Input previous = Input();
+	Input held = Input();
+	held.left = true;
+	held.up = true;
+	TEST_CHECK(PushInputChanges(queue, previous, held, 100) == 0);
+	tracker.beginTick(queue, 250);
+	TEST_CHECK(tracker.pressed().left && tracker.pressed().up && !tracker.pressed().right);
+	TEST_CHECK(tracker.latency().count() == 2);
+
+	previous = held;
+	held.left = false;
+	TEST_CHECK(PushInputChanges(queue, previous, held, 300) == 0);
+	tracker.beginTick(queue, 300);
+	TEST_CHECK(tracker.released().left && tracker.down().up && !tracker.pressed().up);
+	TEST_CHECK(tracker.latency().count() == 3);
+}
+
+void TestLatencyMerge()
+{
+	LatencyHistogram a;
+	LatencyHistogram b;
+	a.add(500);        // 1us 未満
+	b.add(3000000);    // 3ms
+	b.add(1000000);    // 1ms
+	a.merge(b);
+	TEST_CHECK(a.count() == 3);
+	TEST_CHECK(a.bucket(0) == 1);
+	TEST_CHECK(a.maxMs() == 3.0);
+}
+
+}
+
+int main()
+{
+	TestShortPress();
+	TestDroppedRelease();
+	TestInitialResync();
+	TestPushInputChanges();
+	TestLatencyMerge();
+	return TestResult("InputEvents");
+}
@@ -0,0 +1,396 @@
+// PixelConvert (乗算済みアルファへの変換) のテスト
+//   PixelConvertTest                                      変換の関数だけを調べる
+//   PixelConvertTest --texconv <乗算済み> <普通のアルファ>  texconv.py の出力と実行時の変換が一致するか
+//   PixelConvertTest --container <.dxtex> <.dxtex>       2つが同じで、すべてのミップで色がにじんでいないか
+//   PixelConvertTest --straight-mips <乗算済み> <普通のアルファ>
+//                                                         普通のアルファの .dxtex を読み込むとき (LoadTextureContainer) に
+//                                                         作り直すミップが texconv.py の乗算済みと一致するか
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "PixelConvert.h"
+#include "TestCheck.h"
+
+using namespace dxstg;
+using namespace dxstg::test;
+
+namespace {
+
+struct Texel {
+	float r, g, b, a;
+};
+
+Texel ToTexel(const std::uint8_t* p) noexcept
+{
+	return { p[0] / 255.0f, p[1] / 255.0f, p[2] / 255.0f, p[3] / 255.0f };
+}
+
+// GPU のバイリニア補間 (2つのテクセルの間の1次元)
+Texel Lerp(const Texel& x, const Texel& y, float t) noexcept
+{
+	return { x.r + (y.r - x.r) * t, x.g + (y.g - x.g) * t, x.b + (y.b - x.b) * t, x.a + (y.a - x.a) * t };
+}
+
+// SIMD の処理と 1 画素ずつの PremultiplyChannel が一致するか (端数や位置のずれも)
+void TestMatchesScalar()
+{
+	constexpr size_t Guard = 16;
+	TestRandom random(12345);
+	for (size_t count = 0; count <= 67; ++count) {
+		for (size_t offset = 0; offset < 4; ++offset) {
+			std::vector<std::uint8_t> src((offset + count) * 4 + Guard);
+			for (auto& v : src) v = random.nextByte();
+			std::vector<std::uint8_t> dst(src.size(), 0xcd);
+
+			PremultiplyAlpha(src.data() + offset * 4, dst.data() + offset * 4, count);
+			bool same = true;
+			for (size_t i = 0; i < count; ++i) {
+				const std::uint8_t* s = &src[(offset + i) * 4];
+				const std::uint8_t* d = &dst[(offset + i) * 4];
+				same = same && d[0] == PremultiplyChannel(s[0], s[3]) && d[1] == PremultiplyChannel(s[1], s[3])
+					&& d[2] == PremultiplyChannel(s[2], s[3]) && d[3] == s[3];
+			}
+			TEST_CHECK(same);
+			// 範囲の外には書かない
+			TEST_CHECK(std::all_of(dst.begin(), dst.begin() + offset * 4, [](std::uint8_t v) { return v == 0xcd; }));
+			TEST_CHECK(std::all_of(dst.begin() + (offset + count) * 4, dst.end(), [](std::uint8_t v) { return v == 0xcd; }));
+
+			// その場で変換しても同じ
+			std::vector<std::uint8_t> inPlace(src);
+			PremultiplyAlpha(inPlace.data() + offset * 4, count);
+			TEST_CHECK(std::equal(inPlace.begin() + offset * 4, inPlace.begin() + (offset + count) * 4, dst.begin() + offset * 4));
+		}
+	}
+}
+
+// すべての (c, a) で round(c * a / 255) (texconv.py の (c * a + 127) // 255) になるか
+void TestAllValues()
+{
+	std::vector<std::uint8_t> pixels(256 * 256 * 4);
+	for (std::uint32_t a = 0; a < 256; ++a) {
+		for (std::uint32_t c = 0; c < 256; ++c) {
+			std::uint8_t* p = &pixels[(a * 256 + c) * 4];
+			p[0] = static_cast<std::uint8_t>(c);
+			p[1] = static_cast<std::uint8_t>(255 - c);
+			p[2] = static_cast<std::uint8_t>(c ^ 0x5a);
+			p[3] = static_cast<std::uint8_t>(a);
+		}
+	}
+	PremultiplyAlpha(pixels.data(), 256 * 256);
+
+	int mismatches = 0;
+	int visibleInTransparent = 0;
+	for (std::uint32_t a = 0; a < 256; ++a) {
+		for (std::uint32_t c = 0; c < 256; ++c) {
+			const std::uint8_t* p = &pixels[(a * 256 + c) * 4];
+			const std::uint32_t channels[3] = { c, 255 - c, c ^ 0x5a };
+			for (int k = 0; k < 3; ++k) {
+				if (p[k] != (channels[k] * a + 127) / 255 || PremultiplyChannel(channels[k], a) != p[k]) ++mismatches;
+				if (p[k] > a) ++mismatches; // 乗算済みなら色は α を超えない
+			}
+			if (p[3] != a) ++mismatches;
+			// 完全に透明な画素の色は 0
+			if (a == 0 && (p[0] != 0 || p[1] != 0 || p[2] != 0)) ++visibleInTransparent;
+		}
+	}
+	TEST_CHECK(mismatches == 0);
+	TEST_CHECK(visibleInTransparent == 0);
+	// 不透明な画素は変わらない
+	TEST_CHECK(PremultiplyChannel(200, 255) == 200);
+}
+
+// 不透明な画素と透明な画素 (色は緑のゴミ) の境目をバイリニア補間しても、緑がにじまない
+void TestBilinearEdge()
+{
+	const std::uint8_t opaque[4] = { 255, 0, 0, 255 };
+	const std::uint8_t half[4] = { 200, 100, 0, 128 };
+	const std::uint8_t transparent[4] = { 0, 255, 0, 0 };
+
+	for (const std::uint8_t* edge : { opaque, half }) {
+		std::uint8_t row[8];
+		std::memcpy(row, edge, 4);
+		std::memcpy(row + 4, transparent, 4);
+
+		// 普通のアルファのまま補間すると緑が混ざる (このテストが意味のあることの確認)
+		const Texel straightMid = Lerp(ToTexel(row), ToTexel(row + 4), 0.5f);
+		TEST_CHECK(straightMid.g / straightMid.a > 0.5f);
+
+		PremultiplyAlpha(row, 2);
+		TEST_CHECK(row[4] == 0 && row[5] == 0 && row[6] == 0 && row[7] == 0);
+
+		const Texel x = ToTexel(row);
+		const Texel y = ToTexel(row + 4);
+		for (int i = 0; i <= 16; ++i) {
+			const Texel t = Lerp(x, y, i / 16.0f);
+			TEST_CHECK(t.r <= t.a + 1e-6f && t.g <= t.a + 1e-6f && t.b <= t.a + 1e-6f);
+			if (t.a > 0) {
+				// 乗算を戻すと、ずっと元の不透明な側の色のまま
+				TEST_CHECK(std::fabs(t.r / t.a - x.r / x.a) < 1e-5f);
+				TEST_CHECK(std::fabs(t.g / t.a - x.g / x.a) < 1e-5f);
+				TEST_CHECK(std::fabs(t.b / t.a - x.b / x.a) < 1e-5f);
+			}
+		}
+
+		// texconv.py のミップの縮小 (2x2 の平均) でも同じ
+		const std::uint8_t texels[4][4] = {
+			{ row[0], row[1], row[2], row[3] }, { row[4], row[5], row[6], row[7] },
+			{ row[4], row[5], row[6], row[7] }, { row[4], row[5], row[6], row[7] } };
+		std::uint8_t mip[4];
+		for (int c = 0; c < 4; ++c) {
+			mip[c] = static_cast<std::uint8_t>((texels[0][c] + texels[1][c] + texels[2][c] + texels[3][c] + 2) / 4);
+		}
+		TEST_CHECK(mip[1] <= mip[3] && mip[0] <= mip[3] && mip[2] <= mip[3]);
+		TEST_CHECK(mip[1] == (row[1] + 2) / 4);
+	}
+}
+
+// DownsampleRgba が texconv.py の downsample (2x2 の平均、奇数は端を使い回す) と同じになるか
+void TestDownsample()
+{
+	const std::uint32_t sizes[][2] = { { 1, 1 }, { 2, 2 }, { 1, 5 }, { 5, 1 }, { 7, 3 }, { 8, 8 }, { 9, 6 } };
+	TestRandom random(31);
+	for (const auto& size : sizes) {
+		const std::uint32_t width = size[0];
+		const std::uint32_t height = size[1];
+		const std::uint32_t w2 = std::max(1u, width / 2);
+		const std::uint32_t h2 = std::max(1u, height / 2);
+		const size_t srcPitch = width * 4 + 8; // 行末に詰め物がある
+		const size_t dstPitch = w2 * 4 + 4;
+		std::vector<std::uint8_t> src(srcPitch * height);
+		for (auto& b : src) b = random.nextByte();
+
+		std::vector<std::uint8_t> dst(dstPitch * h2, 0xcd);
+		DownsampleRgba(src.data(), width, height, srcPitch, dst.data(), dstPitch);
+
+		bool same = true;
+		for (std::uint32_t y = 0; y < h2; ++y) {
+			const std::uint32_t y0 = std::min(y * 2, height - 1), y1 = std::min(y * 2 + 1, height - 1);
+			for (std::uint32_t x = 0; x < w2; ++x) {
+				const std::uint32_t x0 = std::min(x * 2, width - 1), x1 = std::min(x * 2 + 1, width - 1);
+				for (int c = 0; c < 4; ++c) {
+					const int s = src[y0 * srcPitch + x0 * 4 + c] + src[y0 * srcPitch + x1 * 4 + c] +
+						src[y1 * srcPitch + x0 * 4 + c] + src[y1 * srcPitch + x1 * 4 + c];
+					same = same && dst[y * dstPitch + x * 4 + c] == (s + 2) / 4;
+				}
+			}
+			same = same && std::all_of(dst.begin() + y * dstPitch + w2 * 4, dst.begin() + (y + 1) * dstPitch,
+				[](std::uint8_t b) { return b == 0xcd; }); // 詰め物には書かない
+		}
+		TEST_CHECK(same);
+	}
+
+	// 白い不透明な画素と、透明な画素 (色は緑のゴミ) の 2x2
+	const std::uint8_t texels[16] = { 255, 255, 255, 255, 0, 255, 0, 0, 255, 255, 255, 255, 0, 255, 0, 0 };
+	std::uint8_t straight[4];
+	DownsampleRgba(texels, 2, 2, 8, straight, 4);
+	PremultiplyAlpha(straight, 1);
+	// 普通のアルファのまま縮小すると緑がにじみ、白が暗くなる (このテストが意味のあることの確認)
+	TEST_CHECK(straight[0] < straight[1]);
+
+	std::uint8_t premultiplied[16];
+	std::uint8_t mip[4];
+	PremultiplyAlpha(texels, premultiplied, 4);
+	DownsampleRgba(premultiplied, 2, 2, 8, mip, 4);
+	TEST_CHECK(mip[0] == 128 && mip[1] == 128 && mip[2] == 128 && mip[3] == 128); // 半透明の白
+}
+
+// 2次元の画像 (α がばらばら、0 も含む) のどこをバイリニア補間しても色が α を超えない
+void TestBilinearImage()
+{
+	constexpr int Size = 8;
+	TestRandom random(777);
+	std::vector<std::uint8_t> image(Size * Size * 4);
+	for (size_t i = 0; i < image.size(); ++i) {
+		image[i] = random.nextByte();
+		if (i % 4 == 3 && (random.next() & 3) == 0) image[i] = 0;
+	}
+	PremultiplyAlpha(image.data(), Size * Size);
+
+	int overflows = 0;
+	for (int y = 0; y + 1 < Size; ++y) {
+		for (int x = 0; x + 1 < Size; ++x) {
+			for (int s = 0; s <= 4; ++s) {
+				for (int t = 0; t <= 4; ++t) {
+					const Texel top = Lerp(ToTexel(&image[(y * Size + x) * 4]), ToTexel(&image[(y * Size + x + 1) * 4]), s / 4.0f);
+					const Texel bottom = Lerp(ToTexel(&image[((y + 1) * Size + x) * 4]), ToTexel(&image[((y + 1) * Size + x + 1) * 4]), s / 4.0f);
+					const Texel v = Lerp(top, bottom, t / 4.0f);
+					if (v.r > v.a + 1e-6f || v.g > v.a + 1e-6f || v.b > v.a + 1e-6f) ++overflows;
+				}
+			}
+		}
+	}
+	TEST_CHECK(overflows == 0);
+}
+
+// .dxtex を読む (TextureContainer.h は Windows のヘッダーを使うので、ここで最低限だけ解釈する)
+struct Container {
+	std::vector<std::uint8_t> bytes;
+	std::uint32_t width = 0;
+	std::uint32_t height = 0;
+	std::uint32_t mipLevels = 0;
+	std::uint32_t flags = 0;
+
+	std::uint32_t u32(size_t offset) const noexcept
+	{
+		std::uint32_t v = 0;
+		std::memcpy(&v, &bytes[offset], 4); // リトルエンディアンの環境のみ
+		return v;
+	}
+
+	// level 番目のミップの画素 (幅 * 4 バイトごとの行)。壊れていたら nullptr
+	const std::uint8_t* mip(std::uint32_t level, std::uint32_t& w, std::uint32_t& h) const noexcept
+	{
+		const size_t entry = 32 + 16 * static_cast<size_t>(level);
+		if (level >= mipLevels || entry + 16 > bytes.size()) return nullptr;
+		w = std::max(1u, width >> level);
+		h = std::max(1u, height >> level);
+		const std::uint32_t offset = u32(entry);
+		if (u32(entry + 4) != w * 4 || u32(entry + 8) != w * h * 4 || offset + static_cast<size_t>(w) * h * 4 > bytes.size()) return nullptr;
+		return &bytes[offset];
+	}
+};
+
+bool ReadContainer(const char* path, Container& container)
+{
+	container.bytes = ReadWholeFile(path);
+	if (container.bytes.size() < 32 || std::memcmp(container.bytes.data(), "DXTX", 4) != 0) {
+		std::fprintf(stderr, "%s: not a .dxtex file\n", path);
+		return false;
+	}
+	if (container.u32(4) != 1 || container.u32(8) != 28) { // 版 1, DXGI_FORMAT_R8G8B8A8_UNORM
+		std::fprintf(stderr, "%s: unexpected version or format\n", path);
+		return false;
+	}
+	container.width = container.u32(12);
+	container.height = container.u32(16);
+	container.mipLevels = container.u32(20);
+	container.flags = container.u32(24);
+	return true;
+}
+
+// 実行時に PNG を読むとき (DecodeImage) は WIC で普通のアルファの RGBA にしてから PremultiplyAlpha する。
+// texconv.py --straight-alpha の出力はその WIC の結果と同じものなので、それを変換して texconv.py の乗算済みと比べる
+void TestTexconvParity(const char* premultipliedPath, const char* straightPath)
+{
+	Container premultiplied;
+	Container straight;
+	TEST_CHECK(ReadContainer(premultipliedPath, premultiplied));
+	TEST_CHECK(ReadContainer(straightPath, straight));
+	if (FailureCount() != 0) return;
+
+	TEST_CHECK((premultiplied.flags & 1) != 0);
+	TEST_CHECK((straight.flags & 1) == 0);
+	TEST_CHECK(premultiplied.width == straight.width && premultiplied.height == straight.height);
+
+	std::uint32_t w = 0, h = 0, w2 = 0, h2 = 0;
+	const std::uint8_t* expected = premultiplied.mip(0, w, h);
+	const std::uint8_t* source = straight.mip(0, w2, h2);
+	TEST_CHECK(expected != nullptr && source != nullptr);
+	if (expected == nullptr || source == nullptr) return;
+
+	std::vector<std::uint8_t> decoded(source, source + static_cast<size_t>(w2) * h2 * 4);
+	PremultiplyAlpha(decoded.data(), static_cast<size_t>(w2) * h2);
+	TEST_CHECK(std::equal(decoded.begin(), decoded.end(), expected));
+	std::printf("%s: %ux%u matches PremultiplyAlpha\n", premultipliedPath, w, h);
+}
+
+// 入れてある .dxtex が今の texconv.py の出力と同じで、すべてのミップで乗算済みになっているか
+void TestContainer(const char* path, const char* regeneratedPath)
+{
+	Container container;
+	Container regenerated;
+	TEST_CHECK(ReadContainer(path, container));
+	TEST_CHECK(ReadContainer(regeneratedPath, regenerated));
+	if (FailureCount() != 0) return;
+
+	TEST_CHECK(container.bytes == regenerated.bytes);
+	TEST_CHECK((container.flags & 1) != 0);
+
+	int fringes = 0;
+	for (std::uint32_t level = 0; level < container.mipLevels; ++level) {
+		std::uint32_t w = 0, h = 0;
+		const std::uint8_t* p = container.mip(level, w, h);
+		TEST_CHECK(p != nullptr);
+		if (p == nullptr) break;
+		for (size_t i = 0; i < static_cast<size_t>(w) * h; ++i, p += 4) {
+			if (p[0] > p[3] || p[1] > p[3] || p[2] > p[3]) ++fringes;
+		}
+	}
+	TEST_CHECK(fringes == 0);
+	std::printf("%s: %u mips checked\n", path, container.mipLevels);
+}
+
+// 普通のアルファの .dxtex から、LoadTextureContainer と同じように1段目を乗算済みにしてミップを作り直す。
+// texconv.py が乗算済みにしてから縮小したものと、すべてのミップで一致するか
+void TestStraightMips(const char* premultipliedPath, const char* straightPath)
+{
+	Container premultiplied;
+	Container straight;
+	TEST_CHECK(ReadContainer(premultipliedPath, premultiplied));
+	TEST_CHECK(ReadContainer(straightPath, straight));
+	if (FailureCount() != 0) return;
+
+	TEST_CHECK((premultiplied.flags & 1) != 0 && (straight.flags & 1) == 0);
+	TEST_CHECK(premultiplied.mipLevels == straight.mipLevels && straight.mipLevels > 1);
+
+	std::uint32_t w = 0, h = 0;
+	const std::uint8_t* top = straight.mip(0, w, h);
+	TEST_CHECK(top != nullptr);
+	if (top == nullptr) return;
+	std::vector<std::uint8_t> level(top, top + static_cast<size_t>(w) * h * 4);
+	PremultiplyAlpha(level.data(), static_cast<size_t>(w) * h);
+
+	for (std::uint32_t i = 0; i < straight.mipLevels; ++i) {
+		std::uint32_t ew = 0, eh = 0;
+		const std::uint8_t* expected = premultiplied.mip(i, ew, eh);
+		TEST_CHECK(expected != nullptr && ew == w && eh == h);
+		if (expected == nullptr || ew != w || eh != h) return;
+		TEST_CHECK(std::equal(level.begin(), level.end(), expected));
+
+		if (i + 1 < straight.mipLevels) {
+			const std::uint32_t w2 = std::max(1u, w / 2);
+			const std::uint32_t h2 = std::max(1u, h / 2);
+			std::vector<std::uint8_t> next(static_cast<size_t>(w2) * h2 * 4);
+			DownsampleRgba(level.data(), w, h, w * 4, next.data(), w2 * 4);
+			level.swap(next);
+			w = w2;
+			h = h2;
+		}
+	}
+	std::printf("%s: %u mips rebuilt from %s\n", premultipliedPath, straight.mipLevels, straightPath);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+	if (argc == 1) {
+		TestMatchesScalar();
+		TestAllValues();
+		TestBilinearEdge();
+		TestBilinearImage();
+		TestDownsample();
+		return TestResult("PixelConvert");
+	}
+
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--texconv") == 0 && i + 2 < argc) {
+			TestTexconvParity(argv[i + 1], argv[i + 2]);
+			i += 2;
+		} else if (std::strcmp(argv[i], "--container") == 0 && i + 2 < argc) {
+			TestContainer(argv[i + 1], argv[i + 2]);
+			i += 2;
+		} else if (std::strcmp(argv[i], "--straight-mips") == 0 && i + 2 < argc) {
+			TestStraightMips(argv[i + 1], argv[i + 2]);
+			i += 2;
+		} else {
+			std::fprintf(stderr, "usage: PixelConvertTest [--texconv <premultiplied> <straight>] [--container <dxtex> <regenerated>] [--straight-mips <premultiplied> <straight>]\n");
+			return 2;
+		}
+	}
+	return TestResult("TexconvParity");
+}
@@ -0,0 +1,280 @@
+// SdfGenerator (GGO_NATIVE のアウトラインの読み込みと距離場の生成) のテスト
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "SdfGenerator.h"
+#include "TestCheck.h"
+
+using namespace dxstg;
+using namespace dxstg::test;
+
+namespace {
+
+constexpr int Spread = 4; // FontTextureMap::SdfSpread と同じ
+constexpr float Pi = 3.14159265f;
+
+// 輪郭からの距離 dist (内側が正) のときに GenerateSdf が書く値
+int ExpectedValue(float dist)
+{
+	const float v = std::fmin(std::fmax(0.5f + dist * 0.5f / Spread, 0.f), 1.f);
+	return static_cast<int>(v * 255.f + 0.5f);
+}
+
+// 距離場を作る範囲。左上の角を (x0 - 0.5, y1 + 0.5) にして、ピクセルの中心が整数の座標に来るようにする
+struct Field {
+	int x0, y1;
+	std::size_t width, height;
+	std::vector<std::uint8_t> values;
+
+	Field(const GlyphOutline& outline, int left, int top, std::size_t w, std::size_t h)
+		: x0(left), y1(top), width(w), height(h), values(w * h)
+	{
+		GenerateSdf(outline, left - 0.5f, top + 0.5f, width, height, static_cast<float>(Spread), values.data());
+	}
+
+	// アウトライン座標 (x, y) にあるピクセルの値
+	int at(int x, int y) const { return values[width * static_cast<std::size_t>(y1 - y) + static_cast<std::size_t>(x - x0)]; }
+};
+
+// GGO_NATIVE の並びを書く (TTPOLYGONHEADER, TTPOLYCURVE, POINTFX)
+class NativeOutlineWriter final {
+public:
+	static constexpr std::uint16_t Line = 1;    // TT_PRIM_LINE
+	static constexpr std::uint16_t QSpline = 2; // TT_PRIM_QSPLINE
+
+	void beginContour(float x, float y)
+	{
+		m_contour = m_data.size();
+		put32(0);  // cb は endContour で書く
+		put32(24); // TT_POLYGON_TYPE
+		putFixed(x);
+		putFixed(y);
+	}
+
+	// count を points.size() / 2 と違う値にすると、大きさの合わない曲線を書ける
+	void curve(std::uint16_t type, const std::vector<float>& points, std::uint16_t count)
+	{
+		put16(type);
+		put16(count);
+		for (float v : points) putFixed(v);
+	}
+
+	void curve(std::uint16_t type, const std::vector<float>& points)
+	{
+		curve(type, points, static_cast<std::uint16_t>(points.size() / 2));
+	}
+
+	// 輪郭の大きさ (cb) を今の位置までにする
+	void endContour()
+	{
+		const std::uint32_t cb = static_cast<std::uint32_t>(m_data.size() - m_contour);
+		std::memcpy(&m_data[m_contour], &cb, sizeof(cb));
+	}
+
+	std::vector<std::uint8_t>& data() noexcept { return m_data; }
+
+private:
+	void putFixed(float v)
+	{
+		const float whole = std::floor(v);
+		put16(static_cast<std::uint16_t>((v - whole) * 65536.f)); // fract
+		put16(static_cast<std::uint16_t>(static_cast<std::int16_t>(whole))); // value
+	}
+
+	void put16(std::uint16_t v) { m_data.push_back(static_cast<std::uint8_t>(v)); m_data.push_back(static_cast<std::uint8_t>(v >> 8)); }
+	void put32(std::uint32_t v) { put16(static_cast<std::uint16_t>(v)); put16(static_cast<std::uint16_t>(v >> 16)); }
+
+	std::vector<std::uint8_t> m_data;
+	std::size_t m_contour = 0;
+};
+
+bool HasPoint(const GlyphOutline::Contour& contour, float x, float y)
+{
+	for (const auto& p : contour) {
+		if (std::fabs(p.x - x) < 1e-4f && std::fabs(p.y - y) < 1e-4f) return true;
+	}
+	return false;
+}
+
+// (0, 0)-(16, 16) の正方形。内側は 128 より大きく、外側は小さく、輪郭上は 128、spread より遠いと 255 / 0
+void TestSquare()
+{
+	GlyphOutline outline;
+	outline.moveTo(0, 0);
+	outline.lineTo(0, 16);
+	outline.lineTo(16, 16);
+	outline.lineTo(16, 0);
+	outline.close();
+
+	const Field field(outline, -8, 24, 32, 32);
+	TEST_CHECK(field.at(0, 8) == 128);
+	TEST_CHECK(field.at(8, 16) == 128);
+	TEST_CHECK(field.at(16, 0) == 128);
+	for (int d = 1; d <= 6; ++d) {
+		// 左の辺を横切る行
+		TEST_CHECK(field.at(d, 8) == ExpectedValue(static_cast<float>(d)));
+		TEST_CHECK(field.at(-d, 8) == ExpectedValue(static_cast<float>(-d)));
+		TEST_CHECK(field.at(d, 8) > 128 && field.at(-d, 8) < 128);
+	}
+	TEST_CHECK(field.at(Spread, 8) == 255 && field.at(-Spread, 8) == 0);
+
+	// spread より遠いところはすべて端の値
+	bool clamped = true;
+	for (int y = -7; y <= 24; ++y) {
+		for (int x = -8; x <= 23; ++x) {
+			const bool inside = x > 0 && x < 16 && y > 0 && y < 16;
+			const int dx = std::max(std::max(-x, x - 16), 0);
+			const int dy = std::max(std::max(-y, y - 16), 0);
+			const int inner = std::min(std::min(x, 16 - x), std::min(y, 16 - y));
+			if (inside && inner >= Spread) clamped = clamped && field.at(x, y) == 255;
+			if (!inside && dx * dx + dy * dy >= Spread * Spread) clamped = clamped && field.at(x, y) == 0;
+		}
+	}
+	TEST_CHECK(clamped);
+
+	// 向きを逆にしても (non-zero winding なので) 同じ
+	GlyphOutline reversed;
+	reversed.moveTo(0, 0);
+	reversed.lineTo(16, 0);
+	reversed.lineTo(16, 16);
+	reversed.lineTo(0, 16);
+	const Field reversedField(reversed, -8, 24, 32, 32); // close() していない輪郭も閉じたものとして扱う
+	TEST_CHECK(reversedField.values == field.values);
+}
+
+// 半径 10 の円 (64 角形)。どのピクセルも円からの距離どおりの値になる
+void TestCircle()
+{
+	constexpr float Radius = 10.f;
+	GlyphOutline outline;
+	outline.moveTo(Radius, 0);
+	for (int i = 1; i < 64; ++i) {
+		const float angle = 2 * Pi * i / 64;
+		outline.lineTo(Radius * std::cos(angle), Radius * std::sin(angle));
+	}
+	outline.close();
+
+	const Field field(outline, -16, 16, 33, 33);
+	int maxError = 0;
+	bool signs = true;
+	for (int y = -16; y <= 16; ++y) {
+		for (int x = -16; x <= 16; ++x) {
+			const float dist = Radius - std::sqrt(static_cast<float>(x * x + y * y));
+			const int value = field.at(x, y);
+			maxError = std::max(maxError, std::abs(value - ExpectedValue(dist)));
+			if (dist > 0.5f) signs = signs && value > 128;
+			if (dist < -0.5f) signs = signs && value < 128;
+		}
+	}
+	TEST_CHECK(maxError <= 1); // 64 角形と円の差は 0.02 ピクセルくらい
+	TEST_CHECK(signs);
+	TEST_CHECK(field.at(0, 0) == 255 && field.at(16, 16) == 0);
+	TEST_CHECK(field.at(10, 0) == 128 && field.at(0, -10) == 128);
+}
+
+// GGO_NATIVE の直線と 2次ベジェ曲線
+void TestDecodeQSpline()
+{
+	// (0, 0) から制御点 (8, 16) で (16, 0) への曲線と、底辺の直線
+	NativeOutlineWriter writer;
+	writer.beginContour(0, 0);
+	writer.curve(NativeOutlineWriter::QSpline, { 8, 16, 16, 0 });
+	writer.curve(NativeOutlineWriter::Line, { 0, 0 });
+	writer.endContour();
+
+	GlyphOutline outline;
+	DecodeNativeOutline(writer.data().data(), writer.data().size(), outline);
+	TEST_CHECK(outline.getContours().size() == 1);
+	if (outline.getContours().size() != 1) return;
+	const auto& contour = outline.getContours()[0];
+	TEST_CHECK(HasPoint(contour, 8, 8));    // t = 0.5 の点
+	TEST_CHECK(HasPoint(contour, 4, 6));    // t = 0.25 の点
+	TEST_CHECK(HasPoint(contour, 16, 0));
+
+	// 曲線の頂上 (8, 8) が輪郭上で、その下は内側、上は外側
+	const Field field(outline, -4, 12, 24, 16);
+	TEST_CHECK(field.at(8, 8) == 128);
+	TEST_CHECK(field.at(8, 6) > 128 && field.at(8, 10) < 128);
+	TEST_CHECK(std::abs(field.at(8, 6) - ExpectedValue(2.f)) <= 3); // 折れ線は曲線の少し内側を通る
+
+	// 制御点が続くときは、間の中点を通る
+	NativeOutlineWriter spline;
+	spline.beginContour(0, 0);
+	spline.curve(NativeOutlineWriter::QSpline, { 0, 8, 8, 8, 8, 0 });
+	spline.endContour();
+	GlyphOutline splineOutline;
+	DecodeNativeOutline(spline.data().data(), spline.data().size(), splineOutline);
+	TEST_CHECK(splineOutline.getContours().size() == 1);
+	if (splineOutline.getContours().size() == 1) {
+		const auto& splineContour = splineOutline.getContours()[0];
+		TEST_CHECK(HasPoint(splineContour, 4, 8)); // (0, 8) と (8, 8) の中点
+		TEST_CHECK(HasPoint(splineContour, 8, 0));
+		TEST_CHECK(!HasPoint(splineContour, 0, 8) && !HasPoint(splineContour, 8, 8)); // 制御点は通らない
+	}
+}
+
+// 点の数が輪郭 (cb) に収まらない曲線は読まない
+// すぐ後ろに次の輪郭を置いて、はみ出して読んだらその頭が点として入るようにしておく
+void TestTruncatedCurve()
+{
+	NativeOutlineWriter writer;
+	writer.beginContour(0, 0);
+	writer.curve(NativeOutlineWriter::Line, { 0, 16, 16, 16 });
+	writer.curve(NativeOutlineWriter::Line, { 16, 0 }, 3); // 点は 3 つのはずが 1 つしかない
+	writer.endContour();
+
+	// 次の輪郭は読める
+	const std::size_t second = writer.data().size();
+	writer.beginContour(40, 0);
+	writer.curve(NativeOutlineWriter::Line, { 40, 8, 48, 8 });
+	writer.endContour();
+
+	GlyphOutline outline;
+	DecodeNativeOutline(writer.data().data(), writer.data().size(), outline);
+	TEST_CHECK(outline.getContours().size() == 2);
+	if (outline.getContours().size() == 2) {
+		const auto& first = outline.getContours()[0];
+		TEST_CHECK(first.size() == 4); // 始点、直線の 2 点、閉じる点
+		TEST_CHECK(!HasPoint(first, 16, 0));
+		TEST_CHECK(HasPoint(outline.getContours()[1], 48, 8));
+	}
+
+	// 最初の輪郭の途中でデータが終わっている (cb がデータより大きい)
+	std::vector<std::uint8_t> cut(writer.data().begin(), writer.data().begin() + 30);
+	GlyphOutline cutOutline;
+	DecodeNativeOutline(cut.data(), cut.size(), cutOutline);
+	TEST_CHECK(cutOutline.empty());
+
+	// 曲線の頭 (wType, cpfx) の途中で輪郭が終わっている
+	NativeOutlineWriter partial;
+	partial.beginContour(0, 0);
+	partial.curve(NativeOutlineWriter::Line, { 0, 16, 16, 16 });
+	partial.data().push_back(NativeOutlineWriter::Line);
+	partial.data().push_back(0);
+	partial.endContour();
+	GlyphOutline partialOutline;
+	DecodeNativeOutline(partial.data().data(), partial.data().size(), partialOutline);
+	TEST_CHECK(partialOutline.getContours().size() == 1 && partialOutline.getContours()[0].size() == 4);
+
+	// cb が頭より小さいときは、そこで読むのをやめる
+	std::vector<std::uint8_t> broken(writer.data().begin() + second, writer.data().end());
+	broken[0] = 8;
+	GlyphOutline brokenOutline;
+	DecodeNativeOutline(broken.data(), broken.size(), brokenOutline);
+	TEST_CHECK(brokenOutline.empty());
+}
+
+}
+
+int main()
+{
+	TestSquare();
+	TestCircle();
+	TestDecodeQSpline();
+	TestTruncatedCurve();
+	return TestResult("SdfGenerator");
+}
@@ -0,0 +1,200 @@
+// SpriteEncoding (スプライトを頂点やインスタンスに詰める) のテスト
+// 詰めたものを VertexShader.hlsl / InstancedVertexShader.hlsl と同じ計算で戻して、元の四角形と比べる。
+
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+#include "SpriteEncoding.h"
+#include "TestCheck.h"
+
+using namespace dxstg;
+using namespace dxstg::test;
+
+namespace {
+
+const SpriteEncoding Encoding = { 0.f, 0.f, 1.f / 64.f };
+
+SpriteQuad MakeQuad(float x0, float y0, float x1, float y1, float u0, float v0, float u1, float v1)
+{
+	SpriteQuad quad;
+	quad.x0 = x0; quad.y0 = y0; quad.x1 = x1; quad.y1 = y1;
+	quad.u0 = u0; quad.v0 = v0; quad.u1 = u1; quad.v1 = v1;
+	quad.color = Color(1.f, 1.f, 1.f, 1.f);
+	return quad;
+}
+
+// InstancedVertexShader.hlsl の計算で角 (cornerX, cornerY) の位置と UV を戻す
+void DecodeInstanceCorner(const SpriteInstance& instance, int cornerX, int cornerY, float& x, float& y, float& u, float& v)
+{
+	const float halfWidth = (instance.halfWidth >> 1) * Encoding.positionUnit;
+	const float halfHeight = (instance.halfHeight >> 1) * Encoding.positionUnit;
+	x = instance.centerX * Encoding.positionUnit + Encoding.originX + (cornerX * 2 - 1) * halfWidth;
+	y = instance.centerY * Encoding.positionUnit + Encoding.originY + (cornerY * 2 - 1) * halfHeight;
+	const int tu = cornerX ^ (instance.halfWidth & 1);
+	const int tv = cornerY ^ (instance.halfHeight & 1);
+	u = (instance.u0 + (instance.u1 - instance.u0) * tu) / 65535.f;
+	v = (instance.v0 + (instance.v1 - instance.v0) * tv) / 65535.f;
+}
+
+// 元の四角形で、位置 (x, y) の角の UV
+bool FindQuadCorner(const SpriteQuad& quad, float x, float y, float& u, float& v)
+{
+	constexpr float Epsilon = 1e-4f;
+	const bool atX0 = std::fabs(x - quad.x0) < Epsilon;
+	const bool atX1 = std::fabs(x - quad.x1) < Epsilon;
+	const bool atY0 = std::fabs(y - quad.y0) < Epsilon;
+	const bool atY1 = std::fabs(y - quad.y1) < Epsilon;
+	if (!(atX0 || atX1) || !(atY0 || atY1)) return false;
+	u = atX0 ? quad.u0 : quad.u1;
+	v = atY0 ? quad.v0 : quad.v1;
+	return true;
+}
+
+// 位置と UV の向きの組み合わせ (同じ向き、片方だけ逆、両方逆) すべてで、角ごとの UV が元と同じになるか
+void TestInstanceFlip()
+{
+	for (int flipX = 0; flipX < 2; ++flipX) {
+		for (int flipY = 0; flipY < 2; ++flipY) {
+			for (int mirrorU = 0; mirrorU < 2; ++mirrorU) {
+				for (int mirrorV = 0; mirrorV < 2; ++mirrorV) {
+					float x0 = -1.f, x1 = 0.5f, y0 = 0.25f, y1 = 2.f;
+					float u0 = 0.25f, u1 = 0.75f, v0 = 0.f, v1 = 0.5f;
+					if (flipX) std::swap(x0, x1);
+					if (flipY) std::swap(y0, y1);
+					if (mirrorU) std::swap(u0, u1);
+					if (mirrorV) std::swap(v0, v1);
+					const SpriteQuad quad = MakeQuad(x0, y0, x1, y1, u0, v0, u1, v1);
+
+					SpriteInstance instance;
+					PackSpriteInstance(quad, Encoding, instance);
+					// UV が位置と逆向きに進むときだけ反転フラグが立つ
+					TEST_CHECK((instance.halfWidth & 1) == (flipX ^ mirrorU));
+					TEST_CHECK((instance.halfHeight & 1) == (flipY ^ mirrorV));
+					TEST_CHECK(instance.u0 <= instance.u1 && instance.v0 <= instance.v1);
+
+					for (int corner = 0; corner < 4; ++corner) {
+						float x, y, u, v;
+						DecodeInstanceCorner(instance, corner & 1, corner >> 1, x, y, u, v);
+						float expectedU = 0.f, expectedV = 0.f;
+						const bool found = FindQuadCorner(quad, x, y, expectedU, expectedV);
+						TEST_CHECK(found);
+						if (!found) continue;
+						TEST_CHECK(std::fabs(u - expectedU) < 1e-4f && std::fabs(v - expectedV) < 1e-4f);
+					}
+				}
+			}
+		}
+	}
+}
+
+// 頂点の下位1ビットが UV の角で、残りが位置になっているか (VertexShader.hlsl の計算で戻す)
+void TestVertexUvBits()
+{
+	const SpriteQuad quad = MakeQuad(-0.5f, 1.f, 0.25f, -2.f, 1.f, 0.f, 0.f, 1.f);
+	SpriteVertex vertexes[4];
+	PackSpriteVertices(quad, Encoding, vertexes);
+
+	const float xs[4] = { quad.x0, quad.x1, quad.x0, quad.x1 };
+	const float ys[4] = { quad.y0, quad.y0, quad.y1, quad.y1 };
+	const float us[4] = { quad.u0, quad.u1, quad.u0, quad.u1 };
+	const float vs[4] = { quad.v0, quad.v0, quad.v1, quad.v1 };
+	for (int i = 0; i < 4; ++i) {
+		TEST_CHECK((vertexes[i].x >> 1) * Encoding.positionUnit == xs[i]);
+		TEST_CHECK((vertexes[i].y >> 1) * Encoding.positionUnit == ys[i]);
+		TEST_CHECK((vertexes[i].x & 1) == static_cast<int>(us[i]));
+		TEST_CHECK((vertexes[i].y & 1) == static_cast<int>(vs[i]));
+	}
+}
+
+// 位置は [-16384, 16383] に丸められ、頂点の *2 + UV でもあふれない
+void TestPositionClamp()
+{
+	const float far = 1e6f;
+	SpriteInstance instance;
+	PackSpriteInstance(MakeQuad(-far - 1.f, -far - 1.f, -far, -far, 0.f, 0.f, 1.f, 1.f), Encoding, instance);
+	TEST_CHECK(instance.centerX == -16384 && instance.centerY == -16384);
+	PackSpriteInstance(MakeQuad(far, far, far + 1.f, far + 1.f, 0.f, 0.f, 1.f, 1.f), Encoding, instance);
+	TEST_CHECK(instance.centerX == 16383 && instance.centerY == 16383);
+
+	// 境目ちょうどは丸めない
+	const float unit = Encoding.positionUnit;
+	PackSpriteInstance(MakeQuad(-16384 * unit, 16383 * unit, -16384 * unit, 16383 * unit, 0.f, 0.f, 0.f, 0.f), Encoding, instance);
+	TEST_CHECK(instance.centerX == -16384 && instance.centerY == 16383);
+
+	// 大きさは [0, 32767] で、反転フラグを足しても 16 ビットに収まる
+	PackSpriteInstance(MakeQuad(far, -far, -far, far, 0.f, 0.f, 1.f, 1.f), Encoding, instance);
+	TEST_CHECK(instance.halfWidth >> 1 == 32767 && instance.halfHeight >> 1 == 32767);
+	TEST_CHECK((instance.halfWidth & 1) == 1 && (instance.halfHeight & 1) == 0);
+
+	SpriteVertex vertexes[4];
+	PackSpriteVertices(MakeQuad(-far, -far, far, far, 0.f, 0.f, 1.f, 1.f), Encoding, vertexes);
+	TEST_CHECK(vertexes[0].x == -32768 && vertexes[0].y == -32768);
+	TEST_CHECK(vertexes[3].x == 32767 && vertexes[3].y == 32767);
+	TEST_CHECK((vertexes[0].x >> 1) == -16384 && (vertexes[3].x >> 1) == 16383);
+}
+
+// UV の UNORM16 は round(u * 65535) で、[0, 1] の外は端に丸める
+void TestUnorm16()
+{
+	bool exact = true;
+	for (std::uint32_t k = 0; k <= 65535; k += 7) {
+		const float u = k / 65535.f;
+		SpriteInstance instance;
+		PackSpriteInstance(MakeQuad(0.f, 0.f, 1.f, 1.f, 0.f, 0.f, u, u), Encoding, instance);
+		exact = exact && instance.u1 == k && instance.v1 == k;
+	}
+	TEST_CHECK(exact);
+
+	SpriteInstance instance;
+	PackSpriteInstance(MakeQuad(0.f, 0.f, 1.f, 1.f, 0.5f, -0.25f, 1.5f, 1.f / 131070.f), Encoding, instance);
+	TEST_CHECK(instance.u0 == 32768); // 32767.5 は上に丸める
+	TEST_CHECK(instance.u1 == 65535);
+	TEST_CHECK(instance.v0 == 0);
+	TEST_CHECK(instance.v1 == 1);     // 0.5 も上に丸める
+}
+
+// 色は乗算済みアルファの UNORM8 (round(c * a * 255))
+void TestColor()
+{
+	struct Case {
+		Color color;
+		std::uint8_t r, g, b, a;
+	};
+	const Case cases[] = {
+		{ Color(1.f, 1.f, 1.f, 1.f), 255, 255, 255, 255 },
+		{ Color(1.f, 0.5f, 0.f, 1.f), 255, 128, 0, 255 },    // 127.5 は上に丸める
+		{ Color(1.f, 0.5f, 0.f, 0.5f), 128, 64, 0, 128 },    // 63.75 -> 64
+		{ Color(0.2f, 0.4f, 0.6f, 0.25f), 13, 26, 38, 64 },  // 12.75, 25.5, 38.25, 63.75
+		{ Color(1.f, 0.f, 1.f, 0.f), 0, 0, 0, 0 },           // 透明なら色も 0
+		{ Color(2.f, -1.f, 0.5f, 1.f), 255, 0, 128, 255 },   // [0, 1] の外は端に丸める
+		{ Color(0.5f, 0.5f, 0.5f, 3.f), 128, 128, 128, 255 }, // α は 1 で丸めてから掛ける
+		{ Color(1.f, 1.f, 1.f, -1.f), 0, 0, 0, 0 },
+	};
+	for (const Case& c : cases) {
+		SpriteQuad quad = MakeQuad(0.f, 0.f, 1.f, 1.f, 0.f, 0.f, 1.f, 1.f);
+		quad.color = c.color;
+
+		SpriteInstance instance;
+		PackSpriteInstance(quad, Encoding, instance);
+		TEST_CHECK(instance.r == c.r && instance.g == c.g && instance.b == c.b && instance.a == c.a);
+
+		SpriteVertex vertexes[4];
+		PackSpriteVertices(quad, Encoding, vertexes);
+		for (const SpriteVertex& vertex : vertexes) {
+			TEST_CHECK(vertex.r == c.r && vertex.g == c.g && vertex.b == c.b && vertex.a == c.a);
+		}
+	}
+}
+
+}
+
+int main()
+{
+	TestInstanceFlip();
+	TestVertexUvBits();
+	TestPositionClamp();
+	TestUnorm16();
+	TestColor();
+	return TestResult("SpriteEncoding");
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace dxstg {
+namespace test {
+
+// 外部のライブラリを使わない最小限のチェック
+// 失敗しても止めずに数え、最後に TestResult で終了コードにする。
+inline int& FailureCount() noexcept
+{
+	static int count = 0;
+	return count;
+}
+
+inline void ReportFailure(const char* file, int line, const char* expression) noexcept
+{
+	std::fprintf(stderr, "%s(%d): check failed: %s\n", file, line, expression);
+	++FailureCount();
+}
+
+inline int TestResult(const char* name) noexcept
+{
+	if (FailureCount() == 0) {
+		std::printf("%s: ok\n", name);
+		return 0;
+	}
+	std::printf("%s: %d check(s) failed\n", name, FailureCount());
+	return 1;
+}
+
+// ファイルを丸ごと読む (開けなかったら空)
+inline std::vector<std::uint8_t> ReadWholeFile(const char* path)
+{
+	std::ifstream file(path, std::ios::binary);
+	return std::vector<std::uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// 再現できる乱数 (xorshift32)
+class TestRandom final {
+public:
+	explicit TestRandom(std::uint32_t seed) noexcept : m_state(seed != 0 ? seed : 1) {}
+
+	std::uint32_t next() noexcept
+	{
+		m_state ^= m_state << 13;
+		m_state ^= m_state >> 17;
+		m_state ^= m_state << 5;
+		return m_state;
+	}
+
+	std::uint8_t nextByte() noexcept { return static_cast<std::uint8_t>(next() >> 24); }
+
+private:
+	std::uint32_t m_state;
+};
+
+}
+}
+
+#define TEST_CHECK(expression) \
+	((expression) ? (void)0 : ::dxstg::test::ReportFailure(__FILE__, __LINE__, #expression))
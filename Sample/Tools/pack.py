@@ -0,0 +1,184 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""アセットを1つのパック (.pak) にまとめる。
+
+使い方:
+    python3 pack.py -o data/assets.pak data/*.cso data/*.dxtex data/*.stage
+    python3 pack.py --store -o data/assets.pak data/*   # 圧縮しない
+
+data/*.cso は Sample.sln をビルドしたときに FxCompile が出力するもの (リポジトリには入れていない)。
+先にビルドしてから実行すること。
+
+パック内の名前はファイル名 (ディレクトリなし)。
+圧縮して 3/4 以下になるものだけ LZ4 (ブロック形式) で圧縮する。
+圧縮しないものは実行時にコピーなしで参照できる。
+出力の形式は Sample/AssetPack.h を参照。標準ライブラリだけで動く。
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+MAGIC = b'DXPK'
+VERSION = 1
+HEADER = struct.Struct('<4sIII')        # magic, version, entryCount, reserved
+ENTRY = struct.Struct('<IIIIIIII')      # nameOffset, nameLength, dataOffset, storedSize, originalSize, flags, reserved x2
+FLAG_LZ4 = 1
+DATA_ALIGNMENT = 16
+
+MIN_MATCH = 4
+LAST_LITERALS = 5   # 最後の5バイトは必ずリテラル
+MF_LIMIT = 12       # 最後のマッチはブロックの終わりから12バイトより前で始まる
+MAX_OFFSET = 65535
+
+
+def _length_bytes(n):
+    out = bytearray()
+    while n >= 255:
+        out.append(255)
+        n -= 255
+    out.append(n)
+    return out
+
+
+def _emit(out, literals, offset=None, match_length=0):
+    lit = len(literals)
+    token = min(lit, 15) << 4
+    if offset is not None:
+        token |= min(match_length - MIN_MATCH, 15)
+    out.append(token)
+    if lit >= 15:
+        out += _length_bytes(lit - 15)
+    out += literals
+    if offset is not None:
+        out += struct.pack('<H', offset)
+        if match_length - MIN_MATCH >= 15:
+            out += _length_bytes(match_length - MIN_MATCH - 15)
+
+
+def lz4_compress(src):
+    """LZ4 ブロック形式で圧縮する (貪欲法。速さより単純さ優先)"""
+    n = len(src)
+    out = bytearray()
+    anchor = 0
+    i = 0
+    table = {}
+    limit = n - MF_LIMIT
+    while i < limit:
+        key = src[i:i + MIN_MATCH]
+        cand = table.get(key)
+        table[key] = i
+        if cand is not None and i - cand <= MAX_OFFSET:
+            m = MIN_MATCH
+            max_m = n - LAST_LITERALS - i
+            while m < max_m and src[cand + m] == src[i + m]:
+                m += 1
+            _emit(out, src[anchor:i], i - cand, m)
+            i += m
+            anchor = i
+        else:
+            i += 1
+    _emit(out, src[anchor:])
+    return bytes(out)
+
+
+def lz4_decompress(src, size):
+    """確認用の展開"""
+    out = bytearray()
+    i = 0
+    while i < len(src):
+        token = src[i]
+        i += 1
+        lit = token >> 4
+        if lit == 15:
+            while True:
+                b = src[i]
+                i += 1
+                lit += b
+                if b != 255:
+                    break
+        out += src[i:i + lit]
+        i += lit
+        if i >= len(src):
+            break
+        offset = src[i] | (src[i + 1] << 8)
+        i += 2
+        m = token & 15
+        if m == 15:
+            while True:
+                b = src[i]
+                i += 1
+                m += b
+                if b != 255:
+                    break
+        m += MIN_MATCH
+        start = len(out) - offset
+        for k in range(m):
+            out.append(out[start + k])
+    if len(out) != size:
+        raise ValueError('size mismatch')
+    return bytes(out)
+
+
+def align(n, a):
+    return (n + a - 1) // a * a
+
+
+def build_pack(files, store=False):
+    entries = []
+    for path in files:
+        name = os.path.basename(path).encode('utf-8')
+        with open(path, 'rb') as f:
+            data = f.read()
+        flags = 0
+        stored = data
+        if not store and data:
+            packed = lz4_compress(data)
+            if len(packed) * 4 <= len(data) * 3:
+                assert lz4_decompress(packed, len(data)) == data
+                stored = packed
+                flags = FLAG_LZ4
+        entries.append((name, stored, len(data), flags))
+
+    entries.sort(key=lambda e: e[0])  # 実行時は二分探索する
+    names = [e[0] for e in entries]
+    if len(set(names)) != len(names):
+        raise ValueError('duplicate asset name')
+
+    name_offset = HEADER.size + ENTRY.size * len(entries)
+    data_offset = align(name_offset + sum(len(n) for n in names), DATA_ALIGNMENT)
+
+    table = []
+    for name, stored, size, flags in entries:
+        table.append((name_offset, len(name), data_offset, len(stored), size, flags))
+        name_offset += len(name)
+        data_offset = align(data_offset + len(stored), DATA_ALIGNMENT)
+
+    out = bytearray(data_offset)
+    HEADER.pack_into(out, 0, MAGIC, VERSION, len(entries), 0)
+    for i, (noff, nlen, doff, slen, size, flags) in enumerate(table):
+        ENTRY.pack_into(out, HEADER.size + ENTRY.size * i, noff, nlen, doff, slen, size, flags, 0, 0)
+        out[noff:noff + nlen] = entries[i][0]
+        out[doff:doff + slen] = entries[i][1]
+    return bytes(out), entries
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description='pack assets into a single .pak file')
+    parser.add_argument('inputs', nargs='+', help='asset files')
+    parser.add_argument('-o', '--output', required=True, help='output .pak file')
+    parser.add_argument('--store', action='store_true', help='do not compress')
+    args = parser.parse_args(argv)
+
+    data, entries = build_pack(args.inputs, args.store)
+    with open(args.output, 'wb') as f:
+        f.write(data)
+    for name, stored, size, flags in entries:
+        print('%-24s %8d -> %8d%s' % (name.decode('utf-8'), size, len(stored), ' (lz4)' if flags & FLAG_LZ4 else ''))
+    print('%s: %d entries, %d bytes' % (args.output, len(entries), len(data)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,197 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""ステージのスクリプト (テキスト) を実行時に読む形式 (.stage) に変換する。
+
+使い方:
+    python3 stage.py -o data/stage1.stage data/stage1.txt
+    python3 stage.py --dump data/stage1.stage          # 中身を表示する
+
+スクリプトは1行に1つ。# から行末まではコメント。
+    <tick> enemy <x> <y> [key=value ...]
+        tick ティック目に敵を出す。tick を +N と書くと前の行からの相対。
+        pattern=track|fixed|aimed  動き方 (既定 track)
+        interval=60                弾を撃つ間隔 (ティック数)
+        count=1                    1回に撃つ弾の数 (扇形に広げる)
+        spread=0                   隣り合う弾の角度の差 (度)
+        speed=0.1                  弾の速さ (1ティックあたり)
+        life=0                     消えるまでのティック数 (0 なら消えない)
+    <tick> repeat <count> <interval> [dx=0] [dy=0]
+    ...
+    end
+        end までの行を count 回くり返す。i 回目は tick + i * interval から始まり、
+        位置を (i * dx, i * dy) ずらす。中の行の tick はくり返しの始めからの相対。入れ子にできる。
+
+出力はティック順 (同じティックは書いた順) に並べる。形式は Sample/Stage.h を参照。
+標準ライブラリだけで動く。
+"""
+
+import argparse
+import math
+import struct
+import sys
+
+MAGIC = b'DXSG'
+VERSION = 1
+HEADER = struct.Struct('<4sIIII12x')    # magic, version, recordCount, recordOffset, lastTick, reserved x3
+RECORD = struct.Struct('<IHHffHHHHff')  # tick, kind, enemyType, x, y, pattern, bulletCount, fireInterval, lifetime, spread, bulletSpeed
+
+KIND_SPAWN_ENEMY = 1
+ENEMY_BASIC = 0
+PATTERNS = {'track': 0, 'fixed': 1, 'aimed': 2}
+MAX_TICK = 0xffffffff
+MAX_U16 = 0xffff
+
+
+class StageError(Exception):
+    pass
+
+
+def _parse_options(words, lineno, defaults):
+    options = dict(defaults)
+    for word in words:
+        key, sep, value = word.partition('=')
+        if not sep or key not in defaults:
+            raise StageError('line %d: unknown option %r' % (lineno, word))
+        options[key] = value
+    return options
+
+
+def _parse_number(text, lineno, kind, low=None, high=None):
+    try:
+        value = kind(text)
+    except ValueError:
+        raise StageError('line %d: bad number %r' % (lineno, text))
+    if isinstance(value, float) and not math.isfinite(value):
+        raise StageError('line %d: bad number %r' % (lineno, text))
+    if (low is not None and value < low) or (high is not None and value > high):
+        raise StageError('line %d: %r is out of range' % (lineno, text))
+    return value
+
+
+def parse_script(text):
+    """スクリプトを (lineno, words) の木にする。くり返しは ('repeat', lineno, words, children)"""
+    root = []
+    stack = [root]
+    for lineno, line in enumerate(text.splitlines(), 1):
+        words = line.split('#', 1)[0].split()
+        if not words:
+            continue
+        if words[0] == 'end':
+            if len(stack) == 1:
+                raise StageError('line %d: end without repeat' % lineno)
+            stack.pop()
+            continue
+        if len(words) < 2:
+            raise StageError('line %d: missing command' % lineno)
+        if words[1] == 'repeat':
+            block = ('repeat', lineno, words, [])
+            stack[-1].append(block)
+            stack.append(block[3])
+        elif words[1] == 'enemy':
+            stack[-1].append(('enemy', lineno, words, None))
+        else:
+            raise StageError('line %d: unknown command %r' % (lineno, words[1]))
+    if len(stack) != 1:
+        raise StageError('repeat without end')
+    return root
+
+
+def _expand(statements, base_tick, offset_x, offset_y, out):
+    previous = base_tick
+    for command, lineno, words, children in statements:
+        tick_text = words[0]
+        if tick_text.startswith('+'):
+            tick = previous + _parse_number(tick_text[1:], lineno, int, 0)
+        else:
+            tick = base_tick + _parse_number(tick_text, lineno, int, 0)
+        previous = tick
+
+        if command == 'repeat':
+            if len(words) < 4:
+                raise StageError('line %d: repeat <count> <interval>' % lineno)
+            count = _parse_number(words[2], lineno, int, 0)
+            interval = _parse_number(words[3], lineno, int, 0)
+            options = _parse_options(words[4:], lineno, {'dx': '0', 'dy': '0'})
+            dx = _parse_number(options['dx'], lineno, float)
+            dy = _parse_number(options['dy'], lineno, float)
+            for i in range(count):
+                _expand(children, tick + i * interval, offset_x + i * dx, offset_y + i * dy, out)
+            continue
+
+        if len(words) < 4:
+            raise StageError('line %d: enemy <x> <y>' % lineno)
+        options = _parse_options(words[4:], lineno, {
+            'pattern': 'track', 'interval': '60', 'count': '1', 'spread': '0', 'speed': '0.1', 'life': '0'})
+        if options['pattern'] not in PATTERNS:
+            raise StageError('line %d: unknown pattern %r' % (lineno, options['pattern']))
+        if tick > MAX_TICK:
+            raise StageError('line %d: tick %d is too large' % (lineno, tick))
+        out.append((tick, len(out), (
+            tick,
+            KIND_SPAWN_ENEMY,
+            ENEMY_BASIC,
+            offset_x + _parse_number(words[2], lineno, float),
+            offset_y + _parse_number(words[3], lineno, float),
+            PATTERNS[options['pattern']],
+            _parse_number(options['count'], lineno, int, 0, MAX_U16),
+            _parse_number(options['interval'], lineno, int, 1, MAX_U16),
+            _parse_number(options['life'], lineno, int, 0, MAX_U16),
+            math.radians(_parse_number(options['spread'], lineno, float)),
+            _parse_number(options['speed'], lineno, float),
+        )))
+
+
+def compile_stage(text):
+    records = []
+    _expand(parse_script(text), 0, 0.0, 0.0, records)
+    records.sort(key=lambda r: (r[0], r[1]))  # 実行時は先頭から順に読むだけ
+
+    last_tick = records[-1][0] if records else 0
+    out = bytearray(HEADER.size + RECORD.size * len(records))
+    HEADER.pack_into(out, 0, MAGIC, VERSION, len(records), HEADER.size, last_tick)
+    for i, (_, _, fields) in enumerate(records):
+        RECORD.pack_into(out, HEADER.size + RECORD.size * i, *fields)
+    return bytes(out), len(records), last_tick
+
+
+def dump_stage(data):
+    magic, version, count, offset, last_tick = HEADER.unpack_from(data, 0)
+    if magic != MAGIC or version != VERSION:
+        raise StageError('not a stage file (version %d)' % VERSION)
+    names = {v: k for k, v in PATTERNS.items()}
+    print('%d records, last tick %d' % (count, last_tick))
+    for i in range(count):
+        tick, kind, enemy_type, x, y, pattern, bullets, interval, life, spread, speed = RECORD.unpack_from(data, offset + RECORD.size * i)
+        print('%8d enemy %g %g pattern=%s interval=%d count=%d spread=%g speed=%g life=%d' % (
+            tick, x, y, names.get(pattern, pattern), interval, bullets, math.degrees(spread), speed, life))
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description='compile a stage script into a .stage file')
+    parser.add_argument('input', help='stage script (or .stage file with --dump)')
+    parser.add_argument('-o', '--output', help='output .stage file')
+    parser.add_argument('--dump', action='store_true', help='print the records of a .stage file')
+    args = parser.parse_args(argv)
+
+    try:
+        if args.dump:
+            with open(args.input, 'rb') as f:
+                dump_stage(f.read())
+            return 0
+
+        if not args.output:
+            parser.error('-o is required')
+        with open(args.input, encoding='utf-8') as f:
+            data, count, last_tick = compile_stage(f.read())
+    except StageError as e:
+        print('%s: %s' % (args.input, e), file=sys.stderr)
+        return 1
+
+    with open(args.output, 'wb') as f:
+        f.write(data)
+    print('%s: %d records, last tick %d, %d bytes' % (args.output, count, last_tick, len(data)))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
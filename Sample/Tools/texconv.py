@@ -0,0 +1,236 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""PNG を GPU にそのまま渡せるテクスチャコンテナ (.dxtex) に変換する。
+
+使い方:
+    python3 texconv.py data/xchu.png data/bullet.png
+    python3 texconv.py --no-mips -o out.dxtex data/xchu.png
+
+色は乗算済みアルファにしてから縮小する (ミップマップで透明な画素の色がにじまないように)。
+--straight-alpha のときは普通のアルファのまま縮小したミップを書き出すが、
+読み込むとき (LoadTextureContainer) には使わず、乗算済みにした1段目から作り直す。
+
+標準ライブラリだけで動くので、Windows でも Linux でも使える。
+出力の形式は Sample/TextureContainer.h を参照。
+"""
+
+import argparse
+import os
+import struct
+import sys
+import zlib
+
+MAGIC = b'DXTX'
+VERSION = 1
+DXGI_FORMAT_R8G8B8A8_UNORM = 28
+HEADER = struct.Struct('<4sIIIIIII')   # magic, version, format, width, height, mipLevels, flags, reserved
+MIP = struct.Struct('<IIII')           # offset, rowPitch, slicePitch, reserved
+DATA_ALIGNMENT = 16
+FLAG_PREMULTIPLIED_ALPHA = 1           # TextureContainerFlagPremultipliedAlpha
+
+
+class PngError(Exception):
+    pass
+
+
+def _paeth(a, b, c):
+    p = a + b - c
+    pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+    if pa <= pb and pa <= pc:
+        return a
+    if pb <= pc:
+        return b
+    return c
+
+
+def _unfilter(data, height, stride, bpp):
+    out = bytearray(height * stride)
+    prev = bytearray(stride)
+    pos = 0
+    for y in range(height):
+        ftype = data[pos]
+        line = bytearray(data[pos + 1:pos + 1 + stride])
+        pos += 1 + stride
+        if ftype == 1:
+            for i in range(bpp, stride):
+                line[i] = (line[i] + line[i - bpp]) & 0xff
+        elif ftype == 2:
+            for i in range(stride):
+                line[i] = (line[i] + prev[i]) & 0xff
+        elif ftype == 3:
+            for i in range(stride):
+                left = line[i - bpp] if i >= bpp else 0
+                line[i] = (line[i] + ((left + prev[i]) >> 1)) & 0xff
+        elif ftype == 4:
+            for i in range(stride):
+                left = line[i - bpp] if i >= bpp else 0
+                upleft = prev[i - bpp] if i >= bpp else 0
+                line[i] = (line[i] + _paeth(left, prev[i], upleft)) & 0xff
+        elif ftype != 0:
+            raise PngError('unknown filter type %d' % ftype)
+        out[y * stride:(y + 1) * stride] = line
+        prev = line
+    return out
+
+
+def load_png(path):
+    """PNG を読み込み (width, height, RGBA のバイト列) を返す。インターレースと16bitは非対応。"""
+    with open(path, 'rb') as f:
+        data = f.read()
+    if data[:8] != b'\x89PNG\r\n\x1a\n':
+        raise PngError('%s: not a PNG file' % path)
+
+    pos = 8
+    idat = bytearray()
+    palette = None
+    trns = None
+    ihdr = None
+    while pos < len(data):
+        length, ctype = struct.unpack('>I4s', data[pos:pos + 8])
+        body = data[pos + 8:pos + 8 + length]
+        pos += 12 + length
+        if ctype == b'IHDR':
+            ihdr = struct.unpack('>IIBBBBB', body)
+        elif ctype == b'PLTE':
+            palette = body
+        elif ctype == b'tRNS':
+            trns = body
+        elif ctype == b'IDAT':
+            idat += body
+        elif ctype == b'IEND':
+            break
+    if ihdr is None:
+        raise PngError('%s: no IHDR' % path)
+
+    width, height, depth, color, _, _, interlace = ihdr
+    if interlace != 0:
+        raise PngError('%s: interlaced PNG is not supported' % path)
+    if depth == 16:
+        raise PngError('%s: 16bit PNG is not supported' % path)
+
+    channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}[color]
+    bits = depth * channels
+    stride = (width * bits + 7) // 8
+    bpp = max(1, bits // 8)
+    raw = _unfilter(zlib.decompress(bytes(idat)), height, stride, bpp)
+
+    rgba = bytearray(width * height * 4)
+    for y in range(height):
+        line = raw[y * stride:(y + 1) * stride]
+        for x in range(width):
+            if depth < 8:
+                # 1, 2, 4bit (グレースケールかパレット)
+                per_byte = 8 // depth
+                shift = 8 - depth * (x % per_byte + 1)
+                v = (line[x // per_byte] >> shift) & ((1 << depth) - 1)
+            else:
+                v = None
+            o = (y * width + x) * 4
+            if color == 3:
+                index = v if v is not None else line[x]
+                r, g, b = palette[index * 3:index * 3 + 3]
+                a = trns[index] if trns is not None and index < len(trns) else 255
+            elif color == 0:
+                g = v * 255 // ((1 << depth) - 1) if v is not None else line[x]
+                r = b = g
+                a = 255
+            elif color == 2:
+                r, g, b = line[x * 3:x * 3 + 3]
+                a = 255
+            elif color == 4:
+                r = g = b = line[x * 2]
+                a = line[x * 2 + 1]
+            else:
+                r, g, b, a = line[x * 4:x * 4 + 4]
+            rgba[o:o + 4] = bytes((r, g, b, a))
+    return width, height, rgba
+
+
+def premultiply(rgba):
+    """各色に α を掛けて乗算済みアルファにする。round(c * a / 255) で Sample/PixelConvert.h と一致する。"""
+    out = bytearray(rgba)
+    for o in range(0, len(out), 4):
+        a = out[o + 3]
+        if a != 255:
+            out[o] = (out[o] * a + 127) // 255
+            out[o + 1] = (out[o + 1] * a + 127) // 255
+            out[o + 2] = (out[o + 2] * a + 127) // 255
+    return out
+
+
+def downsample(width, height, rgba):
+    """2x2 の平均で半分の大きさにする。奇数のときは端の画素を使い回す。"""
+    w2, h2 = max(1, width // 2), max(1, height // 2)
+    out = bytearray(w2 * h2 * 4)
+    for y in range(h2):
+        y0 = min(y * 2, height - 1)
+        y1 = min(y * 2 + 1, height - 1)
+        for x in range(w2):
+            x0 = min(x * 2, width - 1)
+            x1 = min(x * 2 + 1, width - 1)
+            for c in range(4):
+                s = (rgba[(y0 * width + x0) * 4 + c] + rgba[(y0 * width + x1) * 4 + c] +
+                     rgba[(y1 * width + x0) * 4 + c] + rgba[(y1 * width + x1) * 4 + c])
+                out[(y * w2 + x) * 4 + c] = (s + 2) // 4
+    return w2, h2, out
+
+
+def build_mips(width, height, rgba, mips):
+    levels = [(width, height, rgba)]
+    while mips and (width > 1 or height > 1):
+        width, height, rgba = downsample(width, height, rgba)
+        levels.append((width, height, rgba))
+    return levels
+
+
+def align(n, a):
+    return (n + a - 1) // a * a
+
+
+def write_container(path, levels, flags=0):
+    width, height = levels[0][0], levels[0][1]
+    table_end = HEADER.size + MIP.size * len(levels)
+    offset = align(table_end, DATA_ALIGNMENT)
+    entries = []
+    for w, h, data in levels:
+        entries.append((offset, w * 4, w * h * 4))
+        offset = align(offset + len(data), DATA_ALIGNMENT)
+
+    out = bytearray(offset)
+    HEADER.pack_into(out, 0, MAGIC, VERSION, DXGI_FORMAT_R8G8B8A8_UNORM, width, height, len(levels), flags, 0)
+    for i, (off, row_pitch, slice_pitch) in enumerate(entries):
+        MIP.pack_into(out, HEADER.size + MIP.size * i, off, row_pitch, slice_pitch, 0)
+        out[off:off + slice_pitch] = levels[i][2]
+
+    with open(path, 'wb') as f:
+        f.write(out)
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description='PNG -> .dxtex (RGBA8 + mip chain)')
+    parser.add_argument('inputs', nargs='+', help='PNG files')
+    parser.add_argument('-o', '--output', help='output file (only with one input)')
+    parser.add_argument('--no-mips', action='store_true', help='do not generate mip levels')
+    parser.add_argument('--straight-alpha', action='store_true',
+                        help='keep straight alpha (the loader premultiplies the top level and rebuilds the mips at load time)')
+    args = parser.parse_args(argv)
+
+    if args.output and len(args.inputs) != 1:
+        parser.error('-o can be used with only one input')
+
+    for src in args.inputs:
+        dst = args.output or os.path.splitext(src)[0] + '.dxtex'
+        width, height, rgba = load_png(src)
+        flags = 0
+        if not args.straight_alpha:
+            rgba = premultiply(rgba)
+            flags |= FLAG_PREMULTIPLIED_ALPHA
+        levels = build_mips(width, height, rgba, not args.no_mips)
+        write_container(dst, levels, flags)
+        print('%s -> %s (%dx%d, %d mips%s)' % (src, dst, width, height, len(levels),
+                                              '' if args.straight_alpha else ', premultiplied'))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))